@@ -24,6 +24,9 @@ if "%1"=="" GOTO Continue
 	if "%1" == "assets" (
 		CALL :build_assets
 	)
+	if "%1" == "levels" (
+		CALL :build_levels
+	)
 SHIFT
 GOTO Loop
 :Continue
@@ -204,3 +207,14 @@ cl ..\src\assets_file.cpp ^
 build_assets_file.exe
 
 EXIT /B 0
+
+:build_levels
+echo build_levels
+
+REM build_levels_file is built by CMake (see src\CMakeLists.txt), which also
+REM writes bin\levels.bin after building it. This writes one next to the game
+REM built here. It fails without writing anything if a level would load
+REM differently from its source.
+..\bin\build_levels_file.exe levels.bin || EXIT /B 1
+
+EXIT /B 0
@@ -0,0 +1,165 @@
+// Headless timer wheel check.
+//
+// Runs the Game's timer wheel for a few hundred thousand turns of random adds,
+// removes and owner deaths against a plain list of every timer and the turn it
+// is next due, and checks after each turn that timer_is_pending() agrees with
+// the list for every timer -- including ones that fired or were removed long
+// ago, whose IDs must stay stale once their index is reused.
+//
+// Delays are mostly short, some long enough to start above the bottom level,
+// and a few anywhere up to TIMER_MAX_DELAY, so timers cascade down through every
+// level. A periodic timer is only seen to fire when its owner is dead -- it's
+// dropped then -- so owners are killed at random, which checks the re-arming.
+//
+// usage: check_timers [--turns n] [--seed n]
+//
+// Exits with 2 if the wheel and the list ever disagree.
+
+#include "stdafx.h"
+
+#include "game.h"
+#include "random.h"
+
+#include "thread.h"
+
+#define CHECK_TIMERS_MAX_LIVE (MAX_TIMERS - 16)
+#define CHECK_TIMERS_MAX_REFS (4 * MAX_TIMERS)
+
+struct Timer_Ref
+{
+	Timer_ID  timer_id;
+	Entity_ID owner_id;
+	u32       turn;   // next due
+	u32       period; // 0 for once only
+	bool      done;   // fired for the last time or removed
+};
+
+static u32 random_delay()
+{
+	u32 kind = rand_u32() % 10;
+	if (kind < 6) {
+		return 1 + rand_u32() % (TIMER_WHEEL_SLOTS + 8);
+	}
+	if (kind < 9) {
+		return 1 + rand_u32() % (TIMER_WHEEL_SLOTS * TIMER_WHEEL_SLOTS);
+	}
+	return 1 + rand_u32() % TIMER_MAX_DELAY;
+}
+
+int main(int argc, char** argv)
+{
+	u32 num_turns = 300000;
+	u32 seed = 0;
+	for (int i = 1; i < argc; ++i) {
+		if (!strcmp(argv[i], "--turns") && i + 1 < argc) {
+			num_turns = strtoul(argv[++i], NULL, 10);
+		} else if (!strcmp(argv[i], "--seed") && i + 1 < argc) {
+			seed = strtoul(argv[++i], NULL, 10);
+		} else {
+			fprintf(stderr, "unknown argument \"%s\"\n", argv[i]);
+			fprintf(stderr, "usage: %s [--turns n] [--seed n]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	MT19937 rng;
+	rng.seed(seed);
+	rng.set_current();
+
+	// far too big for the stack
+	Game *game = (Game*)malloc(sizeof(Game));
+	Timer_Ref *refs = (Timer_Ref*)malloc(CHECK_TIMERS_MAX_REFS * sizeof(Timer_Ref));
+	ASSERT(game && refs);
+	init(game);
+	// every non-static index holds an entity, live until it's killed -- which
+	// gives the index a new generation and its entity the new ID, as reusing
+	// the index would
+	game->next_entity_index = MAX_ENTITIES;
+	game->entities.len = MAX_ENTITIES - NUM_STATIC_ENTITY_IDS;
+	for (u32 index = NUM_STATIC_ENTITY_IDS; index < MAX_ENTITIES; ++index) {
+		u32 slot = index - NUM_STATIC_ENTITY_IDS;
+		memset(&game->entities.items[slot], 0, sizeof(Entity));
+		game->entities.items[slot].id = make_entity_id(index, game->entity_generations[index]);
+		game->entity_slots[index] = (u16)slot;
+	}
+
+	u32 num_refs = 0, num_live = 0;
+	u64 num_fired = 0, num_bad = 0;
+	for (u32 step = 0; step < num_turns; ++step) {
+		u32 num_adds = rand_u32() % 3;
+		for (u32 i = 0; i < num_adds && num_live < CHECK_TIMERS_MAX_LIVE; ++i) {
+			Timer_Ref *ref = &refs[num_refs++];
+			ref->owner_id = 0;
+			if (rand_u32() % 2) {
+				u32 index = NUM_STATIC_ENTITY_IDS + rand_u32() % (MAX_ENTITIES - NUM_STATIC_ENTITY_IDS);
+				ref->owner_id = make_entity_id(index, game->entity_generations[index]);
+			}
+			u32 delay = random_delay();
+			ref->turn = game->turn + delay;
+			ref->period = 0;
+			ref->done = false;
+			if (rand_u32() % 8) {
+				ref->timer_id = add_timer(game, TIMER_COOLDOWN, ref->owner_id, delay);
+			} else {
+				ref->period = delay;
+				ref->timer_id = add_periodic_timer(game, TIMER_COOLDOWN, ref->owner_id, delay);
+			}
+			++num_live;
+		}
+
+		if (num_refs && !(rand_u32() % 4)) {
+			Timer_Ref *ref = &refs[rand_u32() % num_refs];
+			if (!ref->done) {
+				remove_timer(game, ref->timer_id);
+				ref->done = true;
+				--num_live;
+			}
+		}
+		if (num_refs && !(rand_u32() % 4)) {
+			Timer_Ref *ref = &refs[rand_u32() % num_refs];
+			if (ref->owner_id) {
+				u32 index = entity_id_index(ref->owner_id);
+				game->entity_generations[index] = (u16)((game->entity_generations[index] + 1) & ENTITY_ID_GENERATION_MASK);
+				game->entities[game->entity_slots[index]].id = make_entity_id(index, game->entity_generations[index]);
+			}
+		}
+
+		++game->turn;
+		game_do_timers(game);
+
+		for (u32 i = 0; i < num_refs; ++i) {
+			Timer_Ref *ref = &refs[i];
+			if (!ref->done && ref->turn == game->turn) {
+				++num_fired;
+				bool owner_dead = ref->owner_id && !entity_id_is_live(game, ref->owner_id);
+				if (ref->period && !owner_dead) {
+					ref->turn += ref->period;
+				} else {
+					ref->done = true;
+					--num_live;
+				}
+			}
+			if (timer_is_pending(game, ref->timer_id) == ref->done) {
+				++num_bad;
+			}
+		}
+
+		// drop the finished ones now and again, once they've been checked for a while
+		if (num_refs > CHECK_TIMERS_MAX_REFS - 64 || !(step % 1024)) {
+			u32 kept = 0;
+			for (u32 i = 0; i < num_refs; ++i) {
+				if (!refs[i].done) {
+					refs[kept++] = refs[i];
+				}
+			}
+			num_refs = kept;
+		}
+	}
+
+	printf("%u turns, %llu timers fired, %u live at the end, %llu bad\n",
+	       num_turns, (unsigned long long)num_fired, num_live, (unsigned long long)num_bad);
+
+	free(refs);
+	free(game);
+	return num_bad ? 2 : 0;
+}
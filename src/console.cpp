@@ -87,10 +87,44 @@ static int l_write_log(lua_State* lua_state)
 	return 0;
 }
 
+static int l_log_level(lua_State* lua_state)
+{
+	i32 num_args = lua_gettop(lua_state);
+	if (num_args != 2) {
+		return luaL_error(lua_state, "Lua function 'log_level' expected 2 arguments, got %d!", num_args);
+	}
+
+	auto category_name = luaL_checkstring(lua_state, 1);
+	auto level_name = luaL_checkstring(lua_state, 2);
+
+	u32 category = 0;
+	while (category < NUM_LOG_CATEGORIES && strcmp(category_name, LOG_CATEGORY_NAMES[category])) {
+		++category;
+	}
+	if (category == NUM_LOG_CATEGORIES) {
+		return luaL_error(lua_state, "Unknown log category '%s'!", category_name);
+	}
+	u32 level = 0;
+	while (level < NUM_LOG_LEVELS && strcmp(level_name, LOG_LEVEL_NAMES[level])) {
+		++level;
+	}
+	if (level == NUM_LOG_LEVELS) {
+		return luaL_error(lua_state, "Unknown log level '%s'!", level_name);
+	}
+	if (level > LOG_MAX_LEVEL) {
+		return luaL_error(lua_state, "Log level '%s' is compiled out of this build!", level_name);
+	}
+
+	log_category_levels[category] = (Log_Level)level;
+
+	return 0;
+}
+
 void init(Console* console, v2_u32 size, lua_State* lua_state)
 {
 	memset(console, 0, sizeof(*console));
 	init(&console->log, console->history_buffer, ARRAY_SIZE(console->history_buffer));
+	init_records(&console->log, console->log_records, ARRAY_SIZE(console->log_records));
 
 	console->log.grid_size = v2_u32(size.w, size.h - 1);
 	console->lua_state = lua_state;
@@ -106,6 +140,9 @@ void init(Console* console, v2_u32 size, lua_State* lua_state)
 	lua_pushlightuserdata(lua_state, console);
 	lua_pushcclosure(lua_state, l_write_log, 1);
 	lua_setglobal(lua_state, "write_log_to_file");
+
+	lua_pushcfunction(lua_state, l_log_level);
+	lua_setglobal(lua_state, "log_level");
 }
 
 bool handle_input(Console* console, Input* input)
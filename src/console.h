@@ -9,6 +9,7 @@
 
 #define CONSOLE_INPUT_BUFFER_LENGTH    512
 #define CONSOLE_HISTORY_BUFFER_LENGTH  65536
+#define CONSOLE_LOG_RECORDS_LENGTH     65536
 
 struct Console
 {
@@ -18,6 +19,7 @@ struct Console
 	f32 blink_offset;
 	Log log;
 	char history_buffer[CONSOLE_HISTORY_BUFFER_LENGTH];
+	u8 log_records[CONSOLE_LOG_RECORDS_LENGTH];
 };
 
 void init(Console* console, v2_u32 size, lua_State* lua_state);
@@ -59,20 +59,12 @@ typedef Max_Length_Array<Action, GAME_MAX_ACTIONS> Action_Buffer;
 #define MAX_EVENTS 10240
 
 // maybe better called "world state"?
-Entity_ID game_new_entity_id(Game *game)
-{
-	return game->next_entity_id++;
-}
-
 Entity_ID game_get_player_id(Game* game)
 {
-	auto& controllers = game->controllers;
+	auto& controllers = game->controllers.player;
 	Entity_ID player_id = 0;
-	for (u32 i = 0; i < controllers.len; ++i) {
-		if (controllers[i].type == CONTROLLER_PLAYER) {
-			player_id = controllers[i].player.entity_id;
-			break;
-		}
+	if (controllers) {
+		player_id = controllers[0].entity_id;
 	}
 	ASSERT(player_id);
 	return player_id;
@@ -393,6 +385,45 @@ enum Program_Input_State
 #undef PROGRAM_INPUT_STATE
 };
 
+// =============================================================================
+// level pipeline
+
+// Levels are generated ahead of time as jobs on the work queue, each into its
+// own Game with its own RNG stream (the pipeline's seed mixed with the level's
+// index), so the next level's contents don't depend on what happened in this one
+// or on thread timing. Taking a level copies the ready Game in and starts
+// generating the one num_ahead levels further on. Each slot has its own work
+// group, so waiting on a level runs it here if no worker has got to it yet.
+
+#define LEVEL_PIPELINE_MAX_AHEAD 4
+#define LEVEL_PIPELINE_DECK_SIZE 100
+
+enum Level_Slot_State
+{
+	LEVEL_SLOT_EMPTY,
+	LEVEL_SLOT_GENERATING,
+	LEVEL_SLOT_READY,
+};
+
+struct Level_Pipeline_Slot
+{
+	u32 volatile         state;
+	Build_Level_Function build;
+	u32                  seed;
+	Work_Group           group;
+	Game                 game;
+};
+
+struct Level_Pipeline
+{
+	Work_Queue          *queue;
+	Build_Level_Function build;
+	u32                  seed;
+	u32                  num_ahead;
+	u32                  next_level;
+	Level_Pipeline_Slot *slots;
+};
+
 char *PROGRAM_INPUT_STATE_NAMES[] = {
 #define PROGRAM_INPUT_STATE(name) #name,
 	PROGRAM_INPUT_STATES
@@ -421,6 +452,8 @@ struct Program
 
 	u8                                 display_debug_ui;
 	Game                               game;
+	Level_Pipeline                     level_pipeline;
+	Work_Queue                         work_queue;
 
 	Stack<Program_Input_State, MAX_PROGRAM_INPUT_STATES> program_input_state_stack;
 	u32                                           cur_card_param;
@@ -460,6 +493,14 @@ void set_global_state(Program* program)
 	program->draw->debug_draw_world.set_current();
 }
 
+static void add_random_cards(Game* game, u32 n)
+{
+	for (u32 i = 0; i < n; ++i) {
+		auto appearance = (Card_Appearance)(rand_u32() % NUM_CARD_APPEARANCES);
+		add_card(game, appearance);
+	}
+}
+
 void build_deck_random_n(Program *program, u32 n)
 {
 	// cards
@@ -468,10 +509,7 @@ void build_deck_random_n(Program *program, u32 n)
 	// memset(card_state, 0, sizeof(*card_state));
 	memset(card_anim_state, 0, sizeof(*card_anim_state));
 
-	for (u32 i = 0; i < n; ++i) {
-		auto appearance = (Card_Appearance)(rand_u32() % NUM_CARD_APPEARANCES);
-		add_card(&program->game, appearance);
-	}
+	add_random_cards(&program->game, n);
 }
 
 void build_lightning_deck(Program *program)
@@ -513,20 +551,175 @@ void load_assets(void* uncast_program)
 	sound_player_load_sounds(&program->sound, &program->assets_header);
 }
 
-void program_init_level(Program* program, Build_Level_Function build, Log* log)
+static u32 level_pipeline_level_seed(u32 seed, u32 level)
 {
-	build(&program->game, log);
-	build_deck_random_n(program, 100);
+	u32 x = seed ^ (level * 0x9E3779B9);
+	x ^= x >> 16;
+	x *= 0x7FEB352D;
+	x ^= x >> 15;
+	x *= 0x846CA68B;
+	x ^= x >> 16;
+	return x;
+}
+
+static void level_pipeline_generate(void* uncast_slot)
+{
+	Level_Pipeline_Slot *slot = (Level_Pipeline_Slot*)uncast_slot;
+
+	// the RNG functions are per thread so this doesn't touch the frame thread's
+	MT19937 *random_state = (MT19937*)malloc(sizeof(MT19937));
+	random_state->seed(slot->seed);
+	random_state->set_current();
+
+	// no log -- the console's isn't safe to write from here
+	slot->build(&slot->game, NULL);
+	add_random_cards(&slot->game, LEVEL_PIPELINE_DECK_SIZE);
+	slot->game.random_seed = rand_u32();
+
+	free(random_state);
+
+	auto orig_value = interlocked_compare_exchange(&slot->state, LEVEL_SLOT_READY, LEVEL_SLOT_GENERATING);
+	ASSERT(orig_value == LEVEL_SLOT_GENERATING);
+}
+
+static void level_pipeline_fill(Level_Pipeline* pipeline)
+{
+	for (u32 i = 0; i < pipeline->num_ahead; ++i) {
+		u32 level = pipeline->next_level + i;
+		Level_Pipeline_Slot *slot = &pipeline->slots[level % pipeline->num_ahead];
+		if (slot->state != LEVEL_SLOT_EMPTY) {
+			continue;
+		}
+		slot->state = LEVEL_SLOT_GENERATING;
+		slot->build = pipeline->build;
+		slot->seed = level_pipeline_level_seed(pipeline->seed, level);
+		work_queue_add(pipeline->queue, &slot->group, level_pipeline_generate, slot);
+	}
+}
+
+static void level_pipeline_wait(Level_Pipeline* pipeline)
+{
+	for (u32 i = 0; i < pipeline->num_ahead; ++i) {
+		work_group_wait(pipeline->queue, &pipeline->slots[i].group);
+	}
+}
+
+// Starts generating the next num_ahead levels with build. Anything already in
+// flight is waited for and thrown away.
+void level_pipeline_start(Level_Pipeline* pipeline, Work_Queue* queue, Build_Level_Function build, u32 seed, u32 num_ahead)
+{
+	ASSERT(num_ahead && num_ahead <= LEVEL_PIPELINE_MAX_AHEAD);
+
+	if (pipeline->slots) {
+		level_pipeline_wait(pipeline);
+	} else {
+		pipeline->slots = (Level_Pipeline_Slot*)malloc(LEVEL_PIPELINE_MAX_AHEAD * sizeof(Level_Pipeline_Slot));
+		for (u32 i = 0; i < LEVEL_PIPELINE_MAX_AHEAD; ++i) {
+			work_group_init(&pipeline->slots[i].group);
+		}
+	}
+	for (u32 i = 0; i < LEVEL_PIPELINE_MAX_AHEAD; ++i) {
+		pipeline->slots[i].state = LEVEL_SLOT_EMPTY;
+	}
+
+	pipeline->queue = queue;
+	pipeline->build = build;
+	pipeline->seed = seed;
+	pipeline->num_ahead = num_ahead;
+	pipeline->next_level = 0;
+	level_pipeline_fill(pipeline);
+}
+
+// Copies the next level into game -- waits for it if it isn't done yet -- and
+// queues up the one after the levels already ahead.
+void level_pipeline_take(Level_Pipeline* pipeline, Game* game)
+{
+	ASSERT(pipeline->slots);
+
+	Level_Pipeline_Slot *slot = &pipeline->slots[pipeline->next_level % pipeline->num_ahead];
+	work_group_wait(pipeline->queue, &slot->group);
+	ASSERT(slot->state == LEVEL_SLOT_READY);
+	memcpy(game, &slot->game, sizeof(*game));
+	slot->state = LEVEL_SLOT_EMPTY;
+
+	++pipeline->next_level;
+	level_pipeline_fill(pipeline);
+}
+
+void level_pipeline_free(Level_Pipeline* pipeline)
+{
+	if (pipeline->slots) {
+		level_pipeline_wait(pipeline);
+		for (u32 i = 0; i < LEVEL_PIPELINE_MAX_AHEAD; ++i) {
+			work_group_free(&pipeline->slots[i].group);
+		}
+		free(pipeline->slots);
+	}
+	memset(pipeline, 0, sizeof(*pipeline));
+}
+
+// Per level state outside the Game -- has to be done on the frame thread.
+static void program_start_level(Program* program)
+{
+	memset(&program->anim_state, 0, sizeof(program->anim_state));
 
 	program->anim_state.camera.zoom = 14.0f;
 	Pos player_pos = game_get_player_pos(&program->game);
 	program->anim_state.camera.world_center = (v2)player_pos;
 
-	memset(&program->anim_state, 0, sizeof(program->anim_state));
 	program->anim_state.draw = program->draw;
 	init(&program->anim_state, &program->game);
 }
 
+// Builds a level right now, on this thread. For debugging builders from the
+// console -- normal play takes levels from the pipeline.
+void program_init_level(Program* program, Build_Level_Function build, Log* log)
+{
+	build(&program->game, log);
+	add_random_cards(&program->game, LEVEL_PIPELINE_DECK_SIZE);
+	program->game.random_seed = rand_u32();
+	program_start_level(program);
+}
+
+void program_next_level(Program* program)
+{
+	level_pipeline_take(&program->level_pipeline, &program->game);
+	program_start_level(program);
+}
+
+static int l_next_level(lua_State* lua_state)
+{
+	i32 num_args = lua_gettop(lua_state);
+	if (num_args != 0) {
+		return luaL_error(lua_state, "Lua function 'next_level' expected 0 arguments, got %d!", num_args);
+	}
+	auto program = (Program*)lua_touserdata(lua_state, lua_upvalueindex(1));
+
+	program_next_level(program);
+
+	return 0;
+}
+
+static int l_levels_ahead(lua_State* lua_state)
+{
+	i32 num_args = lua_gettop(lua_state);
+	if (num_args != 1) {
+		return luaL_error(lua_state, "Lua function 'levels_ahead' expected 1 arguments, got %d!", num_args);
+	}
+	lua_Integer num_ahead = luaL_checkinteger(lua_state, 1);
+	if (num_ahead < 1 || num_ahead > LEVEL_PIPELINE_MAX_AHEAD) {
+		return luaL_error(lua_state, "Lua function 'levels_ahead' expects a number from 1 to %d!",
+		                  LEVEL_PIPELINE_MAX_AHEAD);
+	}
+	auto program = (Program*)lua_touserdata(lua_state, lua_upvalueindex(1));
+
+	// restarts the pipeline, levels already generated are thrown away
+	Level_Pipeline *pipeline = &program->level_pipeline;
+	level_pipeline_start(pipeline, pipeline->queue, pipeline->build, rand_u32(), (u32)num_ahead);
+
+	return 0;
+}
+
 static int l_build_level(lua_State* lua_state)
 {
 	i32 num_args = lua_gettop(lua_state);
@@ -636,6 +829,14 @@ void program_init(Program* program, Draw* draw, Render* render, Platform_Functio
 		lua_pushcclosure(lua_state, l_random_cards, 1);
 		lua_setglobal(lua_state, "random_cards");
 
+		lua_pushlightuserdata(lua_state, program);
+		lua_pushcclosure(lua_state, l_next_level, 1);
+		lua_setglobal(lua_state, "next_level");
+
+		lua_pushlightuserdata(lua_state, program);
+		lua_pushcclosure(lua_state, l_levels_ahead, 1);
+		lua_setglobal(lua_state, "levels_ahead");
+
 		for (u32 i = 0; i < NUM_LEVEL_GEN_FUNCS; ++i) {
 			auto func_data = &BUILD_LEVEL_FUNCS[i];
 			lua_pushlightuserdata(lua_state, program);
@@ -662,8 +863,14 @@ void program_init(Program* program, Draw* draw, Render* render, Platform_Functio
 	program->draw->boxy_bold.tex_size = boxy_bold_texture_size;
 	program->draw->boxy_bold.tex_data = boxy_bold_pixel_data;
 
+	// one core is left for the frame thread
+	u32 num_workers = min_u32(get_num_processors() - 1, WORK_QUEUE_MAX_WORKERS);
+	work_queue_init(&program->work_queue, num_workers);
+	level_gen_set_work_queue(&program->work_queue);
+
 	// build_level_default(program);
-	program_init_level(program, build_level_spider_room, NULL);
+	level_pipeline_start(&program->level_pipeline, &program->work_queue, build_level_spider_room, rand_u32(), 1);
+	program_next_level(program);
 
 	program->sound.set_ambience(SOUND_CARD_GAME_AMBIENCE_CAVE);
 
@@ -768,6 +975,10 @@ void process_frame_aux(Program* program, Input* input, v2_u32 screen_size)
 
 	if (program->program_input_state_stack.peek() == GIS_ANIMATING && !is_animating(&program->anim_state)) {
 		program->program_input_state_stack.pop();
+		// on to the next level once the last creature's death has played out
+		if (game_is_level_cleared(&program->game)) {
+			program_next_level(program);
+		}
 	}
 
 	auto ui_mouse_over = get_mouse_over(&program->anim_state, input->mouse_pos, screen_size);
@@ -787,8 +998,11 @@ void process_frame_aux(Program* program, Input* input, v2_u32 screen_size)
 			case UI_MOUSE_OVER_ENTITY: {
 				auto entity = get_entity_by_id(&program->game, ui_mouse_over.entity.entity_id);
 				Action_Type action_type = ACTION_MOVE;
-				if (entity && entity->default_action) {
-					action_type = entity->default_action;
+				if (entity) {
+					auto info = get_entity_info(&program->game, entity);
+					if (info->default_action) {
+						action_type = info->default_action;
+					}
 				}
 				switch (action_type) {
 				case ACTION_MOVE: {
@@ -1098,13 +1312,14 @@ void process_frame_aux(Program* program, Input* input, v2_u32 screen_size)
 	}
 
 	// do sprite tooltip
-	if (sprite_id && sprite_id < MAX_ENTITIES) {
+	if (sprite_id && !entity_id_is_tile(sprite_id)) {
 		// XXX
 		program->draw->boxy_bold.instances.reset();
 
 		Entity *e = get_entity_by_id(&program->game, sprite_id);
 		if (e) {
-			char *buffer = fmt("%d/%d", e->hit_points, e->max_hit_points);
+			Entity_Info *info = get_entity_info(&program->game, e);
+			char *buffer = fmt("%d/%d", info->hit_points, info->max_hit_points);
 
 			u32 width = 1, height = 0;
 			for (u8 *p = (u8*)buffer; *p; ++p) {
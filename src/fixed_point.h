@@ -0,0 +1,90 @@
+#ifndef JFG_FIXED_POINT_H
+#define JFG_FIXED_POINT_H
+
+#include "prelude.h"
+#include <math.h>
+
+// Signed fixed point numbers with FIXED_POINT_FRACTION_BITS fractional bits --
+// 16 gives Q16.16, 8 gives Q24.8. Only integer ops are used between the
+// conversions so results are the same for any compiler, optimisation level or
+// instruction set.
+//
+// Values are carried around as i64 so products and shifted dividends have room
+// to spare -- they are only narrowed by the caller when stored.
+
+#ifndef FIXED_POINT_FRACTION_BITS
+#define FIXED_POINT_FRACTION_BITS 16
+#endif
+
+STATIC_ASSERT(FIXED_POINT_FRACTION_BITS == 16 || FIXED_POINT_FRACTION_BITS == 8,
+              fixed_point_must_be_q16_16_or_q24_8);
+
+typedef i64 fixed;
+
+#define FIXED_ONE ((fixed)1 << FIXED_POINT_FRACTION_BITS)
+
+// round to nearest. Scaling by a power of two is exact in f64 so this doesn't
+// depend on the float environment
+static inline fixed f32_to_fixed(f32 x)
+{
+	return (fixed)floor((f64)x * (f64)FIXED_ONE + 0.5);
+}
+
+static inline f32 fixed_to_f32(fixed x)
+{
+	return (f32)((f64)x / (f64)FIXED_ONE);
+}
+
+static inline fixed fixed_mul(fixed a, fixed b)
+{
+	return (a * b) >> FIXED_POINT_FRACTION_BITS;
+}
+
+// truncates towards zero, b must not be zero
+static inline fixed fixed_div(fixed a, fixed b)
+{
+	return (a * FIXED_ONE) / b;
+}
+
+static inline fixed fixed_abs(fixed a)
+{
+	return a < 0 ? -a : a;
+}
+
+static inline fixed fixed_min(fixed a, fixed b)
+{
+	return a < b ? a : b;
+}
+
+static inline fixed fixed_max(fixed a, fixed b)
+{
+	return a > b ? a : b;
+}
+
+// floor(sqrt(x)) by the bit by bit method
+static inline u64 isqrt_u64(u64 x)
+{
+	u64 result = 0;
+	u64 bit = (u64)1 << 62;
+	while (bit > x) {
+		bit >>= 2;
+	}
+	while (bit) {
+		if (x >= result + bit) {
+			x -= result + bit;
+			result = (result >> 1) + bit;
+		} else {
+			result >>= 1;
+		}
+		bit >>= 2;
+	}
+	return result;
+}
+
+// a must not be negative
+static inline fixed fixed_sqrt(fixed a)
+{
+	return (fixed)isqrt_u64((u64)a << FIXED_POINT_FRACTION_BITS);
+}
+
+#endif
@@ -2,47 +2,181 @@
 
 #include "stdafx.h"
 
-static void render_aux(Field_Of_Vision* _fov, Render_Job_Buffer* render_buffer, FOV_State state)
+typedef u64 FOV_Row[FOV_ROW_WORDS];
+
+// bit x of the result is bit x - 1 of the input
+static inline void fov_row_shift_left(FOV_Row out, const FOV_Row in)
+{
+	out[0] = in[0] << 1;
+	for (u32 i = 1; i < FOV_ROW_WORDS; ++i) {
+		out[i] = (in[i] << 1) | (in[i - 1] >> 63);
+	}
+}
+
+// bit x of the result is bit x + 1 of the input
+static inline void fov_row_shift_right(FOV_Row out, const FOV_Row in)
+{
+	for (u32 i = 0; i < FOV_ROW_WORDS - 1; ++i) {
+		out[i] = (in[i] >> 1) | (in[i + 1] << 63);
+	}
+	out[FOV_ROW_WORDS - 1] = in[FOV_ROW_WORDS - 1] >> 1;
+}
+
+static inline u8 fov_row_get(const FOV_Row row, u32 x)
+{
+	return (u8)((row[x / 64] >> (x % 64)) & 1);
+}
+
+static void fov_layer_remove_cell(Field_Of_Vision_Render_Layer* layer, u16 cell)
+{
+	auto &cells = layer->cell_type[cell] == FOV_CELL_FILL ? layer->fill_cells : layer->edge_cells;
+	u16 slot = layer->cell_slot[cell];
+	cells.remove(slot);
+	if (slot < cells.len) {
+		layer->cell_slot[cells[slot]] = slot;
+	}
+	layer->cell_type[cell] = FOV_CELL_NONE;
+}
+
+static void fov_layer_add_cell(Field_Of_Vision_Render_Layer* layer, u16 cell, FOV_Cell_Type type)
 {
-	auto &fov = *_fov;
-	for (u32 y = 1; y < 255; ++y) {
-		for (u32 x = 1; x < 255; ++x) {
-			bool tl = fov[Pos(x - 1, y - 1)] >= state;
-			bool t  = fov[Pos(    x, y - 1)] >= state;
-			bool tr = fov[Pos(x + 1, y - 1)] >= state;
-			bool l  = fov[Pos(x - 1,     y)] >= state;
-			bool c  = fov[Pos(    x,     y)] >= state;
-			bool r  = fov[Pos(x + 1,     y)] >= state;
-			bool bl = fov[Pos(x - 1, y + 1)] >= state;
-			bool b  = fov[Pos(    x, y + 1)] >= state;
-			bool br = fov[Pos(x + 1, y + 1)] >= state;
-			u8 mask = 0;
-			if (t)  { mask |= 0x01; }
-			if (tr) { mask |= 0x02; }
-			if (r)  { mask |= 0x04; }
-			if (br) { mask |= 0x08; }
-			if (b)  { mask |= 0x10; }
-			if (bl) { mask |= 0x20; }
-			if (l)  { mask |= 0x40; }
-			if (tl) { mask |= 0x80; }
-			if (c && mask == 0xFF) {
-				Field_Of_Vision_Fill_Instance instance = {};
-				instance.world_coords = v2((f32)x, (f32)y);
-				push_fov_fill(render_buffer, instance);
-			} else if (c) {
-				Field_Of_Vision_Edge_Instance instance = {};
-				instance.world_coords = v2((f32)x, (f32)y);
-				instance.sprite_coords = v2((f32)(mask % 16), (f32)(15 - mask / 16));
-				push_fov_edge(render_buffer, instance);
+	auto &cells = type == FOV_CELL_FILL ? layer->fill_cells : layer->edge_cells;
+	layer->cell_slot[cell] = (u16)cells.len;
+	cells.append(cell);
+	layer->cell_type[cell] = type;
+}
+
+static void update_layer(Field_Of_Vision_Render_Layer* layer, const FOV_Row* new_rows)
+{
+	// find which rows changed since the last render
+	FOV_Row changed[256];
+	u32 dirty_min_y = 256, dirty_max_y = 0;
+	for (u32 y = 0; y < 256; ++y) {
+		u64 any_changed = 0;
+		for (u32 w = 0; w < FOV_ROW_WORDS; ++w) {
+			changed[y][w] = new_rows[y][w] ^ layer->rows[y][w];
+			any_changed |= changed[y][w];
+		}
+		if (any_changed) {
+			dirty_min_y = min_u32(dirty_min_y, y);
+			dirty_max_y = max_u32(dirty_max_y, y);
+		}
+	}
+
+	if (dirty_min_y > dirty_max_y) {
+		return;
+	}
+
+	// only cells with x in [1, 254] get instances
+	const FOV_Row inner_columns = { ~(u64)1, ~(u64)0, ~(u64)0, ~((u64)1 << 63) };
+
+	u32 start_y = max_u32(dirty_min_y, 2) - 1;
+	u32 end_y = min_u32(dirty_max_y + 1, 254);
+	for (u32 y = start_y; y <= end_y; ++y) {
+		// dilate the changes by one cell in each direction
+		FOV_Row dirty, dirty_l, dirty_r;
+		u64 any_dirty = 0;
+		for (u32 w = 0; w < FOV_ROW_WORDS; ++w) {
+			dirty[w] = changed[y - 1][w] | changed[y][w] | changed[y + 1][w];
+		}
+		fov_row_shift_left(dirty_l, dirty);
+		fov_row_shift_right(dirty_r, dirty);
+		for (u32 w = 0; w < FOV_ROW_WORDS; ++w) {
+			dirty[w] = (dirty[w] | dirty_l[w] | dirty_r[w]) & inner_columns[w];
+			any_dirty |= dirty[w];
+		}
+		if (!any_dirty) {
+			continue;
+		}
+
+		const u64 *above = new_rows[y - 1], *centre = new_rows[y], *below = new_rows[y + 1];
+		FOV_Row tl, tr, l, r, bl, br;
+		fov_row_shift_left(tl, above);
+		fov_row_shift_right(tr, above);
+		fov_row_shift_left(l, centre);
+		fov_row_shift_right(r, centre);
+		fov_row_shift_left(bl, below);
+		fov_row_shift_right(br, below);
+
+		FOV_Row fill;
+		for (u32 w = 0; w < FOV_ROW_WORDS; ++w) {
+			fill[w] = centre[w] & above[w] & below[w] & l[w] & r[w]
+			        & tl[w] & tr[w] & bl[w] & br[w];
+		}
+
+		for (u32 w = 0; w < FOV_ROW_WORDS; ++w) {
+			u64 bits = dirty[w];
+			while (bits) {
+				u32 x = w * 64 + count_trailing_zeros(bits);
+				bits &= bits - 1;
+
+				u16 cell = pos_to_u16(Pos((u8)x, (u8)y));
+				FOV_Cell_Type type = FOV_CELL_NONE;
+				u8 mask = 0;
+				if (fill[w] & ((u64)1 << (x % 64))) {
+					type = FOV_CELL_FILL;
+				} else if (centre[w] & ((u64)1 << (x % 64))) {
+					type = FOV_CELL_EDGE;
+					mask = fov_row_get(above, x)      << 0
+					     | fov_row_get(tr, x)         << 1
+					     | fov_row_get(r, x)          << 2
+					     | fov_row_get(br, x)         << 3
+					     | fov_row_get(below, x)      << 4
+					     | fov_row_get(bl, x)         << 5
+					     | fov_row_get(l, x)          << 6
+					     | fov_row_get(tl, x)         << 7;
+				}
+
+				FOV_Cell_Type old_type = layer->cell_type[cell];
+				layer->cell_mask[cell] = mask;
+				if (old_type == type) {
+					continue;
+				}
+				if (old_type != FOV_CELL_NONE) {
+					fov_layer_remove_cell(layer, cell);
+				}
+				if (type != FOV_CELL_NONE) {
+					fov_layer_add_cell(layer, cell, type);
+				}
 			}
 		}
 	}
+
+	memcpy(layer->rows[dirty_min_y], new_rows[dirty_min_y], (dirty_max_y - dirty_min_y + 1) * sizeof(FOV_Row));
+}
+
+static void render_aux(Field_Of_Vision_Render_Layer* layer, Render_Job_Buffer* render_buffer)
+{
+	for (u32 i = 0; i < layer->fill_cells.len; ++i) {
+		Pos p = u16_to_pos(layer->fill_cells[i]);
+		Field_Of_Vision_Fill_Instance instance = {};
+		instance.world_coords = v2((f32)p.x, (f32)p.y);
+		push_fov_fill(render_buffer, instance);
+	}
+	for (u32 i = 0; i < layer->edge_cells.len; ++i) {
+		u16 cell = layer->edge_cells[i];
+		Pos p = u16_to_pos(cell);
+		u8 mask = layer->cell_mask[cell];
+		Field_Of_Vision_Edge_Instance instance = {};
+		instance.world_coords = v2((f32)p.x, (f32)p.y);
+		instance.sprite_coords = v2((f32)(mask % 16), (f32)(15 - mask / 16));
+		push_fov_edge(render_buffer, instance);
+	}
+}
+
+void reset(Field_Of_Vision_Render_Cache* cache)
+{
+	// an all clear layer with no instances is a valid cached state
+	memset(cache, 0, sizeof(*cache));
 }
 
-void render(Field_Of_Vision* fov, Render* render)
+void render(Field_Of_Vision* fov, Field_Of_Vision_Render_Cache* cache, Render* render)
 {
 	auto r = &render->render_job_buffer;
 
+	update_layer(&cache->prev_seen, fov->prev_seen_rows);
+	update_layer(&cache->visible, fov->visible_rows);
+
 	Field_Of_Vision_Render_Constant_Buffer constants = {};
 	constants.grid_size = v2(256.0f, 256.0f);
 	constants.sprite_size = v2(24.0f, 24.0f);
@@ -54,27 +188,50 @@ void render(Field_Of_Vision* fov, Render* render)
 	clear_uint(r, TARGET_TEXTURE_FOV_RENDER);
 
 	begin_fov(r, TARGET_TEXTURE_FOV_RENDER, constants);
-	render_aux(fov, r, FOV_PREV_SEEN);
+	render_aux(&cache->prev_seen, r);
 
 	constants.output_val = 2;
 	begin_fov(r, TARGET_TEXTURE_FOV_RENDER, constants);
-	render_aux(fov, r, FOV_VISIBLE);
+	render_aux(&cache->visible, r);
 
 	end(r, RENDER_EVENT_FOV_PRECOMPUTE);
 }
 
-void update(Field_Of_Vision* _fov, Map_Cache_Bool* can_see)
+void update(Field_Of_Vision* fov, Map_Cache_Bool* can_see)
+{
+	// can_see is laid out like the packed rows, so only the bits that flip
+	// between visible and not touch the states
+	for (u32 y = 0; y < 256; ++y) {
+		for (u32 w = 0; w < FOV_ROW_WORDS; ++w) {
+			u64 can_see_now = can_see->items[y * FOV_ROW_WORDS + w];
+			u64 flipped = can_see_now ^ fov->visible_rows[y][w];
+			if (!flipped) {
+				continue;
+			}
+			fov->visible_rows[y][w] = can_see_now;
+			fov->prev_seen_rows[y][w] |= can_see_now;
+			FOV_State *row = &fov->states.items[y * 256 + w * 64];
+			while (flipped) {
+				u32 b = count_trailing_zeros(flipped);
+				flipped &= flipped - 1;
+				row[b] = (can_see_now >> b) & 1 ? FOV_VISIBLE : FOV_PREV_SEEN;
+			}
+		}
+	}
+}
+
+void pack_rows(Field_Of_Vision* fov)
 {
-	auto &fov = *_fov;
 	for (u32 y = 0; y < 256; ++y) {
-		for (u32 x = 0; x < 256; ++x) {
-			Pos p = Pos(x, y);
-			u64 can_see_now = can_see->get(p);
-			if (can_see_now) {
-				fov[p] = FOV_VISIBLE;
-			} else if (fov[p] == FOV_VISIBLE) {
-				fov[p] = FOV_PREV_SEEN;
+		FOV_State *row = &fov->states.items[y * 256];
+		for (u32 w = 0; w < FOV_ROW_WORDS; ++w) {
+			u64 prev_seen = 0, visible = 0;
+			for (u32 b = 0; b < 64; ++b) {
+				prev_seen |= (u64)(row[w * 64 + b] >= FOV_PREV_SEEN) << b;
+				visible   |= (u64)(row[w * 64 + b] >= FOV_VISIBLE)   << b;
 			}
+			fov->prev_seen_rows[y][w] = prev_seen;
+			fov->visible_rows[y][w] = visible;
 		}
 	}
 }
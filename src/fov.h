@@ -11,9 +11,48 @@ enum FOV_State
 	FOV_VISIBLE,
 };
 
-typedef Map_Cache<FOV_State> Field_Of_Vision;
+#define FOV_ROW_WORDS (256 / 64)
+
+// Rows are bit packed copies of states >= FOV_PREV_SEEN and >= FOV_VISIBLE.
+// update() keeps them in step with the states, so anything else writing states
+// directly has to call pack_rows() afterwards.
+struct Field_Of_Vision
+{
+	Map_Cache<FOV_State> states;
+	u64                  prev_seen_rows[256][FOV_ROW_WORDS];
+	u64                  visible_rows[256][FOV_ROW_WORDS];
+
+	FOV_State& operator[](Pos pos) { return states[pos]; }
+};
+
+enum FOV_Cell_Type : u8
+{
+	FOV_CELL_NONE,
+	FOV_CELL_FILL,
+	FOV_CELL_EDGE,
+};
+
+// Fill/edge instances for one FOV state threshold. Rows are the packed rows
+// last rendered, so only cells whose 3x3 neighbourhood changed since are rebuilt.
+struct Field_Of_Vision_Render_Layer
+{
+	u64                              rows[256][FOV_ROW_WORDS];
+	FOV_Cell_Type                    cell_type[256 * 256];
+	u8                               cell_mask[256 * 256];
+	u16                              cell_slot[256 * 256];
+	Max_Length_Array<u16, 256 * 256> fill_cells;
+	Max_Length_Array<u16, 256 * 256> edge_cells;
+};
+
+struct Field_Of_Vision_Render_Cache
+{
+	Field_Of_Vision_Render_Layer prev_seen;
+	Field_Of_Vision_Render_Layer visible;
+};
 
 void calculate_fov(Map_Cache_Bool* result, Map_Cache_Bool* visibility_grid, Pos pos);
 void update(Field_Of_Vision* fov, Map_Cache_Bool* can_see);
+void pack_rows(Field_Of_Vision* fov);
 
-void render(Field_Of_Vision* fov, Render* render);
\ No newline at end of file
+void reset(Field_Of_Vision_Render_Cache* cache);
+void render(Field_Of_Vision* fov, Field_Of_Vision_Render_Cache* cache, Render* render);
\ No newline at end of file
@@ -5,94 +5,106 @@
 #include "physics.h"
 #include "constants.h"
 
+// What a draw is for -- part of the stream's key so two kinds of draw by the
+// same entity on the same turn never share values.
+enum Random_Purpose
+{
+	RANDOM_PURPOSE_MOVE,
+	RANDOM_PURPOSE_TARGET,
+	RANDOM_PURPOSE_LICH_SUCCESSOR,
+	RANDOM_PURPOSE_TRAP_SPAWN,
+	RANDOM_PURPOSE_SLIME_SPLIT,
+};
+
+// A stream for one entity's draws of one kind this turn. The values depend only
+// on the key, not on how many draws other entities made before it, so the order
+// controllers and handlers run in doesn't change the outcome. sub_key tells apart
+// draws of the same kind for the same entity in one turn -- it has 24 bits.
+static Philox game_random_stream(Game* game, Entity_ID entity_id, Random_Purpose purpose, u32 sub_key = 0)
+{
+	ASSERT(sub_key < (1 << 24));
+	Philox result;
+	result.seed(game->random_seed, game->turn, entity_id, purpose | (sub_key << 8));
+	return result;
+}
+
+// Reuses the most recently freed index first, so the live indices -- and the
+// tables indexed by them -- stay packed at the bottom.
 static Entity_ID new_entity_id(Game* game)
 {
-	return game->next_entity_id++;
+	u32 index;
+	if (game->free_entity_indices) {
+		index = game->free_entity_indices.pop();
+	} else {
+		ASSERT(game->next_entity_index < MAX_ENTITIES);
+		index = game->next_entity_index++;
+	}
+	game->has_acted.unset(index);
+	return make_entity_id(index, game->entity_generations[index]);
+}
+
+static void free_entity_id(Game* game, Entity_ID entity_id)
+{
+	u32 index = entity_id_index(entity_id);
+	game->entity_generations[index] = (u16)((game->entity_generations[index] + 1) & ENTITY_ID_GENERATION_MASK);
+	game->free_entity_indices.append((u16)index);
+}
+
+// for the pools whose controllers drive a single entity
+template <typename T, u32 size>
+static bool remove_controller_of(Max_Length_Array<T, size>* pool, Entity_ID entity_id)
+{
+	for (u32 i = 0; i < pool->len; ++i) {
+		if (pool->items[i].entity_id == entity_id) {
+			pool->remove(i);
+			return true;
+		}
+	}
+	return false;
 }
 
 static void remove_entity(Game* game, Entity_ID entity_id)
 {
-	u32 num_entities = game->entities.len;
-	Entity *e = game->entities.items;
-	for (u32 i = 0; i < num_entities; ++i, ++e) {
-		if (e->id == entity_id) {
-			game->entities.remove(i);
-			break;
+	if (entity_id_is_live(game, entity_id)) {
+		// the last entity moves into the hole, as Max_Length_Array::remove does
+		u32 slot = game->entity_slots[entity_id_index(entity_id)];
+		u32 last = game->entities.len - 1;
+		game->entities.remove(slot);
+		game->entity_infos[slot] = game->entity_infos[last];
+		if (slot < last) {
+			game->entity_slots[entity_id_index(game->entities[slot].id)] = (u16)slot;
 		}
+		free_entity_id(game, entity_id);
 	}
 
-	auto& controllers = game->controllers;
-	for (u32 i = 0; i < controllers.len; ++i) {
-		Controller *c = &controllers[i];
-		switch (c->type) {
-		case CONTROLLER_PLAYER:
-			// TODO -- post player death event?
-			if (c->player.entity_id == entity_id) {
-				controllers.remove(i);
-				goto break_loop;
-			}
-			break;
-		case CONTROLLER_RANDOM_MOVE:
-			if (c->random_move.entity_id == entity_id) {
-				controllers.remove(i);
-				goto break_loop;
-			}
-			break;
-		case CONTROLLER_DRAGON:
-			if (c->dragon.entity_id == entity_id) {
-				controllers.remove(i);
-				goto break_loop;
-			}
-			break;
-		case CONTROLLER_SLIME:
-			if (c->slime.entity_id == entity_id) {
-				controllers.remove(i);
-				goto break_loop;
-			}
-			break;
-		case CONTROLLER_LICH: {
-			// XXX - not sure if this should remove the controller
-			if (c->lich.lich_id == entity_id) {
-				controllers.remove(i);
-				goto break_loop;
-			}
-			auto& skeleton_ids = c->lich.skeleton_ids;
-			u32 num_skeleton_ids = skeleton_ids.len;
-			for (u32 i = 0; i < num_skeleton_ids; ++i) {
-				if (skeleton_ids[i] == entity_id) {
-					skeleton_ids.remove(i);
-					goto break_loop;
-				}
-			}
+	// an entity has at most one controller
+	auto &controllers = game->controllers;
+	// TODO -- post player death event?
+	bool removed = remove_controller_of(&controllers.player, entity_id)
+	            || remove_controller_of(&controllers.random_move, entity_id)
+	            || remove_controller_of(&controllers.dragon, entity_id)
+	            || remove_controller_of(&controllers.slime, entity_id)
+	            || remove_controller_of(&controllers.imp, entity_id)
+	            || remove_controller_of(&controllers.spider_normal, entity_id)
+	            || remove_controller_of(&controllers.spider_web, entity_id)
+	            || remove_controller_of(&controllers.spider_poison, entity_id)
+	            || remove_controller_of(&controllers.spider_shadow, entity_id);
+	for (u32 i = 0; !removed && i < controllers.lich.len; ++i) {
+		Lich_Controller *c = &controllers.lich[i];
+		// XXX - not sure if this should remove the controller
+		if (c->lich_id == entity_id) {
+			controllers.lich.remove(i);
 			break;
 		}
-		case CONTROLLER_SPIDER_NORMAL:
-			if (c->spider_normal.entity_id == entity_id) {
-				controllers.remove(i);
-				goto break_loop;
-			}
-			break;
-		case CONTROLLER_SPIDER_WEB:
-			if (c->spider_web.entity_id == entity_id) {
-				controllers.remove(i);
-				goto break_loop;
-			}
-			break;
-		case CONTROLLER_SPIDER_POISON:
-			if (c->spider_poison.entity_id == entity_id) {
-				controllers.remove(i);
-				goto break_loop;
-			}
-			break;
-		case CONTROLLER_SPIDER_SHADOW:
-			if (c->spider_shadow.entity_id == entity_id) {
-				controllers.remove(i);
-				goto break_loop;
+		auto& skeleton_ids = c->skeleton_ids;
+		for (u32 j = 0; j < skeleton_ids.len; ++j) {
+			if (skeleton_ids[j] == entity_id) {
+				skeleton_ids.remove(j);
+				removed = true;
+				break;
 			}
-			break;
 		}
 	}
-break_loop: ;
 
 	auto& handlers = game->handlers;
 	for (u32 i = 0; i < handlers.len; ) {
@@ -106,18 +118,24 @@ break_loop: ;
 
 Entity* add_entity(Game* game)
 {
+	u32 slot = game->entities.len;
 	auto entity = game->entities.append();
 	memset(entity, 0, sizeof(*entity));
+	memset(&game->entity_infos[slot], 0, sizeof(game->entity_infos[slot]));
 	entity->id = new_entity_id(game);
+	game->entity_slots[entity_id_index(entity->id)] = (u16)slot;
 	return entity;
 }
 
-Controller* add_controller(Game* game)
-{
-	auto controller = game->controllers.append();
-	controller->id = game->next_controller_id++;
-	return controller;
-}
+#define CONTROLLER_TYPE(upper, type, name, max) \
+	type##_Controller* add_##name##_controller(Game* game) \
+	{ \
+		auto controller = game->controllers.name.append(); \
+		memset(controller, 0, sizeof(*controller)); \
+		return controller; \
+	}
+CONTROLLER_TYPES
+#undef CONTROLLER_TYPE
 
 Message_Handler* add_message_handler(Game* game)
 {
@@ -125,6 +143,157 @@ Message_Handler* add_message_handler(Game* game)
 	return handler;
 }
 
+// =============================================================================
+// Timers
+// =============================================================================
+
+static Timer_ID make_timer_id(u32 index, u16 generation)
+{
+	return ((u32)generation << TIMER_ID_INDEX_BITS) | index;
+}
+
+// Level by how far off the timer is -- level n holds the timers due within
+// TIMER_WHEEL_SLOTS^(n + 1) turns, in the slot for their turn's nth group of
+// TIMER_WHEEL_SLOT_BITS.
+static void timer_wheel_link(Timer_Wheel* wheel, u32 turn, u32 index)
+{
+	Timer *t = &wheel->timers[index];
+	u32 delay = t->turn - turn;
+	ASSERT(delay <= TIMER_MAX_DELAY);
+	u32 level = 0;
+	while (delay >> ((level + 1) * TIMER_WHEEL_SLOT_BITS)) {
+		++level;
+	}
+	u32 slot = level * TIMER_WHEEL_SLOTS
+	         + ((t->turn >> (level * TIMER_WHEEL_SLOT_BITS)) & (TIMER_WHEEL_SLOTS - 1));
+
+	t->slot = (u16)slot;
+	t->prev = 0;
+	t->next = wheel->slots[slot];
+	if (t->next) {
+		wheel->timers[t->next].prev = index;
+	}
+	wheel->slots[slot] = index;
+}
+
+static void timer_wheel_unlink(Timer_Wheel* wheel, u32 index)
+{
+	Timer *t = &wheel->timers[index];
+	if (t->prev) {
+		wheel->timers[t->prev].next = t->next;
+	} else {
+		wheel->slots[t->slot] = t->next;
+	}
+	if (t->next) {
+		wheel->timers[t->next].prev = t->prev;
+	}
+}
+
+static void free_timer(Timer_Wheel* wheel, u32 index)
+{
+	Timer *t = &wheel->timers[index];
+	++t->generation;
+	t->next = wheel->free_list;
+	wheel->free_list = index;
+}
+
+static Timer_ID start_timer(Timer_Wheel* wheel, u32 turn, Timer_Type type, Entity_ID owner_id, u32 delay, u32 period)
+{
+	ASSERT(delay && delay <= TIMER_MAX_DELAY && period <= TIMER_MAX_DELAY);
+
+	u32 index = wheel->free_list;
+	if (index) {
+		wheel->free_list = wheel->timers[index].next;
+	} else {
+		ASSERT(wheel->next_timer_index < MAX_TIMERS);
+		index = wheel->next_timer_index++;
+	}
+
+	Timer *t = &wheel->timers[index];
+	t->turn = turn + delay;
+	t->period = period;
+	t->owner_id = owner_id;
+	t->type = type;
+	timer_wheel_link(wheel, turn, index);
+
+	return make_timer_id(index, t->generation);
+}
+
+// Moves the wheel on to turn, which has to be the one after the last it was
+// moved to, and returns the slot holding the timers now due.
+static u32 advance_timers(Timer_Wheel* wheel, u32 turn)
+{
+	// each time a level comes round to slot 0, the next level's slot for this
+	// turn is near enough to spread over the levels below
+	for (u32 level = 1; level < TIMER_WHEEL_LEVELS; ++level) {
+		if ((turn >> ((level - 1) * TIMER_WHEEL_SLOT_BITS)) & (TIMER_WHEEL_SLOTS - 1)) {
+			break;
+		}
+		u32 slot = level * TIMER_WHEEL_SLOTS
+		         + ((turn >> (level * TIMER_WHEEL_SLOT_BITS)) & (TIMER_WHEEL_SLOTS - 1));
+		u32 index = wheel->slots[slot];
+		wheel->slots[slot] = 0;
+		while (index) {
+			u32 next = wheel->timers[index].next;
+			timer_wheel_link(wheel, turn, index);
+			index = next;
+		}
+	}
+
+	return turn & (TIMER_WHEEL_SLOTS - 1);
+}
+
+// Takes the next due timer off slot, re-arming it if it's periodic. They come
+// off one at a time, so whatever firing one does to the others -- removing them
+// included -- is safe. Nothing new can land in slot, as it's only for this turn.
+static bool take_due_timer(Timer_Wheel* wheel, u32 turn, u32 slot, Fired_Timer* fired)
+{
+	u32 index = wheel->slots[slot];
+	if (!index) {
+		return false;
+	}
+	Timer *t = &wheel->timers[index];
+	ASSERT(t->turn == turn);
+	timer_wheel_unlink(wheel, index);
+
+	fired->timer_id = make_timer_id(index, t->generation);
+	fired->type = t->type;
+	fired->owner_id = t->owner_id;
+
+	if (t->period) {
+		t->turn = turn + t->period;
+		timer_wheel_link(wheel, turn, index);
+	} else {
+		free_timer(wheel, index);
+	}
+	return true;
+}
+
+Timer_ID add_timer(Game* game, Timer_Type type, Entity_ID owner_id, u32 delay)
+{
+	return start_timer(&game->timers, game->turn, type, owner_id, delay, 0);
+}
+
+Timer_ID add_periodic_timer(Game* game, Timer_Type type, Entity_ID owner_id, u32 period)
+{
+	return start_timer(&game->timers, game->turn, type, owner_id, period, period);
+}
+
+void remove_timer(Game* game, Timer_ID timer_id)
+{
+	if (timer_is_pending(game, timer_id)) {
+		u32 index = timer_id & TIMER_ID_INDEX_MASK;
+		timer_wheel_unlink(&game->timers, index);
+		free_timer(&game->timers, index);
+	}
+}
+
+bool timer_is_pending(Game* game, Timer_ID timer_id)
+{
+	u32 index = timer_id & TIMER_ID_INDEX_MASK;
+	return index && game->timers.timers[index].generation == (timer_id >> TIMER_ID_INDEX_BITS);
+}
+
 Card* add_card(Game* game, Card_Appearance appearance)
 {
 	// XXX -- for now add the card to the discard pile
@@ -137,38 +306,62 @@ Card* add_card(Game* game, Card_Appearance appearance)
 void init(Game* game)
 {
 	memset(game, 0, sizeof(*game));
-	game->next_entity_id = 1;
-	game->next_controller_id = 1;
+	game->next_entity_index = 1;
+	game->timers.next_timer_index = 1;
 	game->next_card_id = 1;
 
 	auto player = add_entity(game);
 	ASSERT(player->id == ENTITY_ID_PLAYER);
 	game->player_id = ENTITY_ID_PLAYER;
-	game->next_entity_id = NUM_STATIC_ENTITY_IDS;
+	game->next_entity_index = NUM_STATIC_ENTITY_IDS;
 
-	player->hit_points = 100;
-	player->max_hit_points = 100;
+	auto player_info = get_entity_info(game, player);
+	player_info->hit_points = 100;
+	player_info->max_hit_points = 100;
+	player_info->appearance = APPEARANCE_CREATURE_MALE_BERSERKER;
 	player->block_mask = BLOCK_WALK | BLOCK_SWIM | BLOCK_FLY;
-	player->appearance = APPEARANCE_CREATURE_MALE_BERSERKER;
 	player->movement_type = BLOCK_WALK;
 
-	auto controller = add_controller(game);
-	controller->type = CONTROLLER_PLAYER;
-	controller->player.entity_id = player->id;
-	controller->player.action.type = ACTION_NONE;
+	auto controller = add_player_controller(game);
+	controller->entity_id = player->id;
+	controller->action.type = ACTION_NONE;
 
 	game->card_state.hand_size = constants.rules.initial_hand_size;
 	game->fovs.append();
 }
 
+// false for stale handles, whose index has since been freed or reused, and for
+// the static IDs no entity is ever added with, like ENTITY_ID_NONE and
+// ENTITY_ID_WALLS
+bool entity_id_is_live(Game* game, Entity_ID entity_id)
+{
+	if (entity_id_is_tile(entity_id)) {
+		return false;
+	}
+	u32 index = entity_id_index(entity_id);
+	if (index >= game->next_entity_index) {
+		return false;
+	}
+	u32 slot = game->entity_slots[index];
+	return slot < game->entities.len && game->entities.items[slot].id == entity_id;
+}
+
 Entity* get_entity_by_id(Game* game, Entity_ID entity_id)
 {
-	for (u32 i = 0; i < game->entities.len; ++i) {
-		if (game->entities[i].id == entity_id) {
-			return &game->entities[i];
-		}
+	if (!entity_id_is_live(game, entity_id)) {
+		return NULL;
 	}
-	return NULL;
+	Entity *e = &game->entities[game->entity_slots[entity_id_index(entity_id)]];
+	ASSERT(e->id == entity_id);
+	return e;
+}
+
+Entity_Info* get_entity_info_by_id(Game* game, Entity_ID entity_id)
+{
+	if (!entity_id_is_live(game, entity_id)) {
+		return NULL;
+	}
+	return &game->entity_infos[game->entity_slots[entity_id_index(entity_id)]];
 }
 
 Entity* get_player(Game* game)
@@ -176,6 +369,17 @@ Entity* get_player(Game* game)
 	return get_entity_by_id(game, game->player_id);
 }
 
+bool game_is_level_cleared(Game* game)
+{
+	for (u32 i = 0; i < game->entities.len; ++i) {
+		Entity *e = &game->entities[i];
+		if (e->id != game->player_id && e->movement_type) {
+			return false;
+		}
+	}
+	return true;
+}
+
 bool game_is_pos_opaque(Game* game, Pos pos)
 {
 	// TODO -- check entities blocking pos?
@@ -275,9 +479,10 @@ void update_fov(Game* game)
 Entity* add_enemy(Game* game, u32 hit_points)
 {
 	auto e = add_entity(game);
-	e->hit_points = hit_points;
-	e->max_hit_points = hit_points;
-	e->default_action = ACTION_BUMP_ATTACK;
+	auto info = get_entity_info(game, e);
+	info->hit_points = hit_points;
+	info->max_hit_points = hit_points;
+	info->default_action = ACTION_BUMP_ATTACK;
 	e->block_mask = BLOCK_WALK | BLOCK_SWIM | BLOCK_FLY;
 
 	return e;
@@ -319,14 +524,14 @@ Appearance get_creature_appearance(Creature_Type type)
 Entity* add_spider_normal(Game* game, Pos pos)
 {
 	auto e = add_enemy(game, 5);
-	e->appearance = APPEARANCE_CREATURE_RED_SPIDER;
+	auto info = get_entity_info(game, e);
+	info->appearance = APPEARANCE_CREATURE_RED_SPIDER;
 	e->movement_type = BLOCK_WALK;
 	e->pos = pos;
 	e->flags = ENTITY_FLAG_WALK_THROUGH_WEBS;
 
-	auto c = add_controller(game);
-	c->type = CONTROLLER_SPIDER_NORMAL;
-	c->spider_normal.entity_id = e->id;
+	auto c = add_spider_normal_controller(game);
+	c->entity_id = e->id;
 
 	return e;
 }
@@ -334,15 +539,15 @@ Entity* add_spider_normal(Game* game, Pos pos)
 Entity* add_spider_web(Game* game, Pos pos)
 {
 	auto e = add_enemy(game, 5);
-	e->appearance = APPEARANCE_CREATURE_BLACK_SPIDER;
+	auto info = get_entity_info(game, e);
+	info->appearance = APPEARANCE_CREATURE_BLACK_SPIDER;
 	e->movement_type = BLOCK_WALK;
 	e->pos = pos;
 	e->flags = ENTITY_FLAG_WALK_THROUGH_WEBS;
 
-	auto c = add_controller(game);
-	c->type = CONTROLLER_SPIDER_WEB;
-	c->spider_web.entity_id = e->id;
-	c->spider_web.web_cooldown = 3;
+	auto c = add_spider_web_controller(game);
+	c->entity_id = e->id;
+	c->web_cooldown = add_timer(game, TIMER_COOLDOWN, e->id, 3);
 
 	return e;
 }
@@ -350,14 +555,14 @@ Entity* add_spider_web(Game* game, Pos pos)
 Entity* add_spider_poison(Game* game, Pos pos)
 {
 	auto e = add_enemy(game, 5);
-	e->appearance = APPEARANCE_CREATURE_SPIDER_GREEN;
+	auto info = get_entity_info(game, e);
+	info->appearance = APPEARANCE_CREATURE_SPIDER_GREEN;
 	e->movement_type = BLOCK_WALK;
 	e->pos = pos;
 	e->flags = ENTITY_FLAG_WALK_THROUGH_WEBS;
 
-	auto c = add_controller(game);
-	c->type = CONTROLLER_SPIDER_POISON;
-	c->spider_poison.entity_id = e->id;
+	auto c = add_spider_poison_controller(game);
+	c->entity_id = e->id;
 
 	return e;
 }
@@ -365,15 +570,15 @@ Entity* add_spider_poison(Game* game, Pos pos)
 Entity* add_spider_shadow(Game* game, Pos pos)
 {
 	auto e = add_enemy(game, 5);
-	e->appearance = APPEARANCE_CREATURE_SPIDER_BLUE;
+	auto info = get_entity_info(game, e);
+	info->appearance = APPEARANCE_CREATURE_SPIDER_BLUE;
 	e->movement_type = BLOCK_WALK;
 	e->pos = pos;
 	e->flags = ENTITY_FLAG_WALK_THROUGH_WEBS;
 
-	auto c = add_controller(game);
-	c->type = CONTROLLER_SPIDER_SHADOW;
-	c->spider_shadow.entity_id = e->id;
-	c->spider_shadow.invisible_cooldown = 3;
+	auto c = add_spider_shadow_controller(game);
+	c->entity_id = e->id;
+	c->invisible_cooldown = add_timer(game, TIMER_COOLDOWN, e->id, 3);
 
 	return e;
 }
@@ -381,13 +586,13 @@ Entity* add_spider_shadow(Game* game, Pos pos)
 Entity* add_imp(Game* game, Pos pos)
 {
 	auto e = add_enemy(game, 5);
-	e->appearance = APPEARANCE_CREATURE_IMP;
+	auto info = get_entity_info(game, e);
+	info->appearance = APPEARANCE_CREATURE_IMP;
 	e->movement_type = BLOCK_FLY;
 	e->pos = pos;
 
-	auto c = add_controller(game);
-	c->type = CONTROLLER_IMP;
-	c->imp.imp_id = e->id;
+	auto c = add_imp_controller(game);
+	c->entity_id = e->id;
 
 	return e;
 }
@@ -395,9 +600,10 @@ Entity* add_imp(Game* game, Pos pos)
 Entity* add_fire_wall(Game* game, Pos pos)
 {
 	auto e = add_entity(game);
-	e->hit_points = 1;
-	e->max_hit_points = 1;
-	e->appearance = APPEARANCE_CREATURE_RED_FLAME;
+	auto info = get_entity_info(game, e);
+	info->hit_points = 1;
+	info->max_hit_points = 1;
+	info->appearance = APPEARANCE_CREATURE_RED_FLAME;
 	e->pos = pos;
 
 	auto mh = add_message_handler(game);
@@ -430,9 +636,10 @@ Entity* add_spiderweb(Game* game, Pos pos)
 	}
 
 	auto e = add_entity(game);
-	e->hit_points = 1;
-	e->max_hit_points = 1;
-	e->appearance = appearance;
+	auto info = get_entity_info(game, e);
+	info->hit_points = 1;
+	info->max_hit_points = 1;
+	info->appearance = appearance;
 	e->pos = pos;
 
 	auto mh = add_message_handler(game);
@@ -447,9 +654,10 @@ Entity* add_spiderweb(Game* game, Pos pos)
 Entity* add_explosive_barrel(Game* game, Pos pos)
 {
 	auto e = add_entity(game);
-	e->hit_points = 1;
-	e->max_hit_points = 1;
-	e->appearance = APPEARANCE_ITEM_BARREL;
+	auto info = get_entity_info(game, e);
+	info->hit_points = 1;
+	info->max_hit_points = 1;
+	info->appearance = APPEARANCE_ITEM_BARREL;
 	e->pos = pos;
 	e->block_mask = BLOCK_FLY | BLOCK_SWIM | BLOCK_WALK;
 
@@ -478,16 +686,14 @@ Message_Handler* add_trap_spider_cave(Game* game, Pos pos, u32 radius)
 Entity_ID add_slime(Game *game, Pos pos, u32 hit_points)
 {
 	auto e = add_enemy(game, 5);
-	e->hit_points = min_u32(hit_points, 5);
+	auto info = get_entity_info(game, e);
+	info->hit_points = min_u32(hit_points, 5);
 	e->pos = pos;
-	e->appearance = APPEARANCE_CREATURE_GREEN_SLIME;
+	info->appearance = APPEARANCE_CREATURE_GREEN_SLIME;
 	e->movement_type = BLOCK_WALK;
 
-	Controller c = {};
-	c.type = CONTROLLER_SLIME;
-	c.slime.entity_id = e->id;
-	c.slime.split_cooldown = 5;
-	game->controllers.append(c);
+	auto c = add_slime_controller(game);
+	c->entity_id = e->id;
 
 	Message_Handler mh = {};
 	mh.type = MESSAGE_HANDLER_SLIME_SPLIT;
@@ -502,18 +708,18 @@ Entity_ID add_slime(Game *game, Pos pos, u32 hit_points)
 // Controllers
 // =============================================================================
 
-static Entity_ID lich_get_skeleton_to_heal(Game *game, Controller *controller)
+static Entity_ID lich_get_skeleton_to_heal(Game *game, Lich_Controller *controller)
 {
 	Entity_ID best_skeleton_id = 0;
-	if (!controller->lich.heal_cooldown) {
-		auto& skeleton_ids = controller->lich.skeleton_ids;
+	if (!timer_is_pending(game, controller->heal_cooldown)) {
+		auto& skeleton_ids = controller->skeleton_ids;
 		u32 num_skeleton_ids = skeleton_ids.len;
 		i32 best_heal = 0;
 		for (u32 i = 0; i < num_skeleton_ids; ++i) {
 			Entity_ID e_id = skeleton_ids[i];
-			Entity *e = get_entity_by_id(game, e_id);
-			ASSERT(e);
-			i32 heal = e->max_hit_points - e->hit_points;
+			Entity_Info *info = get_entity_info_by_id(game, e_id);
+			ASSERT(info);
+			i32 heal = info->max_hit_points - info->hit_points;
 			if (heal > best_heal) {
 				best_skeleton_id = e_id;
 				best_heal = heal;
@@ -543,7 +749,37 @@ static void bump_attack_if_adjacent(Game* game, Entity_ID actor_id, Entity_ID ta
 	do_action_if_adjacent(game, actor_id, target_id, action, actions);
 }
 
-static void move_toward_pos(Game* game, Entity_ID entity_id, Pos pos, Output_Buffer<Potential_Move> potential_moves)
+// neighbours row by row -- the order the move loops have always visited them
+// in, and so the order equal weights are settled in
+static const v2_i16 MOVE_DIRECTIONS[MOVE_SLOTS] = {
+	v2_i16(-1, -1), v2_i16(0, -1), v2_i16(1, -1),
+	v2_i16(-1,  0),                v2_i16(1,  0),
+	v2_i16(-1,  1), v2_i16(0,  1), v2_i16(1,  1),
+};
+
+static u32 move_slot(Pos start, Pos end)
+{
+	v2_i16 d = (v2_i16)end - (v2_i16)start;
+	ASSERT(d.x >= -1 && d.x <= 1 && d.y >= -1 && d.y <= 1 && (d.x || d.y));
+	u32 slot = (d.y + 1) * 3 + (d.x + 1);
+	return slot > 4 ? slot - 1 : slot;
+}
+
+static Pos move_slot_end(Pos start, u32 slot)
+{
+	return (Pos)((v2_i16)start + MOVE_DIRECTIONS[slot]);
+}
+
+static Move_Candidates* new_move_candidates(Output_Buffer<Move_Candidates> candidates, Entity_ID entity_id, Pos start)
+{
+	Move_Candidates *c = candidates.append();
+	c->entity_id = entity_id;
+	c->start = start;
+	c->valid_mask = 0;
+	return c;
+}
+
+static void move_toward_pos(Game* game, Entity_ID entity_id, Pos pos, Output_Buffer<Move_Candidates> candidates)
 {
 	auto entity = get_entity_by_id(game, entity_id);
 
@@ -555,24 +791,33 @@ static void move_toward_pos(Game* game, Entity_ID entity_id, Pos pos, Output_Buf
 		return;
 	}
 
+	Philox rng = game_random_stream(game, entity_id, RANDOM_PURPOSE_MOVE);
 	auto &tiles = game->tiles;
-	for (i16 dy = -1; dy <= 1; ++dy) {
-		for (i16 dx = -1; dx <= 1; ++dx) {
-			if (!dx && !dy) {
-				continue;
-			}
-			v2_i16 end = spider_pos + v2_i16(dx, dy);
-			d = target_pos - end;
-			Tile t = tiles[(Pos)end];
-			if (d.x*d.x + d.y*d.y <= cur_dist_squared
-				&& tile_is_passable(t, entity->movement_type)) {
-				Potential_Move pm = {};
-				pm.entity_id = entity_id;
-				pm.start = (Pos)spider_pos;
-				pm.end = (Pos)end;
-				pm.weight = uniform_f32(1.9f, 2.1f);
-				potential_moves.append(pm);
-			}
+	Move_Candidates *c = new_move_candidates(candidates, entity_id, entity->pos);
+	for (u32 slot = 0; slot < MOVE_SLOTS; ++slot) {
+		v2_i16 end = spider_pos + MOVE_DIRECTIONS[slot];
+		d = target_pos - end;
+		Tile t = tiles[(Pos)end];
+		if (d.x*d.x + d.y*d.y <= cur_dist_squared
+			&& tile_is_passable(t, entity->movement_type)) {
+			c->valid_mask |= 1 << slot;
+			c->weights[slot] = rng.uniform_f32(1.9f, 2.1f);
+		}
+	}
+}
+
+// every passable neighbour, weighted at random
+static void move_randomly(Game* game, Entity* e, Output_Buffer<Move_Candidates> candidates)
+{
+	Philox rng = game_random_stream(game, e->id, RANDOM_PURPOSE_MOVE);
+	auto &tiles = game->tiles;
+	u16 move_mask = e->movement_type;
+	Move_Candidates *c = new_move_candidates(candidates, e->id, e->pos);
+	for (u32 slot = 0; slot < MOVE_SLOTS; ++slot) {
+		Tile t = tiles[move_slot_end(e->pos, slot)];
+		if (tile_is_passable(t, move_mask)) {
+			c->valid_mask |= 1 << slot;
+			c->weights[slot] = rng.uniform_f32(0.0f, 1.0f);
 		}
 	}
 }
@@ -616,19 +861,17 @@ static void peek_message_response(Game* game, Message message, void* data)
 	}
 }
 
-void make_moves(Game* game, Output_Buffer<Potential_Move> potential_moves)
+void make_moves(Game* game, Output_Buffer<Move_Candidates> candidates)
 {
 	auto &controllers = game->controllers;
-	auto &tiles = game->tiles;
 
 	// determine where player is likely going to be after this
 	auto player = get_player(game);
 	auto player_end_pos = player->pos;
 	{
-		auto c = &controllers[0];
-		ASSERT(c->type == CONTROLLER_PLAYER);
-		ASSERT(c->player.entity_id == player->id);
-		auto action = &c->player.action;
+		auto c = &controllers.player[0];
+		ASSERT(c->entity_id == player->id);
+		auto action = &c->action;
 		if (action->type != ACTION_MOVE) {
 			goto player_wont_move;
 		}
@@ -650,198 +893,111 @@ void make_moves(Game* game, Output_Buffer<Potential_Move> potential_moves)
 	}
 player_wont_move:
 
-	for (u32 i = 0; i < controllers.len; ++i) {
-		auto c = &controllers[i];
-
-		switch (c->type) {
-		case CONTROLLER_PLAYER:
-			if (c->player.action.type == ACTION_MOVE) {
-				Potential_Move pm = {};
-				pm.entity_id = c->player.entity_id;
-				pm.start = c->player.action.move.start;
-				pm.end = c->player.action.move.end;
-				// XXX -- weight here should be infinite
-				pm.weight = 10.0f;
-				potential_moves.append(pm);
-			}
-			break;
-		case CONTROLLER_IMP: {
-			auto imp_id = c->imp.imp_id;
-			auto imp = get_entity_by_id(game, imp_id);
-			if (!positions_are_adjacent(imp->pos, player_end_pos)) {
-				u16 move_mask = imp->movement_type;
-				Pos start = imp->pos;
-				for (i8 dy = -1; dy <= 1; ++dy) {
-					for (i8 dx = -1; dx <= 1; ++dx) {
-						if (!(dx || dy)) {
-							continue;
-						}
-						Pos end = (Pos)((v2_i16)start + v2_i16(dx, dy));
-						Tile t = tiles[end];
-						if (tile_is_passable(t, move_mask)) {
-							Potential_Move pm = {};
-							pm.entity_id = imp_id;
-							pm.start = start;
-							pm.end = end;
-							pm.weight = uniform_f32(0.0f, 1.0f);
-							potential_moves.append(pm);
-						}
-					}
-				}
-			}
-			break;
-		}
-		case CONTROLLER_RANDOM_MOVE: {
-			Entity *e = get_entity_by_id(game, c->random_move.entity_id);
-			u16 move_mask = e->movement_type;
-			Pos start = e->pos;
-			for (i8 dy = -1; dy <= 1; ++dy) {
-				for (i8 dx = -1; dx <= 1; ++dx) {
-					if (!(dx || dy)) {
-						continue;
-					}
-					Pos end = (Pos)((v2_i16)start + v2_i16(dx, dy));
-					Tile t = tiles[end];
-					if (tile_is_passable(t, move_mask)) {
-						Potential_Move pm = {};
-						pm.entity_id = e->id;
-						pm.start = start;
-						pm.end = end;
-						pm.weight = uniform_f32(0.0f, 1.0f);
-						// pm.weight = 1.0f;
-						potential_moves.append(pm);
-					}
-				}
-			}
-			break;
-		}
-		case CONTROLLER_SLIME: {
-			move_toward_pos(game, c->slime.entity_id, player_end_pos, potential_moves);
-			break;
-		}
-		case CONTROLLER_LICH: {
-			if (!lich_get_skeleton_to_heal(game, c)) {
-				Entity *e = get_entity_by_id(game, c->lich.lich_id);
-				u16 move_mask = e->movement_type;
-				Pos start = e->pos;
-				for (i8 dy = -1; dy <= 1; ++dy) {
-					for (i8 dx = -1; dx <= 1; ++dx) {
-						if (!(dx || dy)) {
-							continue;
-						}
-						Pos end = (Pos)((v2_i16)start + v2_i16(dx, dy));
-						Tile t = tiles[end];
-						if (tile_is_passable(t, move_mask)) {
-							Potential_Move pm = {};
-							pm.entity_id = e->id;
-							pm.start = start;
-							pm.end = end;
-							pm.weight = uniform_f32(0.0f, 1.0f);
-							// pm.weight = 1.0f;
-							potential_moves.append(pm);
-						}
-					}
-				}
-			}
-			auto& skeleton_ids = c->lich.skeleton_ids;
-			u32 num_skeleton_ids = skeleton_ids.len;
-			for (u32 i = 0; i < num_skeleton_ids; ++i) {
-				move_toward_pos(game, c->lich.skeleton_ids[i], player_end_pos, potential_moves);
-			}
-			break;
+	for (u32 i = 0; i < controllers.player.len; ++i) {
+		auto c = &controllers.player[i];
+		if (c->action.type == ACTION_MOVE) {
+			Pos start = c->action.move.start;
+			Move_Candidates *mc = new_move_candidates(candidates, c->entity_id, start);
+			u32 slot = move_slot(start, c->action.move.end);
+			mc->valid_mask = 1 << slot;
+			// XXX -- weight here should be infinite
+			mc->weights[slot] = 10.0f;
 		}
+	}
 
-		case CONTROLLER_SPIDER_NORMAL: {
-			auto spider_id = c->spider_normal.entity_id;
-			move_toward_pos(game, spider_id, player_end_pos, potential_moves);
-			break;
+	for (u32 i = 0; i < controllers.imp.len; ++i) {
+		auto imp = get_entity_by_id(game, controllers.imp[i].entity_id);
+		if (!positions_are_adjacent(imp->pos, player_end_pos)) {
+			move_randomly(game, imp, candidates);
 		}
+	}
 
-		case CONTROLLER_SPIDER_POISON: {
-			auto spider_id = c->spider_poison.entity_id;
-			move_toward_pos(game, spider_id, player_end_pos, potential_moves);
-			break;
-		}
+	for (u32 i = 0; i < controllers.random_move.len; ++i) {
+		auto e = get_entity_by_id(game, controllers.random_move[i].entity_id);
+		move_randomly(game, e, candidates);
+	}
 
-		case CONTROLLER_SPIDER_WEB: {
-			auto spider_id = c->spider_web.entity_id;
-			auto player = get_player(game);
-			auto spider = get_entity_by_id(game, spider_id);
-			v2_i32 d = (v2_i32)player->pos - (v2_i32)spider->pos;
-			if (c->spider_web.web_cooldown || (d.x*d.x + d.y*d.y > 3*3)) {
-				move_toward_pos(game, spider_id, player_end_pos, potential_moves);
-			}
-			break;
+	for (u32 i = 0; i < controllers.slime.len; ++i) {
+		move_toward_pos(game, controllers.slime[i].entity_id, player_end_pos, candidates);
+	}
+
+	for (u32 i = 0; i < controllers.lich.len; ++i) {
+		auto c = &controllers.lich[i];
+		if (!lich_get_skeleton_to_heal(game, c)) {
+			move_randomly(game, get_entity_by_id(game, c->lich_id), candidates);
 		}
+		auto& skeleton_ids = c->skeleton_ids;
+		u32 num_skeleton_ids = skeleton_ids.len;
+		for (u32 j = 0; j < num_skeleton_ids; ++j) {
+			move_toward_pos(game, skeleton_ids[j], player_end_pos, candidates);
+		}
+	}
 
-		case CONTROLLER_SPIDER_SHADOW: {
-			auto spider_id = c->spider_shadow.entity_id;
-			auto spider = get_entity_by_id(game, spider_id);
-			if (c->spider_shadow.invisible_cooldown || (spider->flags & ENTITY_FLAG_INVISIBLE)) {
-				move_toward_pos(game, spider_id, player_end_pos, potential_moves);
-			}
-			break;
+	for (u32 i = 0; i < controllers.spider_normal.len; ++i) {
+		move_toward_pos(game, controllers.spider_normal[i].entity_id, player_end_pos, candidates);
+	}
+
+	for (u32 i = 0; i < controllers.spider_poison.len; ++i) {
+		move_toward_pos(game, controllers.spider_poison[i].entity_id, player_end_pos, candidates);
+	}
+
+	for (u32 i = 0; i < controllers.spider_web.len; ++i) {
+		auto c = &controllers.spider_web[i];
+		auto spider = get_entity_by_id(game, c->entity_id);
+		v2_i32 d = (v2_i32)player->pos - (v2_i32)spider->pos;
+		if (timer_is_pending(game, c->web_cooldown) || (d.x*d.x + d.y*d.y > 3*3)) {
+			move_toward_pos(game, c->entity_id, player_end_pos, candidates);
 		}
+	}
 
+	for (u32 i = 0; i < controllers.spider_shadow.len; ++i) {
+		auto c = &controllers.spider_shadow[i];
+		auto spider = get_entity_by_id(game, c->entity_id);
+		if (timer_is_pending(game, c->invisible_cooldown) || (spider->flags & ENTITY_FLAG_INVISIBLE)) {
+			move_toward_pos(game, c->entity_id, player_end_pos, candidates);
 		}
 	}
 }
 
-void do_cooldowns(Slice<Controller> controllers)
+// Fires this turn's timers as they come off the wheel -- new periodic effects
+// go in the switch.
+void game_do_timers(Game* game)
 {
-	for (u32 i = 0; i < controllers.len; ++i) {
-		auto c = &controllers[i];
-		switch (c->type) {
-		case CONTROLLER_PLAYER:
-		case CONTROLLER_RANDOM_MOVE:
-		case CONTROLLER_DRAGON:
-		case CONTROLLER_SLIME:
-		case CONTROLLER_IMP:
-		case CONTROLLER_SPIDER_NORMAL:
-		case CONTROLLER_SPIDER_POISON:
-			break;
-		case CONTROLLER_LICH:
-			if (c->lich.heal_cooldown) {
-				--c->lich.heal_cooldown;
-			}
-			break;
-		case CONTROLLER_SPIDER_WEB:
-			if (c->spider_web.web_cooldown) {
-				--c->spider_web.web_cooldown;
-			}
-			break;
-		case CONTROLLER_SPIDER_SHADOW:
-			if (c->spider_shadow.invisible_cooldown) {
-				--c->spider_shadow.invisible_cooldown;
-			}
+	u32 slot = advance_timers(&game->timers, game->turn);
+
+	Fired_Timer fired;
+	while (take_due_timer(&game->timers, game->turn, slot, &fired)) {
+		if (fired.owner_id && !entity_id_is_live(game, fired.owner_id)) {
+			remove_timer(game, fired.timer_id);
+			continue;
+		}
+		switch (fired.type) {
+		case TIMER_COOLDOWN:
 			break;
 		}
 	}
 }
 
-void make_actions(Controller* c, Game* game, Slice<bool> has_acted, Output_Buffer<Action> actions)
+static void make_enemy_actions(Game* game, Entity_Bit_Array* has_acted, Output_Buffer<Action> actions)
 {
-	switch (c->type) {
-	case CONTROLLER_PLAYER:
-		if (!has_acted[c->player.entity_id]) {
-			actions.append(c->player.action);
-		}
-		break;
-	case CONTROLLER_IMP: {
-		auto imp_id = c->imp.imp_id;
-		if (!has_acted[imp_id]) {
+	auto &controllers = game->controllers;
+
+	for (u32 i = 0; i < controllers.imp.len; ++i) {
+		auto imp_id = controllers.imp[i].entity_id;
+		if (!has_acted->get(entity_id_index(imp_id))) {
 			Action action = {};
 			action.type = ACTION_STEAL_CARD;
-			action.entity_id = c->imp.imp_id;
+			action.entity_id = imp_id;
 			action.steal_card.target_id = ENTITY_ID_PLAYER;
 			do_action_if_adjacent(game, imp_id, ENTITY_ID_PLAYER, action, actions);
 		}
-		break;
 	}
-	case CONTROLLER_DRAGON: {
-		auto dragon_id = c->dragon.entity_id;
-		if (!has_acted[dragon_id]) {
-			u32 target_idx = rand_u32() % game->entities.len;
+
+	for (u32 i = 0; i < controllers.dragon.len; ++i) {
+		auto dragon_id = controllers.dragon[i].entity_id;
+		if (!has_acted->get(entity_id_index(dragon_id))) {
+			Philox rng = game_random_stream(game, dragon_id, RANDOM_PURPOSE_TARGET);
+			u32 target_idx = rng.rand_u32() % game->entities.len;
 			auto target = &game->entities[target_idx];
 
 			Action a = {};
@@ -850,68 +1006,72 @@ void make_actions(Controller* c, Game* game, Slice<bool> has_acted, Output_Buffe
 			a.fireball.end = target->pos;
 			actions.append(a);
 		}
-		break;
 	}
-	case CONTROLLER_LICH: {
-		auto lich_id = c->lich.lich_id;
-		if (!has_acted[lich_id]) {
+
+	for (u32 i = 0; i < controllers.lich.len; ++i) {
+		auto c = &controllers.lich[i];
+		auto lich_id = c->lich_id;
+		if (!has_acted->get(entity_id_index(lich_id))) {
 			auto skeleton_to_heal = lich_get_skeleton_to_heal(game, c);
 			if (skeleton_to_heal) {
-				c->lich.heal_cooldown = 5;
+				c->heal_cooldown = add_timer(game, TIMER_COOLDOWN, lich_id, 5);
 
 				Action a = {};
 				a.type = ACTION_HEAL;
-				a.entity_id = c->lich.lich_id;
+				a.entity_id = lich_id;
 				a.heal.target_id = skeleton_to_heal;
 				a.heal.amount = 5;
 				actions.append(a);
 			}
 		}
-		auto &skeleton_ids = c->lich.skeleton_ids;
-		for (u32 i = 0; i < skeleton_ids.len; ++i) {
-			auto skeleton_id = skeleton_ids[i];
-			if (!has_acted[skeleton_id]) {
+		auto &skeleton_ids = c->skeleton_ids;
+		for (u32 j = 0; j < skeleton_ids.len; ++j) {
+			auto skeleton_id = skeleton_ids[j];
+			if (!has_acted->get(entity_id_index(skeleton_id))) {
 				bump_attack_if_adjacent(game, skeleton_id, ENTITY_ID_PLAYER, actions);
 			}
 		}
-		break;
 	}
-	case CONTROLLER_SLIME: {
-		auto slime_id = c->slime.entity_id;
-		if (!has_acted[slime_id]) {
+
+	for (u32 i = 0; i < controllers.slime.len; ++i) {
+		auto slime_id = controllers.slime[i].entity_id;
+		if (!has_acted->get(entity_id_index(slime_id))) {
 			bump_attack_if_adjacent(game, slime_id, ENTITY_ID_PLAYER, actions);
 		}
-		break;
 	}
-	case CONTROLLER_SPIDER_NORMAL: {
-		auto spider_id = c->spider_normal.entity_id;
-		if (!has_acted[spider_id]) {
+
+	for (u32 i = 0; i < controllers.spider_normal.len; ++i) {
+		auto spider_id = controllers.spider_normal[i].entity_id;
+		if (!has_acted->get(entity_id_index(spider_id))) {
 			bump_attack_if_adjacent(game, spider_id, ENTITY_ID_PLAYER, actions);
 		}
-		break;
 	}
-	case CONTROLLER_SPIDER_POISON: {
-		auto spider_id = c->spider_poison.entity_id;
-		if (!has_acted[spider_id]) {
+
+	for (u32 i = 0; i < controllers.spider_poison.len; ++i) {
+		auto spider_id = controllers.spider_poison[i].entity_id;
+		if (!has_acted->get(entity_id_index(spider_id))) {
 			Action action = {};
 			action.type = ACTION_BUMP_ATTACK_POISON;
 			action.entity_id = spider_id;
 			action.bump_attack.target_id = ENTITY_ID_PLAYER;
 			do_action_if_adjacent(game, spider_id, ENTITY_ID_PLAYER, action, actions);
 		}
-		break;
 	}
-	case CONTROLLER_SPIDER_WEB: {
-		auto spider_id = c->spider_web.entity_id;
-		if (has_acted[spider_id]) {
-			return;
+
+	auto player = get_player(game);
+	auto &tiles = game->tiles;
+
+	for (u32 i = 0; i < controllers.spider_web.len; ++i) {
+		auto c = &controllers.spider_web[i];
+		auto spider_id = c->entity_id;
+		if (has_acted->get(entity_id_index(spider_id))) {
+			continue;
 		}
-		if (c->spider_web.web_cooldown) {
+		if (timer_is_pending(game, c->web_cooldown)) {
 			bump_attack_if_adjacent(game, spider_id, ENTITY_ID_PLAYER, actions);
-			return;
+			continue;
 		}
 
-		auto player = get_player(game);
 		auto spider = get_entity_by_id(game, spider_id);
 
 		const i16 radius = 3;
@@ -920,11 +1080,9 @@ void make_actions(Controller* c, Game* game, Slice<bool> has_acted, Output_Buffe
 
 		v2_i16 d = (v2_i16)player->pos - (v2_i16)spider->pos;
 		if (d.x*d.x + d.y*d.y > radius*radius) {
-			return;
+			continue;
 		}
 
-		auto &tiles = game->tiles;
-
 		for (i16 dy = -radius; dy <= radius; ++dy) {
 			for (i16 dx = -radius; dx <= radius; ++dx) {
 				Pos p = (Pos)((v2_i16)spider->pos + v2_i16(dx, dy));
@@ -936,7 +1094,8 @@ void make_actions(Controller* c, Game* game, Slice<bool> has_acted, Output_Buffe
 		}
 
 		if (potential_targets) {
-			auto target = potential_targets[rand_u32() % potential_targets.len];
+			Philox rng = game_random_stream(game, spider_id, RANDOM_PURPOSE_TARGET);
+			auto target = potential_targets[rng.rand_u32() % potential_targets.len];
 
 			Action action = {};
 			action.type = ACTION_SHOOT_WEB;
@@ -944,19 +1103,19 @@ void make_actions(Controller* c, Game* game, Slice<bool> has_acted, Output_Buffe
 			action.shoot_web.target = target;
 			actions.append(action);
 
-			c->spider_web.web_cooldown = 3;
+			c->web_cooldown = add_timer(game, TIMER_COOLDOWN, spider_id, 3);
 		}
-		break;
 	}
 
-	case CONTROLLER_SPIDER_SHADOW: {
-		auto spider_id = c->spider_shadow.entity_id;
+	for (u32 i = 0; i < controllers.spider_shadow.len; ++i) {
+		auto c = &controllers.spider_shadow[i];
+		auto spider_id = c->entity_id;
 		auto spider = get_entity_by_id(game, spider_id);
 
-		if (has_acted[spider_id]) {
-			return;
+		if (has_acted->get(entity_id_index(spider_id))) {
+			continue;
 		}
-		if (c->spider_shadow.invisible_cooldown || (spider->flags & ENTITY_FLAG_INVISIBLE)) {
+		if (timer_is_pending(game, c->invisible_cooldown) || (spider->flags & ENTITY_FLAG_INVISIBLE)) {
 			if (spider->flags & ENTITY_FLAG_INVISIBLE) {
 				Action action = {};
 				action.type = ACTION_BUMP_ATTACK_SNEAK;
@@ -966,7 +1125,7 @@ void make_actions(Controller* c, Game* game, Slice<bool> has_acted, Output_Buffe
 			} else {
 				bump_attack_if_adjacent(game, spider_id, ENTITY_ID_PLAYER, actions);
 			}
-			return;
+			continue;
 		}
 
 		Action action = {};
@@ -974,11 +1133,7 @@ void make_actions(Controller* c, Game* game, Slice<bool> has_acted, Output_Buffe
 		action.entity_id = spider_id;
 		actions.append(action);
 
-		c->spider_shadow.invisible_cooldown = 3;
-
-		break;
-	}
-
+		c->invisible_cooldown = add_timer(game, TIMER_COOLDOWN, spider_id, 3);
 	}
 }
 
@@ -997,98 +1152,284 @@ enum Phase
 	NUM_PHASES,
 };
 
-void make_actions(Game* game, Phase phase, Slice<bool> has_acted, Output_Buffer<Action> actions)
+// PHASE_MOVE scratch. A move is its Move_Candidates' index * MOVE_SLOTS + its
+// slot, which is also the order make_moves produced it in.
+#define MOVE_MAX_MOVES        (MAX_ENTITIES * MOVE_SLOTS)
+#define MOVE_QUEUE_WORDS      ((MOVE_MAX_MOVES + 63) / 64)
+#define MOVE_QUEUE_SUMMARIES  ((MOVE_QUEUE_WORDS + 63) / 64)
+#define MOVE_NONE             0xFFFFFFFF
+#define MOVE_CANDIDATES_NONE  0xFFFF
+
+struct Move_Resolution
 {
-	auto &controllers = game->controllers;
+	Max_Length_Array<Move_Candidates, MAX_ENTITIES> candidates;
+
+	// Every valid move ranked once up front, heaviest first and the earliest
+	// made on a tie -- the same order a stable sort by weight gives. The queue
+	// is then a bit per rank, and a bit per word of those that has any set, so
+	// the best move queued is two count_trailing_zeros away.
+	u32                     num_moves;
+	u32                     ranked[MOVE_MAX_MOVES]; // move, by rank
+	u32                     ranks[MOVE_MAX_MOVES];  // rank, by move
+	u32                     sort_scratch[MOVE_MAX_MOVES];
+	u64                     queued[MOVE_QUEUE_WORDS];
+	u64                     queued_words[MOVE_QUEUE_SUMMARIES];
+	u32                     first_summary; // nothing queued before this
+
+	// moves which came out of the queue with their end occupied, a bit per
+	// slot; they go back in when the end is vacated
+	u8                      parked_masks[MAX_ENTITIES];
+	Bit_Array<MAX_ENTITIES> resolved;
+
+	// candidates by start, for finding who's waiting on a vacated tile --
+	// candidates_at is only written where has_candidates is set
+	Map_Cache_Bool          has_candidates;
+	Map_Cache<u16>          candidates_at;
+	u16                     next_at_start[MAX_ENTITIES];
+
+	Map_Cache_Bool          occupied;
+};
 
-	switch (phase) {
-	case PHASE_PLAYER_ACTION: {
-		auto c = &controllers[0];
-		ASSERT(c->type == CONTROLLER_PLAYER && c->player.entity_id == ENTITY_ID_PLAYER);
-		auto action = c->player.action;
-		switch (action.type) {
-		case ACTION_MOVE:
-			break;
-		default:
-			actions.append(action);
-			break;
+// Kept between turns rather than allocated for each -- far too big for the
+// stack, and turns are run on more than one thread.
+static thread_local Move_Resolution *move_resolution = NULL;
+
+static f32 move_weight(Move_Resolution* r, u32 move)
+{
+	return r->candidates[move / MOVE_SLOTS].weights[move % MOVE_SLOTS];
+}
+
+// unsigned order is heaviest first
+static u32 move_sort_key(f32 weight)
+{
+	// -0 ties with 0
+	if (weight == 0.0f) {
+		weight = 0.0f;
+	}
+	// flip the bits so that unsigned order matches float order -- all bits of
+	// negative numbers, just the sign bit of positive ones -- then reverse it
+	u32 bits;
+	memcpy(&bits, &weight, sizeof(bits));
+	u32 mask = (u32)(-(i32)(bits >> 31)) | 0x80000000;
+	return ~(bits ^ mask);
+}
+
+// Stable LSD radix sort of the moves in r->ranked, one byte per pass. They go in
+// in the order made, so ties stay that way.
+static void move_queue_rank(Move_Resolution* r)
+{
+	u32 n = r->num_moves;
+	if (!n) {
+		return;
+	}
+
+	u32 counts[4][256];
+	memset(counts, 0, sizeof(counts));
+	for (u32 i = 0; i < n; ++i) {
+		u32 key = move_sort_key(move_weight(r, r->ranked[i]));
+		for (u32 pass = 0; pass < 4; ++pass) {
+			++counts[pass][(key >> (8 * pass)) & 0xFF];
 		}
-		break;
 	}
-	case PHASE_MOVE: {
-		Max_Length_Array<Potential_Move, MAX_ENTITIES * 9> potential_moves;
-		potential_moves.reset();
 
-		Map_Cache_Bool occupied;
-		occupied.reset();
+	u32 *src = r->ranked;
+	u32 *dst = r->sort_scratch;
+	u32 first_key = move_sort_key(move_weight(r, src[0]));
+	for (u32 pass = 0; pass < 4; ++pass) {
+		u32 shift = 8 * pass;
+		u32 *count = counts[pass];
+		// every key has the same byte here so this pass wouldn't move anything
+		if (count[(first_key >> shift) & 0xFF] == n) {
+			continue;
+		}
+
+		u32 offset = 0;
+		for (u32 i = 0; i < 256; ++i) {
+			u32 c = count[i];
+			count[i] = offset;
+			offset += c;
+		}
+
+		for (u32 i = 0; i < n; ++i) {
+			u32 digit = (move_sort_key(move_weight(r, src[i])) >> shift) & 0xFF;
+			dst[count[digit]++] = src[i];
+		}
+
+		u32 *tmp = src;
+		src = dst;
+		dst = tmp;
+	}
+
+	if (src != r->ranked) {
+		memcpy(r->ranked, src, n * sizeof(r->ranked[0]));
+	}
+	for (u32 i = 0; i < n; ++i) {
+		r->ranks[r->ranked[i]] = i;
+	}
+}
 
-		auto &tiles = game->tiles;
+static void move_queue_push(Move_Resolution* r, u32 move)
+{
+	u32 rank = r->ranks[move];
+	u32 word = rank / 64;
+	r->queued[word] |= (u64)1 << (rank % 64);
+	r->queued_words[word / 64] |= (u64)1 << (word % 64);
+	if (word / 64 < r->first_summary) {
+		r->first_summary = word / 64;
+	}
+}
 
-		make_moves(game, potential_moves);
+// the heaviest move queued, the earliest made on a tie
+static u32 move_queue_pop(Move_Resolution* r)
+{
+	u32 num_summaries = (r->num_moves + 64 * 64 - 1) / (64 * 64);
+	while (r->first_summary < num_summaries && !r->queued_words[r->first_summary]) {
+		++r->first_summary;
+	}
+	if (r->first_summary == num_summaries) {
+		return MOVE_NONE;
+	}
+
+	u32 word = r->first_summary * 64 + count_trailing_zeros(r->queued_words[r->first_summary]);
+	u32 rank = word * 64 + count_trailing_zeros(r->queued[word]);
+	r->queued[word] &= r->queued[word] - 1;
+	if (!r->queued[word]) {
+		r->queued_words[word / 64] &= ~((u64)1 << (word % 64));
+	}
+	return r->ranked[rank];
+}
 
-		u32 num_entities = game->entities.len;
-		for (u32 i = 0; i < num_entities; ++i) {
-			Entity *e = &game->entities[i];
-			if (e->block_mask) {
-				occupied.set(e->pos);
+// requeue the parked moves into pos -- only its neighbours can have any
+static void move_queue_unpark(Move_Resolution* r, Pos pos)
+{
+	for (u32 slot = 0; slot < MOVE_SLOTS; ++slot) {
+		Pos from = move_slot_end(pos, slot);
+		if (!r->has_candidates.get(from)) {
+			continue;
+		}
+		// slots run in opposite pairs from either end
+		u8 bit = 1 << (MOVE_SLOTS - 1 - slot);
+		for (u32 i = r->candidates_at[from]; i != MOVE_CANDIDATES_NONE; i = r->next_at_start[i]) {
+			if ((r->parked_masks[i] & bit) && !r->resolved.get(i)) {
+				r->parked_masks[i] &= ~bit;
+				move_queue_push(r, i * MOVE_SLOTS + MOVE_SLOTS - 1 - slot);
 			}
 		}
+	}
+}
+
+// Repeatedly takes the heaviest move left whose end is free and drops the rest
+// of that entity's moves. Blocked moves park until their end is vacated rather
+// than being looked at again every time round, so each move is queued at most
+// once per time its end frees up.
+static void resolve_moves(Game* game, Entity_Bit_Array* has_acted, Output_Buffer<Action> actions)
+{
+	if (!move_resolution) {
+		move_resolution = (Move_Resolution*)calloc(1, sizeof(Move_Resolution));
+	}
+	Move_Resolution *r = move_resolution;
+
+	auto &candidates = r->candidates;
+	candidates.reset();
+	make_moves(game, candidates);
+
+	auto &occupied = r->occupied;
+	occupied.reset();
+	u32 num_entities = game->entities.len;
+	for (u32 i = 0; i < num_entities; ++i) {
+		Entity *e = &game->entities[i];
+		if (e->block_mask) {
+			occupied.set(e->pos);
+		}
+	}
 
-		// sort
-		for (u32 i = 1; i < potential_moves.len; ++i) {
-			Potential_Move tmp = potential_moves[i];
-			u32 j = i;
-			while (j && potential_moves[j - 1].weight < tmp.weight) {
-				potential_moves[j] = potential_moves[j - 1];
-				--j;
+	r->num_moves = 0;
+	r->resolved.reset();
+	r->has_candidates.reset();
+	for (u32 i = 0; i < candidates.len; ++i) {
+		Move_Candidates *c = &candidates[i];
+		if (r->has_candidates.get(c->start)) {
+			r->next_at_start[i] = r->candidates_at[c->start];
+		} else {
+			r->next_at_start[i] = MOVE_CANDIDATES_NONE;
+			r->has_candidates.set(c->start);
+		}
+		r->candidates_at[c->start] = i;
+		r->parked_masks[i] = 0;
+		for (u32 slot = 0; slot < MOVE_SLOTS; ++slot) {
+			if (c->valid_mask & (1 << slot)) {
+				r->ranked[r->num_moves++] = i * MOVE_SLOTS + slot;
 			}
-			potential_moves[j] = tmp;
 		}
+	}
+	move_queue_rank(r);
 
-		bool has_moved[MAX_ENTITIES] = {};
-		for (;;) {
-			u32 idx = 0;
-			while (idx < potential_moves.len && occupied.get(potential_moves[idx].end)) {
-				++idx;
-			}
-			if (idx == potential_moves.len) {
-				break;
-			}
-			Potential_Move pm = potential_moves[idx];
+	// every move starts queued -- only the words the ranks use need clearing
+	u32 num_words = (r->num_moves + 63) / 64;
+	memset(r->queued, 0, num_words * sizeof(r->queued[0]));
+	memset(r->queued_words, 0, ((num_words + 63) / 64) * sizeof(r->queued_words[0]));
+	r->first_summary = 0;
+	for (u32 i = 0; i < r->num_moves; ++i) {
+		move_queue_push(r, r->ranked[i]);
+	}
 
-			if (!has_acted[pm.entity_id] && !has_moved[pm.entity_id]) {
-				Action chosen_move = {};
-				chosen_move.type = ACTION_MOVE;
-				chosen_move.entity_id = pm.entity_id;
-				chosen_move.move.start = pm.start;
-				chosen_move.move.end = pm.end;
-				actions.append(chosen_move);
+	for (;;) {
+		u32 move = move_queue_pop(r);
+		if (move == MOVE_NONE) {
+			break;
+		}
+		u32 i = move / MOVE_SLOTS;
+		if (r->resolved.get(i)) {
+			continue;
+		}
+		Move_Candidates *c = &candidates[i];
+		Pos end = move_slot_end(c->start, move % MOVE_SLOTS);
+		if (occupied.get(end)) {
+			r->parked_masks[i] |= 1 << (move % MOVE_SLOTS);
+			continue;
+		}
 
-				occupied.unset(pm.start);
-				occupied.set(pm.end);
+		r->resolved.set(i);
+		if (has_acted->get(entity_id_index(c->entity_id))) {
+			continue;
+		}
 
-				has_moved[pm.entity_id] = true;
-			}
+		Action chosen_move = {};
+		chosen_move.type = ACTION_MOVE;
+		chosen_move.entity_id = c->entity_id;
+		chosen_move.move.start = c->start;
+		chosen_move.move.end = end;
+		actions.append(chosen_move);
 
-			u32 push_back = 0;
-			for (u32 i = 0; i < potential_moves.len; ++i) {
-				if (potential_moves[i].entity_id == pm.entity_id) {
-					++push_back;
-				} else if (push_back) {
-					potential_moves[i - push_back] = potential_moves[i];
-				}
-			}
-			potential_moves.len -= push_back;
+		occupied.unset(c->start);
+		occupied.set(end);
+		move_queue_unpark(r, c->start);
+	}
+}
+
+void make_actions(Game* game, Phase phase, Entity_Bit_Array* has_acted, Output_Buffer<Action> actions)
+{
+	auto &controllers = game->controllers;
+
+	switch (phase) {
+	case PHASE_PLAYER_ACTION: {
+		auto c = &controllers.player[0];
+		ASSERT(c->entity_id == ENTITY_ID_PLAYER);
+		auto action = c->action;
+		switch (action.type) {
+		case ACTION_MOVE:
+			break;
+		default:
+			actions.append(action);
+			break;
 		}
 		break;
 	}
+	case PHASE_MOVE:
+		resolve_moves(game, has_acted, actions);
+		break;
 	case PHASE_ENEMY_ACTION:
-		for (u32 i = 0; i < controllers.len; ++i) {
-			auto c = &controllers[i];
-			if (c->type != CONTROLLER_PLAYER) {
-				make_actions(c, game, has_acted, actions);
-			}
-		}
+		make_enemy_actions(game, has_acted, actions);
 		break;
 	}
 }
@@ -1189,6 +1530,7 @@ struct Transaction
 		struct {
 			Entity_ID slime_id;
 			u32       hit_points;
+			u32       split_index;
 		} slime_split;
 		struct {
 			Entity_ID caster_id;
@@ -1413,38 +1755,38 @@ void game_dispatch_message(Game*                      game,
 			break;
 		case MESSAGE_HANDLER_SLIME_SPLIT:
 			if (h->owner_id == message.damage.entity_id && !message.damage.entity_died) {
-				auto e = get_entity_by_id(game, h->owner_id);
+				auto info = get_entity_info_by_id(game, h->owner_id);
 
 				Transaction t = {};
 				t.type = TRANSACTION_SLIME_SPLIT;
 				t.start_time = time + constants.anims.slime_split.duration;
 				t.slime_split.slime_id = h->owner_id;
-				t.slime_split.hit_points = e->hit_points;
+				t.slime_split.hit_points = info->hit_points;
+				t.slime_split.split_index = h->slime_split.num_splits++;
 				transactions.append(t);
 			}
 			break;
 		case MESSAGE_HANDLER_LICH_DEATH:
 			if (h->owner_id == message.death.entity_id) {
-				Controller_ID c_id = h->lich_death.controller_id;
-				auto& controllers = game->controllers;
-				u32 num_controllers = game->controllers.len;
-				Controller *c = NULL;
-				for (u32 i = 0; i < num_controllers; ++i) {
-					if (controllers[i].id == c_id) {
-						c = &controllers[i];
+				auto& liches = game->controllers.lich;
+				Lich_Controller *c = NULL;
+				for (u32 i = 0; i < liches.len; ++i) {
+					if (liches[i].lich_id == h->owner_id) {
+						c = &liches[i];
 						break;
 					}
 				}
 				ASSERT(c);
-				auto& skeleton_ids = c->lich.skeleton_ids;
+				auto& skeleton_ids = c->skeleton_ids;
 				if (!skeleton_ids) {
 					break;
 				}
-				u32 idx = rand_u32() % skeleton_ids.len;
+				Philox rng = game_random_stream(game, h->owner_id, RANDOM_PURPOSE_LICH_SUCCESSOR);
+				u32 idx = rng.rand_u32() % skeleton_ids.len;
 				Entity_ID new_lich_id = skeleton_ids[idx];
 				skeleton_ids.remove(idx);
 				h->owner_id = new_lich_id;
-				c->lich.lich_id = new_lich_id;
+				c->lich_id = new_lich_id;
 
 				Entity *entity = get_entity_by_id(game, new_lich_id);
 				ASSERT(entity);
@@ -1483,8 +1825,14 @@ void game_dispatch_message(Game*                      game,
 				}
 				ASSERT(spawn_poss.len >= 5);
 
+				// keyed on whoever walked in and, since they can set off more than
+				// one trap in a turn, the trap's position -- it has no entity of
+				// its own
+				Pos trap_center = h->trap_spider_cave.center;
+				Philox rng = game_random_stream(game, message.move.entity_id, RANDOM_PURPOSE_TRAP_SPAWN,
+				                                trap_center.x | (trap_center.y << 8));
 				for (u32 i = 0; i < 5; ++i) {
-					u32 idx = i + rand_u32() % (spawn_poss.len - i);
+					u32 idx = i + rng.rand_u32() % (spawn_poss.len - i);
 					auto tmp = spawn_poss[idx];
 					spawn_poss[idx] = spawn_poss[i];
 					spawn_poss[i] = tmp;
@@ -1679,6 +2027,10 @@ Transaction to_transaction(Action action, f32 time)
 	return t;
 }
 
+// Kept between calls for its scratch buffers -- far too big for the stack, and
+// turns are run on more than one thread.
+static thread_local Physics_Context *physics_context = NULL;
+
 f32 game_simulate_actions(Game* game, f32 time, Slice<Action> actions, Output_Buffer<Event> events)
 {
 	// TODO -- field of vision
@@ -1690,10 +2042,15 @@ f32 game_simulate_actions(Game* game, f32 time, Slice<Action> actions, Output_Bu
 	Entity *entities = game->entities.items;
 	auto &tiles = game->tiles;
 
-	// 0. init physics context
+	// 0. reset physics context -- the scratch buffers are kept from the last
+	// call, so they are only grown, never reallocated every turn
 
-	Physics_Context physics;
-	physics_reset(&physics);
+	if (!physics_context) {
+		physics_context = (Physics_Context*)calloc(1, sizeof(Physics_Context));
+		physics_init(physics_context);
+	}
+	physics_reset(physics_context);
+	Physics_Context &physics = *physics_context;
 
 	const u32 collision_mask_wall       = 1 << 0;
 	const u32 collision_mask_entity     = 1 << 1;
@@ -2013,6 +2370,40 @@ f32 game_simulate_actions(Game* game, f32 time, Slice<Action> actions, Output_Bu
 	Max_Length_Array<Projectile, MAX_PROJECTILES> projectiles;
 	projectiles.reset();
 
+	// open addressing table from projectile entity id to index in projectiles
+#define PROJECTILE_INDEX_SIZE (2 * MAX_PROJECTILES)
+	struct Projectile_Index
+	{
+		Entity_ID entity_ids[PROJECTILE_INDEX_SIZE];
+		u16       projectile_idxs[PROJECTILE_INDEX_SIZE];
+
+		void reset() { memset(entity_ids, 0, sizeof(entity_ids)); }
+		void add(Entity_ID entity_id, u32 projectile_idx)
+		{
+			ASSERT(entity_id);
+			u32 slot = entity_id % PROJECTILE_INDEX_SIZE;
+			while (entity_ids[slot]) {
+				slot = (slot + 1) % PROJECTILE_INDEX_SIZE;
+			}
+			entity_ids[slot] = entity_id;
+			projectile_idxs[slot] = (u16)projectile_idx;
+		}
+		// returns not_found if the entity isn't a projectile
+		u32 get(Entity_ID entity_id, u32 not_found)
+		{
+			u32 slot = entity_id % PROJECTILE_INDEX_SIZE;
+			while (entity_ids[slot]) {
+				if (entity_ids[slot] == entity_id) {
+					return projectile_idxs[slot];
+				}
+				slot = (slot + 1) % PROJECTILE_INDEX_SIZE;
+			}
+			return not_found;
+		}
+	};
+	Projectile_Index projectile_index;
+	projectile_index.reset();
+
 	struct Entities_Hit_By_Projectile
 	{
 		Entity_ID projectile_id;
@@ -2021,12 +2412,10 @@ f32 game_simulate_actions(Game* game, f32 time, Slice<Action> actions, Output_Bu
 	Max_Length_Array<Entities_Hit_By_Projectile, MAX_PROJECTILES> entities_hit_by_projectile;
 	entities_hit_by_projectile.reset();
 
-#define MAX_PHYSICS_EVENTS 10240
-	Max_Length_Array<Physics_Event, MAX_PHYSICS_EVENTS> physics_events;
-	physics_events.reset();
+	Physics_Event_Queue physics_events;
 
 	physics_start_frame(&physics);
-	physics_compute_collisions(&physics, 0.0f, physics_events);
+	physics_compute_collisions(&physics, 0.0f, &physics_events);
 
 	auto &fovs = game->fovs;
 	ASSERT(fovs.len >= 1);
@@ -2042,17 +2431,20 @@ f32 game_simulate_actions(Game* game, f32 time, Slice<Action> actions, Output_Bu
 		physics_processing_left = 0;
 		entity_damage.reset();
 
+		Slice<Physics_Event> cur_physics_events = physics_events_at(&physics_events, time);
+		f32 next_physics_event_time;
+		if (physics_next_event_time(&physics_events, time, &next_physics_event_time)) {
+			physics_processing_left = 1;
+		}
+
 		// draw physics state
 		if (0) {
 			debug_draw_world_reset();
 			physics_debug_draw(&physics, time);
 
 			debug_draw_world_set_color(v4(0.0f, 0.0f, 1.0f, 0.75f));
-			for (u32 i = 0; i < physics_events.len; ++i) {
-				Physics_Event pe = physics_events[i];
-				if (pe.time != time) {
-					continue;
-				}
+			for (u32 i = 0; i < cur_physics_events.len; ++i) {
+				Physics_Event pe = cur_physics_events[i];
 				switch (pe.type) {
 				case PHYSICS_EVENT_BEGIN_PENETRATE_SL_LC:
 				case PHYSICS_EVENT_END_PENETRATE_SL_LC: {
@@ -2103,34 +2495,21 @@ f32 game_simulate_actions(Game* game, f32 time, Slice<Action> actions, Output_Bu
 			debug_pause();
 		}
 
-		for (u32 i = 0; i < physics_events.len; ++i) {
-			Physics_Event pe = physics_events[i];
-			if (pe.time < time) {
-				continue;
-			}
-			if (pe.time > time) {
-				physics_processing_left = 1;
-				break;
-			}
+		for (u32 i = 0; i < cur_physics_events.len; ++i) {
+			Physics_Event pe = cur_physics_events[i];
 			switch (pe.type) {
 			case PHYSICS_EVENT_BEGIN_PENETRATE_SL_LC: {
 				if (!pe.sl_lc.circle->owner_id) {
 					break;
 				}
-				u32 projectile_idx = projectiles.len;
-				for (u32 i = 0; i < projectiles.len; ++i) {
-					if (projectiles[i].entity_id == pe.sl_lc.circle->owner_id) {
-						projectile_idx = i;
-						break;
-					}
-				}
+				u32 projectile_idx = projectile_index.get(pe.sl_lc.circle->owner_id, projectiles.len);
 				ASSERT(projectile_idx < projectiles.len);
 				Projectile *p = &projectiles[projectile_idx];
 				switch (p->type) {
 				case PROJECTILE_FIREBALL_OFFSHOOT:
 					if (pe.sl_lc.line->owner_id == ENTITY_ID_WALLS) {
 						recompute_physics_collisions = 1;
-						pe.sl_lc.circle->owner_id = 0;
+						physics_remove_object(pe.sl_lc.circle);
 						f32 start_time = pe.sl_lc.circle->start_time;
 						f32 duration = time - start_time;
 						v2 p = pe.sl_lc.circle->start;
@@ -2179,6 +2558,7 @@ f32 game_simulate_actions(Game* game, f32 time, Slice<Action> actions, Output_Bu
 						c->start = new_start;
 						c->duration -= time - c->start_time;
 						c->start_time = time;
+						physics_mark_changed(c);
 					}
 					break;
 				default:
@@ -2188,16 +2568,11 @@ f32 game_simulate_actions(Game* game, f32 time, Slice<Action> actions, Output_Bu
 				break;
 			}
 			case PHYSICS_EVENT_BEGIN_PENETRATE_SC_LC: {
-				u32 projectile_idx = projectiles.len;
 				if (!pe.sc_lc.linear_circle->owner_id) {
 					break;
 				}
-				for (u32 i = 0; i < projectiles.len; ++i) {
-					if (projectiles[i].entity_id == pe.sc_lc.linear_circle->owner_id) {
-						projectile_idx = i;
-						break;
-					}
-				}
+				u32 projectile_idx = projectile_index.get(pe.sc_lc.linear_circle->owner_id,
+				                                          projectiles.len);
 				ASSERT(projectile_idx < projectiles.len);
 				Projectile *p = &projectiles[projectile_idx];
 				switch (p->type) {
@@ -2260,16 +2635,11 @@ f32 game_simulate_actions(Game* game, f32 time, Slice<Action> actions, Output_Bu
 				break;
 			}
 			case PHYSICS_EVENT_END_PENETRATE_SC_LC: {
-				u32 projectile_idx = projectiles.len;
 				if (!pe.sc_lc.linear_circle->owner_id) {
 					break;
 				}
-				for (u32 i = 0; i < projectiles.len; ++i) {
-					if (projectiles[i].entity_id == pe.sc_lc.linear_circle->owner_id) {
-						projectile_idx = i;
-						break;
-					}
-				}
+				u32 projectile_idx = projectile_index.get(pe.sc_lc.linear_circle->owner_id,
+				                                          projectiles.len);
 				ASSERT(projectile_idx < projectiles.len);
 				Projectile *p = &projectiles[projectile_idx];
 				switch (p->type) {
@@ -2291,42 +2661,19 @@ f32 game_simulate_actions(Game* game, f32 time, Slice<Action> actions, Output_Bu
 				break;
 			}
 			case PHYSICS_EVENT_BEGIN_PENETRATE_LC_LC: {
-				u32 projectile_idx_1 = projectiles.len;
-				u32 projectile_idx_2 = projectiles.len;
-				for (u32 i = 0; i < projectiles.len; ++i) {
-					u32 projectile_entity_id = projectiles[i].entity_id;
-					if (projectile_entity_id == pe.lc_lc.circle_1->owner_id) {
-						projectile_idx_1 = i;
-						if (projectile_idx_2 < projectiles.len) {
-							break;
-						}
-					}
-					if (projectile_entity_id == pe.lc_lc.circle_2->owner_id) {
-						projectile_idx_2 = i;
-						if (projectile_idx_1 < projectiles.len) {
-							break;
-						}
-					}
-					// TODO -- collision between "entity" and projectile
-				}
+				// TODO -- collision between "entity" and projectile
 				break;
 			}
 			case PHYSICS_EVENT_LC_END: {
 				if (!pe.lc.circle->owner_id) {
 					break;
 				}
-				u32 projectile_idx = projectiles.len;
-				for (u32 i = 0; i < projectiles.len; ++i) {
-					if (projectiles[i].entity_id == pe.lc.circle->owner_id) {
-						projectile_idx = i;
-						break;
-					}
-				}
+				u32 projectile_idx = projectile_index.get(pe.lc.circle->owner_id, projectiles.len);
 				if(projectile_idx < projectiles.len) {
 					switch (projectiles[projectile_idx].type) {
 					case PROJECTILE_FIREBALL_OFFSHOOT: {
 						recompute_physics_collisions = 1;
-						pe.lc.circle->owner_id = 0;
+						physics_remove_object(pe.lc.circle);
 						f32 start_time = pe.lc.circle->start_time;
 						f32 duration = time - start_time;
 						v2 p = pe.lc.circle->start;
@@ -2428,7 +2775,7 @@ f32 game_simulate_actions(Game* game, f32 time, Slice<Action> actions, Output_Bu
 				circle.start_time = time;
 				circle.duration = constants.anims.move.duration;
 				circle.radius = constants.physics.entity_radius;
-				physics.linear_circles.append(circle);
+				physics_add_linear_circle(&physics, circle);
 				recompute_physics_collisions = 1;
 
 				t->type = TRANSACTION_MOVE_PRE_ENTER;
@@ -2497,7 +2844,7 @@ f32 game_simulate_actions(Game* game, f32 time, Slice<Action> actions, Output_Bu
 					circle.start_time = time - constants.anims.move.duration / 2.0f;
 					circle.duration = constants.anims.move.duration;
 					circle.radius = constants.physics.entity_radius;
-					physics.linear_circles.append(circle);
+					physics_add_linear_circle(&physics, circle);
 
 					t->move.end = t->move.start;
 					event.type = EVENT_MOVE_BLOCKED;
@@ -2534,7 +2881,7 @@ f32 game_simulate_actions(Game* game, f32 time, Slice<Action> actions, Output_Bu
 				circle.owner_id = t->move.entity_id;
 				circle.pos = (v2)t->move.end;
 				circle.radius = constants.physics.entity_radius;
-				physics.static_circles.append(circle);
+				physics_add_static_circle(&physics, circle);
 
 				break;
 			}
@@ -2768,7 +3115,7 @@ f32 game_simulate_actions(Game* game, f32 time, Slice<Action> actions, Output_Bu
 				events.append(event);
 				door->flags = (Entity_Flag)(door->flags & ~ENTITY_FLAG_BLOCKS_VISION);
 				door->block_mask = 0;
-				door->default_action = ACTION_CLOSE_DOOR;
+				get_entity_info(game, door)->default_action = ACTION_CLOSE_DOOR;
 
 				break;
 			}
@@ -2785,12 +3132,12 @@ f32 game_simulate_actions(Game* game, f32 time, Slice<Action> actions, Output_Bu
 				event.type = EVENT_CLOSE_DOOR;
 				event.time = time;
 				event.close_door.door_id = door_id;
-				event.close_door.new_appearance = door->appearance;
+				event.close_door.new_appearance = get_entity_info(game, door)->appearance;
 				events.append(event);
 
 				door->flags = (Entity_Flag)(door->flags | ENTITY_FLAG_BLOCKS_VISION);
 				door->block_mask = BLOCK_FLY | BLOCK_SWIM | BLOCK_WALK;
-				door->default_action = ACTION_OPEN_DOOR;
+				get_entity_info(game, door)->default_action = ACTION_OPEN_DOOR;
 
 				break;
 			}
@@ -2839,6 +3186,7 @@ f32 game_simulate_actions(Game* game, f32 time, Slice<Action> actions, Output_Bu
 				Projectile projectile = {};
 				projectile.type = PROJECTILE_FIREBALL_OFFSHOOT;
 				projectile.entity_id = new_entity_id(game);
+				projectile_index.add(projectile.entity_id, projectiles.len);
 				projectiles.append(projectile);
 
 				recompute_physics_collisions = 1;
@@ -2856,16 +3204,16 @@ f32 game_simulate_actions(Game* game, f32 time, Slice<Action> actions, Output_Bu
 					f32 sa = sinf(angle);
 
 					circle.velocity = 5.0f * v2( ca,  sa);
-					physics.linear_circles.append(circle);
+					physics_add_linear_circle(&physics, circle);
 
 					circle.velocity = 5.0f * v2(-sa,  ca);
-					physics.linear_circles.append(circle);
+					physics_add_linear_circle(&physics, circle);
 
 					circle.velocity = 5.0f * v2(-ca, -sa);
-					physics.linear_circles.append(circle);
+					physics_add_linear_circle(&physics, circle);
 
 					circle.velocity = 5.0f * v2( sa, -ca);
-					physics.linear_circles.append(circle);
+					physics_add_linear_circle(&physics, circle);
 				}
 
 				break;
@@ -2985,7 +3333,9 @@ f32 game_simulate_actions(Game* game, f32 time, Slice<Action> actions, Output_Bu
 					}
 				}
 				if (poss) {
-					Pos end = poss[rand_u32() % poss.len];
+					Philox rng = game_random_stream(game, t->slime_split.slime_id, RANDOM_PURPOSE_SLIME_SPLIT,
+					                                t->slime_split.split_index);
+					Pos end = poss[rng.rand_u32() % poss.len];
 					Entity_ID new_id = add_slime(game,
 					                             end,
 					                             t->slime_split.hit_points);
@@ -3075,7 +3425,7 @@ f32 game_simulate_actions(Game* game, f32 time, Slice<Action> actions, Output_Bu
 					auto fire = add_creature(game, (Pos)line[i], CREATURE_FIRE_WALL);
 
 					event.add_creature.creature_id = fire->id;
-					event.add_creature.appearance = fire->appearance;
+					event.add_creature.appearance = get_entity_info(game, fire)->appearance;
 					event.add_creature.pos = (v2)fire->pos;
 					events.append(event);
 				}
@@ -3099,8 +3449,9 @@ f32 game_simulate_actions(Game* game, f32 time, Slice<Action> actions, Output_Bu
 				if (!target) {
 					break;
 				}
-				target->hit_points += t->heal.amount;
-				target->hit_points = min_i32(target->hit_points, target->max_hit_points);
+				Entity_Info *target_info = get_entity_info(game, target);
+				target_info->hit_points += t->heal.amount;
+				target_info->hit_points = min_i32(target_info->hit_points, target_info->max_hit_points);
 
 				Event e = {};
 				e.type = EVENT_HEAL;
@@ -3131,6 +3482,7 @@ f32 game_simulate_actions(Game* game, f32 time, Slice<Action> actions, Output_Bu
 				Projectile projectile = {};
 				projectile.type = PROJECTILE_LIGHTNING_BOLT;
 				projectile.entity_id = new_entity_id(game);
+				projectile_index.add(projectile.entity_id, projectiles.len);
 				projectiles.append(projectile);
 
 				Entities_Hit_By_Projectile hit = {};
@@ -3152,7 +3504,7 @@ f32 game_simulate_actions(Game* game, f32 time, Slice<Action> actions, Output_Bu
 				dir = dir / sqrtf(dir.x*dir.x + dir.y*dir.y);
 				circle.velocity = constants.physics.lightning_distance * dir;
 
-				physics.linear_circles.append(circle);
+				physics_add_linear_circle(&physics, circle);
 
 				Event e = {};
 				e.type = EVENT_LIGHTNING_BOLT_START;
@@ -3193,7 +3545,7 @@ f32 game_simulate_actions(Game* game, f32 time, Slice<Action> actions, Output_Bu
 				e.time = t->start_time;
 				e.shoot_web_hit.pos = (v2)t->shoot_web.target;
 				e.shoot_web_hit.web_id = web->id;
-				e.shoot_web_hit.appearance = web->appearance;
+				e.shoot_web_hit.appearance = get_entity_info(game, web)->appearance;
 				events.append(e);
 
 				break;
@@ -3222,7 +3574,7 @@ f32 game_simulate_actions(Game* game, f32 time, Slice<Action> actions, Output_Bu
 				event.type = EVENT_ADD_CREATURE;
 				event.time = t->start_time;
 				event.add_creature.creature_id = entity->id;
-				event.add_creature.appearance = entity->appearance;
+				event.add_creature.appearance = get_entity_info(game, entity)->appearance;
 				event.add_creature.pos = (v2)entity->pos;
 				events.append(event);
 
@@ -3475,11 +3827,11 @@ f32 game_simulate_actions(Game* game, f32 time, Slice<Action> actions, Output_Bu
 			Entity_Damage *ed = &entity_damage[i];
 			Entity_ID entity_id = ed->entity_id;
 
-			auto e = get_entity_by_id(game, entity_id);
-			ASSERT(e);
+			auto info = get_entity_info_by_id(game, entity_id);
+			ASSERT(info);
 
-			e->hit_points -= ed->damage;
-			u8 entity_died = e->hit_points <= 0;
+			info->hit_points -= ed->damage;
+			u8 entity_died = info->hit_points <= 0;
 
 			Message m = {};
 			m.type = MESSAGE_DAMAGE;
@@ -3526,19 +3878,13 @@ f32 game_simulate_actions(Game* game, f32 time, Slice<Action> actions, Output_Bu
 		if (recompute_physics_collisions) {
 			recompute_physics_collisions = 0;
 			physics_start_frame(&physics);
-			physics_compute_collisions(&physics, time, physics_events);
+			physics_update_collisions(&physics, time, &physics_events);
 		}
 
 		// TODO - need some better representation of "infinity"
 		f32 next_time = 1000000.0f;
-		for (u32 i = 0; i < physics_events.len; ++i) {
-			Physics_Event pe = physics_events[i];
-			if (pe.time <= time) {
-				continue;
-			}
-			next_time = pe.time;
+		if (physics_next_event_time(&physics_events, time, &next_time)) {
 			physics_processing_left = 1;
-			break;
 		}
 
 		for (u32 i = 0; i < transactions.len; ++i) {
@@ -3555,33 +3901,28 @@ f32 game_simulate_actions(Game* game, f32 time, Slice<Action> actions, Output_Bu
 		}
 	}
 
-	Entity_ID player_id;
-	{
-		Controller *c = &game->controllers[0];
-		ASSERT(c->type == CONTROLLER_PLAYER);
-		player_id = c->player.entity_id;
-	}
-
 	return time;
 }
 
 void game_do_turn(Game* game, Output_Buffer<Event> events)
 {
 	events.reset();
+	++game->turn;
 
 	Max_Length_Array<Action, MAX_ENTITIES> actions;
-	bool has_acted[MAX_ENTITIES] = {};
+	auto &has_acted = game->has_acted;
+	has_acted.reset();
 
-	do_cooldowns(game->controllers);
+	game_do_timers(game);
 
 	f32 time = 0.0f;
 	for (auto phase = (Phase)0; phase < NUM_PHASES; phase = (Phase)(phase + 1)) {
 		actions.reset();
-		make_actions(game, phase, Slice<bool>(has_acted, ARRAY_SIZE(has_acted)), actions);
+		make_actions(game, phase, &has_acted, actions);
 		for (u32 i = 0; i < actions.len; ++i) {
 			auto entity_id = actions[i].entity_id;
-			ASSERT(!has_acted[entity_id]);
-			has_acted[entity_id] = true;
+			ASSERT(!has_acted.get(entity_id_index(entity_id)));
+			has_acted.set(entity_id_index(entity_id));
 		}
 		time = game_simulate_actions(game, time, actions, events);
 	}
@@ -3595,9 +3936,8 @@ void do_action(Game* game, Action action, Output_Buffer<Event> events)
 		game_simulate_actions(game, 0.0f, slice_one(&action), events);
 		break;
 	default: {
-		auto c = &game->controllers[0];
-		ASSERT(c->type == CONTROLLER_PLAYER);
-		c->player.action = action;
+		auto c = &game->controllers.player[0];
+		c->action = action;
 		game_do_turn(game, events);
 		break;
 	}
@@ -3697,8 +4037,8 @@ Pos get_pos(Game* game, Entity_ID entity_id)
 	if (e) {
 		return e->pos;
 	}
-	if (entity_id < MAX_ENTITIES) {
+	if (!entity_id_is_tile(entity_id)) {
 		return Pos(0, 0);
 	}
-	return u16_to_pos(entity_id - MAX_ENTITIES);
+	return tile_entity_id_to_pos(entity_id);
 }
\ No newline at end of file
@@ -16,7 +16,6 @@
 // Forwards
 // =============================================================================
 
-struct Controller;
 struct Game;
 
 typedef u32 Card_ID;
@@ -143,85 +142,179 @@ struct Action
 	operator bool() { return type; }
 };
 
+// =============================================================================
+// Timers
+// =============================================================================
+
+// Turn keyed timers -- cooldowns now, and anything that has to happen N turns
+// on or every N turns. They sit in a hierarchical wheel: TIMER_WHEEL_LEVELS
+// rings of TIMER_WHEEL_SLOTS slots, each level's slots TIMER_WHEEL_SLOTS times
+// as many turns apart as the one below. A timer goes in the lowest level its
+// turn is within range of and drops down a level as the turn gets closer, so
+// a turn only touches the slot that's due plus, whenever a level wraps round,
+// one slot of the level above.
+//
+// A Timer_ID is a handle like an Entity_ID -- index in the low bits, a count
+// of the index's reuses above -- and goes stale when the timer fires (unless
+// it's periodic) or is removed. 0 is never a timer.
+typedef u32 Timer_ID;
+
+#define TIMER_ID_INDEX_BITS   14
+#define TIMER_ID_INDEX_MASK   ((1 << TIMER_ID_INDEX_BITS) - 1)
+#define MAX_TIMERS            (1 << TIMER_ID_INDEX_BITS)
+#define TIMER_WHEEL_LEVELS    4
+#define TIMER_WHEEL_SLOT_BITS 6
+#define TIMER_WHEEL_SLOTS     (1 << TIMER_WHEEL_SLOT_BITS)
+// furthest ahead a timer can be set
+#define TIMER_MAX_DELAY       ((1 << (TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOT_BITS)) - 1)
+
+enum Timer_Type
+{
+	// does nothing on firing -- whoever holds the ID asks timer_is_pending()
+	TIMER_COOLDOWN,
+};
+
+struct Timer
+{
+	u32        turn;       // fires at the start of this turn
+	u32        period;     // turns until it fires again, 0 for once only
+	Entity_ID  owner_id;
+	u32        next;       // within its slot, or the free list
+	u32        prev;
+	u16        slot;       // level * TIMER_WHEEL_SLOTS + slot in the level
+	u16        generation;
+	Timer_Type type;
+};
+
+struct Fired_Timer
+{
+	Timer_ID   timer_id;
+	Timer_Type type;
+	Entity_ID  owner_id;
+};
+
+// index 0 of timers isn't used, so 0 can mean none in the links
+struct Timer_Wheel
+{
+	u32   next_timer_index;
+	u32   free_list;
+	u32   slots[TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS];
+	Timer timers[MAX_TIMERS];
+};
+
 // =============================================================================
 // Controllers
 // =============================================================================
 
-typedef u32 Controller_ID;
+// Controllers live in a pool per type -- a packed array of that type's own
+// struct -- so each AI behaviour runs as one loop over its pool rather than a
+// switch per controller.
+//
+// CONTROLLER_TYPE(enum name, struct prefix, pool name, max in a game)
+#define CONTROLLER_TYPES \
+	CONTROLLER_TYPE(PLAYER,        Player,        player,        1) \
+	CONTROLLER_TYPE(RANDOM_MOVE,   Random_Move,   random_move,   GAME_MAX_CONTROLLERS) \
+	CONTROLLER_TYPE(DRAGON,        Dragon,        dragon,        GAME_MAX_CONTROLLERS) \
+	CONTROLLER_TYPE(SLIME,         Slime,         slime,         GAME_MAX_CONTROLLERS) \
+	CONTROLLER_TYPE(LICH,          Lich,          lich,          GAME_MAX_LICH_CONTROLLERS) \
+	CONTROLLER_TYPE(IMP,           Imp,           imp,           GAME_MAX_CONTROLLERS) \
+	CONTROLLER_TYPE(SPIDER_NORMAL, Spider_Normal, spider_normal, GAME_MAX_CONTROLLERS) \
+	CONTROLLER_TYPE(SPIDER_WEB,    Spider_Web,    spider_web,    GAME_MAX_CONTROLLERS) \
+	CONTROLLER_TYPE(SPIDER_POISON, Spider_Poison, spider_poison, GAME_MAX_CONTROLLERS) \
+	CONTROLLER_TYPE(SPIDER_SHADOW, Spider_Shadow, spider_shadow, GAME_MAX_CONTROLLERS)
+
+#define GAME_MAX_CONTROLLERS      1024
+#define GAME_MAX_LICH_CONTROLLERS 64
 
 enum Controller_Type
 {
-	CONTROLLER_PLAYER,
-	CONTROLLER_RANDOM_MOVE,
-	CONTROLLER_DRAGON,
-	CONTROLLER_SLIME,
-	CONTROLLER_LICH,
-	CONTROLLER_IMP,
+#define CONTROLLER_TYPE(upper, type, name, max) CONTROLLER_##upper,
+	CONTROLLER_TYPES
+#undef CONTROLLER_TYPE
 
-	CONTROLLER_SPIDER_NORMAL,
-	CONTROLLER_SPIDER_WEB,
-	CONTROLLER_SPIDER_POISON,
-	CONTROLLER_SPIDER_SHADOW,
+	NUM_CONTROLLER_TYPES
 };
 
 #define CONTROLLER_LICH_MAX_SKELETONS 16
 
-struct Controller
+struct Player_Controller
 {
-	Controller_Type type;
-	Controller_ID   id;
+	Entity_ID entity_id;
+	Action    action;
+};
 
-	union {
-		struct {
-			Entity_ID entity_id;
-			Action    action;
-		} player;
-		struct {
-			Entity_ID entity_id;
-		} random_move;
-		struct {
-			Entity_ID entity_id;
-		} dragon;
-		struct {
-			Entity_ID entity_id;
-			u32       split_cooldown;
-		} slime;
-		struct {
-			Entity_ID lich_id;
-			Max_Length_Array<Entity_ID, CONTROLLER_LICH_MAX_SKELETONS> skeleton_ids;
-			u32 heal_cooldown;
-		} lich;
-		struct {
-			Entity_ID imp_id;
-		} imp;
-		struct {
-			Entity_ID entity_id;
-		} spider_normal;
-		struct {
-			Entity_ID entity_id;
-			u32       web_cooldown;
-		} spider_web;
-		struct {
-			Entity_ID entity_id;
-		} spider_poison;
-		struct {
-			Entity_ID entity_id;
-			u32       invisible_cooldown;
-		} spider_shadow;
-	};
+struct Random_Move_Controller
+{
+	Entity_ID entity_id;
 };
 
-struct Potential_Move
+struct Dragon_Controller
 {
 	Entity_ID entity_id;
-	Pos start;
-	Pos end;
-	f32 weight;
 };
 
-void make_bump_attacks(Controller* controller, Game* game, Output_Buffer<Action> attacks);
-void make_moves(Controller* controller, Game* game, Output_Buffer<Potential_Move> moves);
-void make_actions(Controller* controller, Game* game, Slice<bool> has_acted, Output_Buffer<Action> actions);
+struct Slime_Controller
+{
+	Entity_ID entity_id;
+};
+
+struct Lich_Controller
+{
+	Entity_ID lich_id;
+	Max_Length_Array<Entity_ID, CONTROLLER_LICH_MAX_SKELETONS> skeleton_ids;
+	Timer_ID  heal_cooldown;
+};
+
+struct Imp_Controller
+{
+	Entity_ID entity_id;
+};
+
+struct Spider_Normal_Controller
+{
+	Entity_ID entity_id;
+};
+
+struct Spider_Web_Controller
+{
+	Entity_ID entity_id;
+	Timer_ID  web_cooldown;
+};
+
+struct Spider_Poison_Controller
+{
+	Entity_ID entity_id;
+};
+
+struct Spider_Shadow_Controller
+{
+	Entity_ID entity_id;
+	Timer_ID  invisible_cooldown;
+};
+
+struct Controllers
+{
+#define CONTROLLER_TYPE(upper, type, name, max) Max_Length_Array<type##_Controller, max> name;
+	CONTROLLER_TYPES
+#undef CONTROLLER_TYPE
+};
+
+// a flag per entity, by entity_id_index() -- indices are reused so these only
+// ever cover the most entities alive at once
+typedef Bit_Array<MAX_ENTITIES> Entity_Bit_Array;
+
+// An entity's options for PHASE_MOVE -- a slot per neighbour of start, in
+// MOVE_DIRECTIONS order, with a bit in valid_mask for each it might move to.
+#define MOVE_SLOTS 8
+
+struct Move_Candidates
+{
+	Entity_ID entity_id;
+	Pos       start;
+	u8        valid_mask;
+	f32       weights[MOVE_SLOTS];
+};
+
 
 // =============================================================================
 // Entities
@@ -250,6 +343,9 @@ enum Entity_Flag
 	ENTITY_FLAG_BLOCKS_VISION     = 1 << 2,
 };
 
+// An entity is split in two. Entity has what gets scanned for every entity each
+// turn -- occupancy, blocking vision, physics -- and is 16 bytes. Entity_Info has
+// the rest, in a parallel table reached through get_entity_info().
 struct Entity
 {
 	Entity_ID     id;
@@ -257,6 +353,10 @@ struct Entity
 	u16           movement_type;
 	u16           block_mask;
 	Pos           pos;
+};
+
+struct Entity_Info
+{
 	Appearance    appearance;
 	i32           hit_points;
 	i32           max_hit_points;
@@ -369,14 +469,15 @@ struct Message_Handler
 		struct {
 			Pos pos;
 		} trap;
-		struct {
-			Controller_ID controller_id;
-		} lich_death;
 		struct {
 			Pos center;
 			u32 radius;
 			u32 last_dist_squared;
 		} trap_spider_cave;
+		struct {
+			// keys each split's draw, as a slime can split more than once a turn
+			u32 num_splits;
+		} slime_split;
 	};
 };
 
@@ -641,23 +742,42 @@ struct Event
 // Game
 // =============================================================================
 
-#define GAME_MAX_CONTROLLERS 1024
 #define GAME_MAX_MESSAGE_HANDLERS 1024
 #define GAME_MAX_FOVS 8
 
 struct Game
 {
-	Entity_ID     next_entity_id;
-	Controller_ID next_controller_id;
+	// indices below this have been handed out -- the free ones are in
+	// free_entity_indices
+	u32           next_entity_index;
 	Card_ID       next_card_id;
 
 	Entity_ID     player_id;
 
+	// the simulation's random draws are keyed on these rather than taken from
+	// the thread's generator -- see game_random_stream() in game.cpp
+	u32           random_seed;
+	u32           turn;
+
+	// entity_infos[i] goes with entities[i]. Both are packed, and entity_slots
+	// gives where an entity currently is by entity_id_index().
 	Max_Length_Array<Entity, MAX_ENTITIES> entities;
+	Entity_Info                            entity_infos[MAX_ENTITIES];
+	u16                                    entity_slots[MAX_ENTITIES];
+	u16                                    entity_generations[MAX_ENTITIES];
+	Max_Length_Array<u16, MAX_ENTITIES>    free_entity_indices;
+
+	// by entity_id_index() -- reset each turn, and cleared when an index is
+	// handed out so a new entity doesn't inherit the bit of one which died
+	// earlier in the turn
+	Entity_Bit_Array has_acted;
 
 	Map_Cache<Tile> tiles;
 
-	Max_Length_Array<Controller, GAME_MAX_CONTROLLERS> controllers;
+	Controllers controllers;
+
+	// keyed on turn -- the wheel doesn't keep its own
+	Timer_Wheel timers;
 
 	Card_State card_state;
 
@@ -672,15 +792,35 @@ struct Game
 // Functions
 // =============================================================================
 
+// e has to be in game->entities
+static inline Entity_Info* get_entity_info(Game* game, Entity* e)
+{
+	return &game->entity_infos[e - game->entities.items];
+}
+
 void             init(Game* game);
 void             update_fov(Game* game);
 
 Entity*          get_player(Game* game);
+// true once every creature -- anything that moves -- but the player is gone
+bool             game_is_level_cleared(Game* game);
+bool             entity_id_is_live(Game* game, Entity_ID entity_id);
 Entity*          get_entity_by_id(Game* game, Entity_ID entity_id);
+Entity_Info*     get_entity_info_by_id(Game* game, Entity_ID entity_id);
 Entity*          add_entity(Game* game);
-Controller*      add_controller(Game* game);
+#define CONTROLLER_TYPE(upper, type, name, max) type##_Controller* add_##name##_controller(Game* game);
+CONTROLLER_TYPES
+#undef CONTROLLER_TYPE
 Message_Handler* add_message_handler(Game* game);
 
+// delay and period are in turns, at least 1 -- a periodic timer first fires
+// period turns from now. A timer whose owner has died is dropped when it comes
+// due; owner_id 0 is for timers that aren't any entity's.
+Timer_ID         add_timer(Game* game, Timer_Type type, Entity_ID owner_id, u32 delay);
+Timer_ID         add_periodic_timer(Game* game, Timer_Type type, Entity_ID owner_id, u32 period);
+void             remove_timer(Game* game, Timer_ID timer_id);
+bool             timer_is_pending(Game* game, Timer_ID timer_id);
+
 Card*            add_card(Game* game, Card_Appearance appearance);
 
 Entity*          add_creature(Game* game, Pos pos, Creature_Type type);
@@ -703,6 +843,8 @@ void             get_card_params(Game* game, Card_ID card_id, Action_Type* actio
 
 // These functions should probably become internal
 void             game_do_turn(Game* game, Output_Buffer<Event> events);
+// fires the timers due on game->turn, which has to have just moved on by one
+void             game_do_timers(Game* game);
 bool             game_is_pos_opaque(Game* game, Pos pos);
 bool             tile_is_passable(Tile tile, u16 move_mask);
 
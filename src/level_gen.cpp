@@ -2,42 +2,25 @@
 
 #include "stdafx.h"
 #include "random.h"
+#include "platform_functions.h"
+#include "prebuilt_level.h"
+
+#define JFG_HEADER_ONLY
+#include "thread.h"
+#undef JFG_HEADER_ONLY
 
 static thread_local Log *thread_log = NULL;
-static void log(const char* str)
-{
-	if (thread_log) {
-		log(thread_log, str);
-	}
-}
-static void logf(const char* fmt_str, ...)
-{
-	if (!thread_log) {
-		return;
-	}
-	char print_buffer[4096];
-	va_list args;
-	va_start(args, fmt_str);
-	vsnprintf(print_buffer, ARRAY_SIZE(print_buffer), fmt_str, args);
-	va_end(args);
+static thread_local Level_Gen_Stats *thread_stats = NULL;
+static Work_Queue *work_queue = NULL;
 
-	log(thread_log, print_buffer);
+void level_gen_set_work_queue(Work_Queue* queue)
+{
+	work_queue = queue;
 }
 
-static void log_map(Map_Cache_Bool* map, v2_u32 size)
+void level_gen_set_thread_stats(Level_Gen_Stats* stats)
 {
-	char buffer[256] = {};
-	for (u32 y = 0; y < size.h; ++y) {
-		for (u32 x = 0; x < size.w; ++x) {
-			Pos p = Pos(x, y);
-			if (map->get(p)) {
-				buffer[x] = '#';
-			} else {
-				buffer[x] = '.';
-			}
-		}
-		log(buffer);
-	}
+	thread_stats = stats;
 }
 
 // Rooms always assumed to have borders
@@ -118,163 +101,509 @@ static void move_to_top_left(Map_Cache_Bool* map, v2_u32* size)
 	*size = new_size;
 }
 
-static void biggest_connected_component(Map_Cache_Bool* map, v2_u32 size)
+struct Connected_Component
+{
+	u32    area;
+	v2_u32 min; // inclusive bounding box
+	v2_u32 max;
+};
+
+// Floor components of a room, found with union-find. Buffers are kept between
+// calls and only grow, so a thread can reuse one for all its attempts.
+//   labels     -- per cell of the room (y * size.w + x), component index + 1 or
+//                 0 for walls
+//   components -- in order of each component's first cell, top to bottom
+struct Connected_Components
+{
+	v2_u32               size;
+	u32                  num_components;
+	u32                 *labels;
+	Connected_Component *components;
+	u32                 *parents;
+	u8                  *ranks;
+	u32                 *root_components;
+	u32                  capacity;
+};
+
+static void free(Connected_Components* cc)
 {
-	Map_Cache<u32> component_map;
-	memset(&component_map, 0, sizeof(component_map));
-	u32 component_keys[256*256] = {};
-	u32 component_counts[256*256] = {};
-	u32 num_components = 0;
+	free(cc->labels);
+	free(cc->components);
+	free(cc->parents);
+	free(cc->ranks);
+	free(cc->root_components);
+	memset(cc, 0, sizeof(*cc));
+}
 
+static void connected_components_reserve(Connected_Components* cc, u32 num_cells)
+{
+	if (num_cells <= cc->capacity) {
+		return;
+	}
+	free(cc);
+	cc->labels          = (u32*)malloc(num_cells * sizeof(cc->labels[0]));
+	cc->components      = (Connected_Component*)malloc(num_cells * sizeof(cc->components[0]));
+	cc->parents         = (u32*)malloc(num_cells * sizeof(cc->parents[0]));
+	cc->ranks           = (u8*)malloc(num_cells * sizeof(cc->ranks[0]));
+	cc->root_components = (u32*)malloc(num_cells * sizeof(cc->root_components[0]));
+	cc->capacity        = num_cells;
+}
+
+// path halving -- every other node on the walk is pointed at its grandparent
+static u32 union_find_root(u32* parents, u32 x)
+{
+	while (parents[x] != x) {
+		parents[x] = parents[parents[x]];
+		x = parents[x];
+	}
+	return x;
+}
+
+static u32 union_find_merge(u32* parents, u8* ranks, u32 a, u32 b)
+{
+	a = union_find_root(parents, a);
+	b = union_find_root(parents, b);
+	if (a == b) {
+		return a;
+	}
+	if (ranks[a] < ranks[b]) {
+		u32 tmp = a;
+		a = b;
+		b = tmp;
+	}
+	parents[b] = a;
+	if (ranks[a] == ranks[b]) {
+		++ranks[a];
+	}
+	return a;
+}
+
+// Labels the floor cells inside the room's border, 4-connected.
+static void find_connected_components(Connected_Components* cc, Map_Cache_Bool* map, v2_u32 size)
+{
+	u32 num_cells = size.w * size.h;
+	connected_components_reserve(cc, num_cells);
+	cc->size = size;
+	cc->num_components = 0;
+
+	u32 *labels = cc->labels;
+	u32 *parents = cc->parents;
+	u8 *ranks = cc->ranks;
+	memset(labels, 0, num_cells * sizeof(labels[0]));
+
+	// first pass -- provisional labels, merging where left and above meet.
+	// Label 0 is walls so provisional labels start at 1.
+	u32 num_labels = 1;
 	for (u32 y = 1; y < size.h - 1; ++y) {
 		for (u32 x = 1; x < size.w - 1; ++x) {
-			Pos p = Pos(x, y);
-			if (map->get(p)) {
+			if (map->get(Pos(x, y))) {
 				continue;
 			}
-			u32 this_component = 0;
-			u32 left_component = component_map[p - Pos(1, 0)];
-			u32 above_component = component_map[p - Pos(0, 1)];
-			if (!left_component && !above_component) {
-				this_component = ++num_components;
-				component_keys[this_component] = this_component;
-			} else if (!left_component) {
-				this_component = above_component;
-			} else if (!above_component) {
-				this_component = left_component;
-			} else if (left_component == above_component) {
-				this_component = left_component;
-			} else if (left_component < above_component) {
-				this_component = left_component;
-				component_keys[above_component] = left_component;
+			u32 idx = y * size.w + x;
+			u32 left = labels[idx - 1];
+			u32 above = labels[idx - size.w];
+			u32 label;
+			if (left && above) {
+				label = left == above ? left : union_find_merge(parents, ranks, left, above);
+			} else if (left || above) {
+				label = left | above;
 			} else {
-				this_component = above_component;
-				component_keys[left_component] = above_component;
+				label = num_labels++;
+				parents[label] = label;
+				ranks[label] = 0;
+				cc->root_components[label] = 0;
 			}
-			component_map[p] = this_component;
-			++component_counts[this_component];
+			labels[idx] = label;
 		}
 	}
 
-	u32 best_count = 0;
-	u32 best_key = 0;
-	for (u32 i = 1; i <= num_components; ++i) {
-		u32 count = component_counts[i];
-		u32 key = i;
-		while (component_keys[key] != key) {
-			key = component_keys[key];
-		}
-		if (key != i) {
-			component_keys[i] = key;
-			component_counts[key] += count;
+	// second pass -- resolve to roots and number the roots in scan order
+	for (u32 y = 1; y < size.h - 1; ++y) {
+		for (u32 x = 1; x < size.w - 1; ++x) {
+			u32 idx = y * size.w + x;
+			u32 label = labels[idx];
+			if (!label) {
+				continue;
+			}
+			u32 root = union_find_root(parents, label);
+			u32 component = cc->root_components[root];
+			if (!component) {
+				Connected_Component *c = &cc->components[cc->num_components++];
+				c->area = 0;
+				c->min = v2_u32(x, y);
+				c->max = v2_u32(x, y);
+				component = cc->num_components;
+				cc->root_components[root] = component;
+			}
+			labels[idx] = component;
+
+			Connected_Component *c = &cc->components[component - 1];
+			++c->area;
+			c->min = jfg_min(c->min, v2_u32(x, y));
+			c->max = jfg_max(c->max, v2_u32(x, y));
 		}
-		count = component_counts[key];
-		if (count > best_count) {
-			best_count = count;
-			best_key = key;
+	}
+}
+
+// Fills in every floor cell not in the biggest component -- the first found on
+// a tie. Returns the biggest component, or an empty one if there's no floor.
+static Connected_Component biggest_connected_component(Connected_Components* cc,
+                                                       Map_Cache_Bool*       map,
+                                                       v2_u32                size)
+{
+	find_connected_components(cc, map, size);
+
+	Connected_Component result = {};
+	u32 best = 0;
+	for (u32 i = 0; i < cc->num_components; ++i) {
+		if (cc->components[i].area > result.area) {
+			result = cc->components[i];
+			best = i + 1;
 		}
 	}
 
 	for (u32 y = 1; y < size.h - 1; ++y) {
 		for (u32 x = 1; x < size.w - 1; ++x) {
-			Pos p = Pos(x, y);
-			if (component_keys[component_map[p]] != best_key) {
-				map->set(p);
+			u32 label = cc->labels[y * size.w + x];
+			if (label && label != best) {
+				map->set(Pos(x, y));
 			}
 		}
 	}
+
+	return result;
 }
 
-static void cellular_automata(Map_Cache_Bool* map, v2_u32* out_size, f32 wall_chance, u32 remain_wall_count, u32 become_wall_count, u32 num_iters, f32 minimum_area, u32 max_attempts)
+// Map_Cache_Bool rows are 256 bits -- 4 u64s with x = 0 in the lowest bit
+#define ROW_WORDS (256 / 64)
+
+// sets the bits for x in [x_begin, x_end)
+static void row_mask(u64* mask, u32 x_begin, u32 x_end)
 {
-	v2_u32 size = *out_size;
-
-	f32 area = 0.0f;
-	f32 best_area = 0.0f;
-	Map_Cache_Bool best_map = {};
-	log("================================================================================");
-	do {
-		Map_Cache_Bool tmp1 = {};
-		Map_Cache_Bool tmp2 = {};
-		Map_Cache_Bool *front = &tmp1;
-		Map_Cache_Bool *back = &tmp2;
-		front->reset();
-		back->reset();
-		for (u32 x = 0; x < size.w; ++x) {
-			front->set(Pos(x,          0));
-			front->set(Pos(x, size.h - 1));
-		}
-		for (u32 y = 0; y < size.h; ++y) {
-			front->set(Pos(         0, y));
-			front->set(Pos(size.w - 1, y));
+	for (u32 i = 0; i < ROW_WORDS; ++i) {
+		u32 begin = (u32)jfg_max((i32)x_begin - (i32)(i * 64), 0);
+		u32 end = (u32)jfg_max((i32)x_end - (i32)(i * 64), 0);
+		end = min_u32(end, 64);
+		u64 below_end = end == 64 ? ~(u64)0 : ((u64)1 << end) - 1;
+		u64 below_begin = begin >= 64 ? ~(u64)0 : ((u64)1 << begin) - 1;
+		mask[i] = below_end & ~below_begin;
+	}
+}
+
+// whole row shifted so each bit holds its x - 1 (west) or x + 1 (east) neighbour
+static inline u64 row_west(u64* row, u32 i)
+{
+	return (row[i] << 1) | (i ? row[i - 1] >> 63 : 0);
+}
+
+static inline u64 row_east(u64* row, u32 i)
+{
+	return (row[i] >> 1) | (i + 1 < ROW_WORDS ? row[i + 1] << 63 : 0);
+}
+
+// Bit sliced adders -- each bit position is a separate lane
+static inline void full_add(u64 a, u64 b, u64 c, u64* sum, u64* carry)
+{
+	u64 a_xor_b = a ^ b;
+	*sum = a_xor_b ^ c;
+	*carry = (a & b) | (c & a_xor_b);
+}
+
+static inline void half_add(u64 a, u64 b, u64* sum, u64* carry)
+{
+	*sum = a ^ b;
+	*carry = a & b;
+}
+
+// count (as 4 bit slices, lowest first) >= n, per lane
+static inline u64 count_at_least(u64* count, u32 n)
+{
+	if (n > 8) {
+		return 0;
+	}
+	u64 greater = 0;
+	u64 equal = ~(u64)0;
+	for (u32 b = 4; b--; ) {
+		if (n & (1 << b)) {
+			equal &= count[b];
+		} else {
+			greater |= equal & count[b];
+			equal &= ~count[b];
 		}
+	}
+	return greater | equal;
+}
 
-		for (u32 y = 1; y < size.h - 1; ++y) {
-			for (u32 x = 1; x < size.w - 1; ++x) {
-				if (rand_f32() > wall_chance) {
-					front->set(Pos(x, y));
-				}
+// One step of the automata for the cells inside the border of a size map, 64 cells
+// at a time. A wall stays a wall with at least remain_wall_count wall
+// neighbours and a floor becomes a wall with at least become_wall_count.
+static void cellular_automata_step(Map_Cache_Bool* front, Map_Cache_Bool* back, v2_u32 size,
+                                   u32 remain_wall_count, u32 become_wall_count)
+{
+	u64 interior[ROW_WORDS];
+	row_mask(interior, 1, size.w - 1);
+
+	for (u32 y = 1; y < size.h - 1; ++y) {
+		u64 *above = &front->items[(y - 1) * ROW_WORDS];
+		u64 *row   = &front->items[      y * ROW_WORDS];
+		u64 *below = &front->items[(y + 1) * ROW_WORDS];
+		u64 *out   = &back->items[       y * ROW_WORDS];
+		for (u32 i = 0; i < ROW_WORDS; ++i) {
+			if (!interior[i]) {
+				continue;
 			}
+			u64 s_0, s_1, s_2, c_0, c_1, c_2, c_3;
+			full_add(row_west(above, i), above[i], row_east(above, i), &s_0, &c_0);
+			full_add(row_west(below, i), below[i], row_east(below, i), &s_1, &c_1);
+			half_add(row_west(row, i), row_east(row, i), &s_2, &c_2);
+
+			u64 count[4], c_4, c_5;
+			full_add(s_0, s_1, s_2, &count[0], &c_3);
+			full_add(c_0, c_1, c_2, &s_0, &c_4);
+			half_add(s_0, c_3, &count[1], &c_5);
+			count[2] = c_4 ^ c_5;
+			count[3] = c_4 & c_5;
+
+			u64 cur = row[i];
+			u64 next = (cur & count_at_least(count, remain_wall_count))
+			         | (~cur & count_at_least(count, become_wall_count));
+			out[i] = (next & interior[i]) | (cur & ~interior[i]);
 		}
+	}
+}
 
-		memcpy(back, front, sizeof(*back));
-
-		for (u32 i = 0; i < num_iters; ++i) {
-			log("--------------------------------------------------------------------------------");
-			log_map(front, size);
-			for (u32 y = 1; y < size.h - 1; ++y) {
-				for (u32 x = 1; x < size.w - 1; ++x) {
-					u32 wall_count = 0;
-					if (front->get(Pos(x - 1, y - 1))) { ++wall_count; }
-					if (front->get(Pos(    x, y - 1))) { ++wall_count; }
-					if (front->get(Pos(x + 1, y - 1))) { ++wall_count; }
-					if (front->get(Pos(x - 1,     y))) { ++wall_count; }
-					if (front->get(Pos(x + 1,     y))) { ++wall_count; }
-					if (front->get(Pos(x - 1, y + 1))) { ++wall_count; }
-					if (front->get(Pos(    x, y + 1))) { ++wall_count; }
-					if (front->get(Pos(x + 1, y + 1))) { ++wall_count; }
-
-					if (front->get(Pos(x, y))) {
-						if (wall_count < remain_wall_count) {
-							back->unset(Pos(x, y));
-						} else {
-							back->set(Pos(x, y));
-						}
-					} else {
-						if (wall_count >= become_wall_count) {
-							back->set(Pos(x, y));
-						} else {
-							back->unset(Pos(x, y));
-						}
-					}
-				}
+struct Cellular_Automata_Params
+{
+	v2_u32 size;
+	f32    wall_chance;
+	u32    remain_wall_count;
+	u32    become_wall_count;
+	u32    num_iters;
+};
+
+// Each attempt gets its own MT19937 stream seeded from the level's seed and
+// the attempt index, so an attempt's map doesn't depend on which thread ran it
+// or what ran before it.
+static u32 cellular_automata_attempt_seed(u32 seed, u32 attempt)
+{
+	u32 x = seed + attempt * 0x9E3779B9;
+	x ^= x >> 16;
+	x *= 0x85EBCA6B;
+	x ^= x >> 13;
+	x *= 0xC2B2AE35;
+	x ^= x >> 16;
+	return x;
+}
+
+struct Cellular_Automata_Scratch
+{
+	Map_Cache_Bool       front;
+	Map_Cache_Bool       back;
+	Connected_Components components;
+};
+
+// Kept per thread between runs -- far too big for the stack, and attempts run
+// on the work queue's threads.
+static thread_local Cellular_Automata_Scratch *cellular_automata_scratch = NULL;
+
+static Cellular_Automata_Scratch* get_cellular_automata_scratch()
+{
+	if (!cellular_automata_scratch) {
+		cellular_automata_scratch = (Cellular_Automata_Scratch*)calloc(1, sizeof(Cellular_Automata_Scratch));
+	}
+	return cellular_automata_scratch;
+}
+
+// Fills map with one attempt and returns its floor area. Traces each step to l,
+// which may be NULL.
+static f32 cellular_automata_attempt(Cellular_Automata_Params*  params,
+                                     u32                        seed,
+                                     u32                        attempt,
+                                     Map_Cache_Bool*            front,
+                                     Cellular_Automata_Scratch* scratch,
+                                     Log*                       l)
+{
+	Map_Cache_Bool *back = &scratch->back;
+	v2_u32 size = params->size;
+
+	MT19937 rng;
+	rng.seed(cellular_automata_attempt_seed(seed, attempt));
+
+	front->reset();
+	back->reset();
+	for (u32 x = 0; x < size.w; ++x) {
+		front->set(Pos(x,          0));
+		front->set(Pos(x, size.h - 1));
+	}
+	for (u32 y = 0; y < size.h; ++y) {
+		front->set(Pos(         0, y));
+		front->set(Pos(size.w - 1, y));
+	}
+
+	f32 row_rand[256];
+	for (u32 y = 1; y < size.h - 1; ++y) {
+		rng.rand_fill_f32(row_rand, size.w - 2);
+		for (u32 x = 1; x < size.w - 1; ++x) {
+			if (row_rand[x - 1] > params->wall_chance) {
+				front->set(Pos(x, y));
 			}
-			auto tmp = front;
-			front = back;
-			back = tmp;
 		}
-		log("--------------------------------------------------------------------------------");
-		log_map(front, size);
+	}
 
-		biggest_connected_component(front, size);
+	memcpy(back, front, sizeof(*back));
 
-		f32 num_floors = 0.0f;
+	for (u32 i = 0; i < params->num_iters; ++i) {
+		LOG(l, level_gen, LOG_LEVEL_TRACE, "--------------------------------------------------------------------------------");
+		LOG_MAP(l, level_gen, LOG_LEVEL_TRACE, front, size);
+		cellular_automata_step(front, back, size, params->remain_wall_count, params->become_wall_count);
+		// results always end up in front
 		for (u32 y = 1; y < size.h - 1; ++y) {
-			for (u32 x = 1; x < size.w - 1; ++x) {
-				if (!front->get(Pos(x, y))) {
-					++num_floors;
+			memcpy(&front->items[y * ROW_WORDS], &back->items[y * ROW_WORDS], ROW_WORDS * sizeof(u64));
+		}
+	}
+	LOG(l, level_gen, LOG_LEVEL_TRACE, "--------------------------------------------------------------------------------");
+	LOG_MAP(l, level_gen, LOG_LEVEL_TRACE, front, size);
+
+	Connected_Component cave = biggest_connected_component(&scratch->components, front, size);
+	return (f32)cave.area / (f32)(size.w * size.h);
+}
+
+#define CELLULAR_AUTOMATA_MAX_ATTEMPTS 64
+
+// Attempts are handed out in index order. Once one reaches the minimum area
+// nothing after it is started, so the lowest passing attempt is always found
+// with everything before it finished -- the same answer as running them in
+// order on one thread.
+//
+// Each attempt that beats the one whose map is in result copies its map over
+// it, under result_lock when more than one thread runs, so result ends up
+// holding the chosen attempt without running it again.
+struct Cellular_Automata_Jobs
+{
+	Cellular_Automata_Params params;
+	u32                      seed;
+	u32                      num_attempts;
+	f32                      minimum_area;
+	u32 volatile             next_attempt;
+	u32 volatile             first_passed;
+	f32                      areas[CELLULAR_AUTOMATA_MAX_ATTEMPTS];
+	Map_Cache_Bool          *result;
+	Semaphore               *result_lock;
+	u32                      result_attempt;
+	f32                      result_area;
+};
+
+// the first attempt to pass, otherwise the first with the biggest area
+static u8 cellular_automata_attempt_is_better(Cellular_Automata_Jobs* jobs, u32 attempt, f32 area)
+{
+	if (jobs->result_attempt == jobs->num_attempts) {
+		return 1;
+	}
+	u8 passed = area >= jobs->minimum_area;
+	u8 result_passed = jobs->result_area >= jobs->minimum_area;
+	if (passed != result_passed) {
+		return passed;
+	}
+	if (!passed && area != jobs->result_area) {
+		return area > jobs->result_area;
+	}
+	return attempt < jobs->result_attempt;
+}
+
+static void cellular_automata_worker(void* uncast_jobs)
+{
+	Cellular_Automata_Jobs *jobs = (Cellular_Automata_Jobs*)uncast_jobs;
+
+	Cellular_Automata_Scratch *scratch = get_cellular_automata_scratch();
+	for (;;) {
+		u32 attempt = interlocked_increment(&jobs->next_attempt) - 1;
+		if (attempt >= jobs->num_attempts || attempt > jobs->first_passed) {
+			break;
+		}
+		// not traced -- which thread runs which attempt varies from run to run
+		f32 area = cellular_automata_attempt(&jobs->params, jobs->seed, attempt, &scratch->front, scratch, NULL);
+		jobs->areas[attempt] = area;
+		if (area >= jobs->minimum_area) {
+			u32 first_passed = jobs->first_passed;
+			while (attempt < first_passed) {
+				u32 prev = interlocked_compare_exchange(&jobs->first_passed, attempt, first_passed);
+				if (prev == first_passed) {
+					break;
 				}
+				first_passed = prev;
 			}
 		}
-		area = num_floors / (f32)(size.w * size.h);
-		logf("attempt %u, area=%f, min_area=%f", max_attempts, area, minimum_area);
-		if (area > best_area) {
-			best_area = area;
-			memcpy(&best_map, front, sizeof(best_map));
+
+		if (jobs->result_lock) {
+			wait_semaphore(jobs->result_lock);
+		}
+		if (cellular_automata_attempt_is_better(jobs, attempt, area)) {
+			memcpy(jobs->result, &scratch->front, sizeof(*jobs->result));
+			jobs->result_attempt = attempt;
+			jobs->result_area = area;
+		}
+		if (jobs->result_lock) {
+			signal_semaphore(jobs->result_lock);
+		}
+	}
+}
+
+static void cellular_automata(Map_Cache_Bool* map, v2_u32* out_size, f32 wall_chance, u32 remain_wall_count, u32 become_wall_count, u32 num_iters, f32 minimum_area, u32 max_attempts)
+{
+	ASSERT(max_attempts && max_attempts <= CELLULAR_AUTOMATA_MAX_ATTEMPTS);
+
+	Cellular_Automata_Jobs jobs = {};
+	jobs.params.size              = *out_size;
+	jobs.params.wall_chance       = wall_chance;
+	jobs.params.remain_wall_count = remain_wall_count;
+	jobs.params.become_wall_count = become_wall_count;
+	jobs.params.num_iters         = num_iters;
+	jobs.seed                     = rand_u32();
+	jobs.num_attempts             = max_attempts;
+	jobs.minimum_area             = minimum_area;
+	jobs.first_passed             = max_attempts;
+	jobs.result                   = map;
+	jobs.result_attempt           = max_attempts;
+
+	// this thread works too, and picks up any helpers no worker got to
+	if (work_queue) {
+		u32 num_helpers = min_u32(work_queue->num_workers, max_attempts - 1);
+		jobs.result_lock = create_semaphore(1);
+		Work_Group group;
+		work_group_init(&group);
+		for (u32 i = 0; i < num_helpers; ++i) {
+			work_queue_add(work_queue, &group, cellular_automata_worker, &jobs);
+		}
+		cellular_automata_worker(&jobs);
+		work_group_wait(work_queue, &group);
+		work_group_free(&group);
+		free_semaphore(jobs.result_lock);
+	} else {
+		cellular_automata_worker(&jobs);
+	}
+
+	u32 best = jobs.result_attempt;
+	ASSERT(best == jobs.first_passed || jobs.first_passed == max_attempts);
+
+	LOG(thread_log, level_gen, LOG_LEVEL_DEBUG, "================================================================================");
+	u32 num_run = jobs.first_passed == max_attempts ? max_attempts : jobs.first_passed + 1;
+	for (u32 i = 0; i < num_run; ++i) {
+		LOGF(thread_log, level_gen, LOG_LEVEL_DEBUG, "attempt %u, area=%f, min_area=%f", i, jobs.areas[i], minimum_area);
+	}
+	if (thread_stats) {
+		++thread_stats->cellular_automata_runs;
+		thread_stats->cellular_automata_attempts += num_run;
+		if (jobs.first_passed == max_attempts) {
+			++thread_stats->cellular_automata_failures;
 		}
-	} while (area < minimum_area && --max_attempts);
+	}
 
-	memcpy(map, &best_map, sizeof(*map));
+	// attempts aren't traced as they run, so run the chosen one again for its maps
+	if (LOG_ENABLED(level_gen, LOG_LEVEL_TRACE) && thread_log) {
+		f32 area = cellular_automata_attempt(&jobs.params, jobs.seed, best, map, get_cellular_automata_scratch(), thread_log);
+		ASSERT(area == jobs.areas[best]);
+		(void)area; // only read by the ASSERT
+	}
 
 	move_to_top_left(map, out_size);
 }
@@ -315,30 +644,156 @@ struct Room
 	Max_Length_Array<Item, ROOM_MAX_ITEMS> items;
 };
 
-static Pos random_floor_pos(Room* room)
+// =============================================================================
+// item placement
+//
+// The floor tiles still free for items that take up a tile, kept as a list so a
+// random one is picked and removed in O(1) -- the last tile moves into the
+// picked one's slot. free marks the tiles in the list and slots says where each
+// one is, so a particular tile can be taken too.
+//
+// Picks can also keep items min_spacing apart, Poisson disk style. The front of
+// the list is the candidates for spaced picks; a tile found too close to a
+// spaced item moves behind them for good, since spaced items are never removed.
+// Spaced items go in a grid of cells too small to hold two, so the check looks
+// at a fixed block of cells around the tile. Each tile is rejected once at
+// most, so placing any number of items is linear in the room's area.
+
+#define PLACEMENT_MAX_TILES (256 * 256)
+
+struct Placement
 {
-	Pos result = {};
-	u32 floor_tiles_seen = 0;
-	for (u32 y = 0; y < room->size.h; ++y) {
-		for (u32 x = 0; x < room->size.w; ++x) {
+	u32            num_free;
+	u32            num_candidates; // free_tiles[0, num_candidates) for spaced picks
+	u16            free_tiles[PLACEMENT_MAX_TILES];
+	u16            slots[PLACEMENT_MAX_TILES]; // index in free_tiles, by tile
+	Map_Cache_Bool free;
+
+	u32            min_spacing;
+	u32            cell_size;
+	u32            cell_reach; // cells either side that can hold an item too close
+	v2_u32         grid_size;
+	u32            grid[PLACEMENT_MAX_TILES]; // the cell's spaced item's tile + 1, or 0
+};
+
+static void init(Placement* placement, Map_Cache<Tile>* tiles, v2_u32 size, u32 min_spacing)
+{
+	placement->num_free = 0;
+	placement->free.reset();
+	for (u32 y = 0; y < size.h; ++y) {
+		for (u32 x = 0; x < size.w; ++x) {
 			Pos p = Pos(x, y);
-			if (room->tiles[p].type == TILE_FLOOR) {
-				for (u32 i = 0; i < room->items.len; ++i) {
-					if (room->items[i].pos == p && room->items[i].type & ITEM_TAKES_UP_TILE) {
-						goto next_tile;
-					}
-				}
-				if (rand_u32() % ++floor_tiles_seen == 0) {
-					result = p;
-				}
+			if ((*tiles)[p].type == TILE_FLOOR) {
+				u16 tile = pos_to_u16(p);
+				placement->slots[tile] = placement->num_free;
+				placement->free_tiles[placement->num_free++] = tile;
+				placement->free.set(p);
 			}
-		next_tile: ;
 		}
 	}
+	placement->num_candidates = placement->num_free;
+
+	// two tiles in a cell are at most (cell_size - 1) * sqrt(2) apart
+	placement->min_spacing = min_spacing;
+	placement->cell_size = max_u32(1, (u32)((f32)min_spacing / 1.41421356f));
+	placement->cell_reach = (min_spacing + placement->cell_size - 1) / placement->cell_size;
+	placement->grid_size = (size + v2_u32(placement->cell_size - 1, placement->cell_size - 1))
+	                     / placement->cell_size;
+	memset(placement->grid, 0, placement->grid_size.w * placement->grid_size.h * sizeof(u32));
+}
+
+static void swap_free_tiles(Placement* placement, u32 a, u32 b)
+{
+	u16 tile_a = placement->free_tiles[a];
+	u16 tile_b = placement->free_tiles[b];
+	placement->free_tiles[a] = tile_b;
+	placement->slots[tile_b] = a;
+	placement->free_tiles[b] = tile_a;
+	placement->slots[tile_a] = b;
+}
+
+static void remove_free_tile(Placement* placement, u32 slot)
+{
+	if (slot < placement->num_candidates) {
+		swap_free_tiles(placement, slot, --placement->num_candidates);
+		slot = placement->num_candidates;
+	}
+	swap_free_tiles(placement, slot, --placement->num_free);
+	placement->free.unset(u16_to_pos(placement->free_tiles[placement->num_free]));
+}
+
+static Pos take_free_tile(Placement* placement)
+{
+	ASSERT(placement->num_free);
+	u32 slot = rand_u32() % placement->num_free;
+	Pos result = u16_to_pos(placement->free_tiles[slot]);
+	remove_free_tile(placement, slot);
 	return result;
 }
 
-static void make_spider_room(Room* room)
+static void take_tile(Placement* placement, Pos p)
+{
+	if (placement->free.get(p)) {
+		remove_free_tile(placement, placement->slots[pos_to_u16(p)]);
+	}
+}
+
+static u8 is_spaced(Placement* placement, Pos p)
+{
+	i32 cell_x = p.x / placement->cell_size;
+	i32 cell_y = p.y / placement->cell_size;
+	i32 reach = (i32)placement->cell_reach;
+	i32 min_spacing = (i32)placement->min_spacing;
+	i32 y_end = min_i32(cell_y + reach, (i32)placement->grid_size.h - 1);
+	i32 x_end = min_i32(cell_x + reach, (i32)placement->grid_size.w - 1);
+	for (i32 y = max_i32(cell_y - reach, 0); y <= y_end; ++y) {
+		for (i32 x = max_i32(cell_x - reach, 0); x <= x_end; ++x) {
+			u32 item = placement->grid[y * placement->grid_size.w + x];
+			if (!item) {
+				continue;
+			}
+			v2_i32 d = (v2_i32)u16_to_pos(item - 1) - (v2_i32)p;
+			if (d.x*d.x + d.y*d.y < min_spacing*min_spacing) {
+				return 0;
+			}
+		}
+	}
+	return 1;
+}
+
+// Falls back to any free tile once nowhere is far enough from the other spaced
+// items.
+static Pos take_spaced_free_tile(Placement* placement)
+{
+	while (placement->num_candidates) {
+		u32 slot = rand_u32() % placement->num_candidates;
+		Pos p = u16_to_pos(placement->free_tiles[slot]);
+		if (is_spaced(placement, p)) {
+			remove_free_tile(placement, slot);
+			u32 cell = (p.y / placement->cell_size) * placement->grid_size.w + p.x / placement->cell_size;
+			ASSERT(!placement->grid[cell]);
+			placement->grid[cell] = pos_to_u16(p) + 1;
+			return p;
+		}
+		swap_free_tiles(placement, slot, --placement->num_candidates);
+	}
+	return take_free_tile(placement);
+}
+
+// Items placed at a tile of the caller's choosing take it too, if they need it
+// to themselves.
+static void add_item(Room* room, Placement* placement, Item item)
+{
+	room->items.append(item);
+	if (item.type & ITEM_TAKES_UP_TILE) {
+		take_tile(placement, item.pos);
+	}
+}
+
+// spiders and the player
+#define SPIDER_ROOM_SPACING 4
+
+static void make_spider_room(Room* room, Placement* placement)
 {
 	Map_Cache_Bool map = {};
 	cellular_automata(&map, &room->size, 0.5f, 4, 5, 4, 0.4f, 20);
@@ -360,6 +815,7 @@ static void make_spider_room(Room* room)
 			room->tiles[p] = t;
 		}
 	}
+	init(placement, &room->tiles, room->size, SPIDER_ROOM_SPACING);
 
 	for (u32 y = 1; y < room->size.h - 1; ++y) {
 		for (u32 x = 1; x < room->size.w - 1; ++x) {
@@ -383,7 +839,7 @@ static void make_spider_room(Room* room)
 			f32 chance = wall_count >= 2 ? corner_web_chance : centre_web_chance;
 
 			if (rand_f32() < chance) {
-				room->items.append(web);
+				add_item(room, placement, web);
 			}
 		}
 	}
@@ -391,23 +847,23 @@ static void make_spider_room(Room* room)
 	Item spider = {};
 
 	spider.type = ITEM_SPIDER_NORMAL;
-	spider.pos = random_floor_pos(room);
-	room->items.append(spider);
+	spider.pos = take_spaced_free_tile(placement);
+	add_item(room, placement, spider);
 
-	spider.pos = random_floor_pos(room);
-	room->items.append(spider);
+	spider.pos = take_spaced_free_tile(placement);
+	add_item(room, placement, spider);
 
 	spider.type = ITEM_SPIDER_WEB;
-	spider.pos = random_floor_pos(room);
-	room->items.append(spider);
+	spider.pos = take_spaced_free_tile(placement);
+	add_item(room, placement, spider);
 
 	spider.type = ITEM_SPIDER_POISON;
-	spider.pos = random_floor_pos(room);
-	room->items.append(spider);
+	spider.pos = take_spaced_free_tile(placement);
+	add_item(room, placement, spider);
 
 	spider.type = ITEM_SPIDER_SHADOW;
-	spider.pos = random_floor_pos(room);
-	room->items.append(spider);
+	spider.pos = take_spaced_free_tile(placement);
+	add_item(room, placement, spider);
 
 	Pos center = (Pos)(room->size / (u32)2);
 	u32 radius = min_u32(room->size.w, room->size.h);
@@ -416,7 +872,7 @@ static void make_spider_room(Room* room)
 	trap.type = ITEM_SPIDER_TRAP;
 	trap.pos = center;
 	trap.spider_trap.radius = radius;
-	room->items.append(trap);
+	add_item(room, placement, trap);
 }
 
 static void draw_room(Game* game, Room* room, v2_u32 offset)
@@ -462,23 +918,10 @@ static void draw_room(Game* game, Room* room, v2_u32 offset)
 	}
 }
 
-static void random_place_player(Game* game)
+static void random_place_player(Game* game, Placement* placement, v2_u32 offset)
 {
-	u32 floors_seen = 0;
-	Pos player_pos;
-	for (u32 y = 0; y < 256; ++y) {
-		for (u32 x = 0; x < 256; ++x) {
-			Pos p = Pos(x, y);
-			if (game->tiles[p].type == TILE_FLOOR) {
-				if (rand_u32() % ++floors_seen == 0) {
-					player_pos = p;
-				}
-			}
-		}
-	}
-
 	auto p = get_player(game);
-	p->pos = player_pos;
+	p->pos = take_spaced_free_tile(placement) + (Pos)offset;
 }
 
 void build_level_spider_room(Game* game, Log* l)
@@ -487,18 +930,22 @@ void build_level_spider_room(Game* game, Log* l)
 
 	init(game);
 
+	// far too big for the stack
+	Placement *placement = (Placement*)malloc(sizeof(Placement));
+
 	Room room = {};
 	room.size = v2_u32(20, 20);
-	make_spider_room(&room);
+	make_spider_room(&room, placement);
 
 	draw_room(game, &room, v2_u32(10, 10));
 	remove_internal_walls(&game->tiles);
-	random_place_player(game);
+	random_place_player(game, placement, v2_u32(10, 10));
+	free(placement);
 
 	update_fov(game);
 }
 
-static void from_string(Game* game, char* str)
+static void from_string(Game* game, const char* str)
 {
 	init(game);
 
@@ -506,11 +953,11 @@ static void from_string(Game* game, char* str)
 
 	auto& tiles = game->tiles;
 
-	Controller lich_controller_tmp = {};
-	lich_controller_tmp.type = CONTROLLER_LICH;
-	Controller *lich_controller = &lich_controller_tmp;
+	// skeletons before the lich in the source are held here until it's added
+	Lich_Controller lich_controller_tmp = {};
+	Lich_Controller *lich_controller = &lich_controller_tmp;
 
-	for (char *p = str; *p; ++p) {
+	for (const char *p = str; *p; ++p) {
 		switch (*p) {
 		case '\n':
 			cur_pos.x = 1;
@@ -551,23 +998,23 @@ static void from_string(Game* game, char* str)
 			tiles[cur_pos].appearance = APPEARANCE_FLOOR_ROCK;
 
 			auto e = add_entity(game);
-			e->hit_points = 10;
-			e->max_hit_points = 10;
+			auto info = get_entity_info(game, e);
+			info->hit_points = 10;
+			info->max_hit_points = 10;
 			e->pos = cur_pos;
-			e->appearance = APPEARANCE_CREATURE_NECROMANCER;
+			info->appearance = APPEARANCE_CREATURE_NECROMANCER;
 			e->block_mask = BLOCK_WALK | BLOCK_SWIM | BLOCK_FLY;
 			e->movement_type = BLOCK_WALK;
-			e->default_action = ACTION_BUMP_ATTACK;
+			info->default_action = ACTION_BUMP_ATTACK;
 
-			lich_controller = add_controller(game);
+			lich_controller = add_lich_controller(game);
 			memcpy(lich_controller, &lich_controller_tmp, sizeof(lich_controller_tmp));
-			lich_controller->lich.lich_id = e->id;
+			lich_controller->lich_id = e->id;
 
 			auto mh = add_message_handler(game);
 			mh->type = MESSAGE_HANDLER_LICH_DEATH;
 			mh->handle_mask = MESSAGE_PRE_DEATH;
 			mh->owner_id = e->id;
-			mh->lich_death.controller_id = lich_controller->id;
 
 			break;
 		}
@@ -576,15 +1023,16 @@ static void from_string(Game* game, char* str)
 			tiles[cur_pos].appearance = APPEARANCE_FLOOR_ROCK;
 
 			auto e = add_entity(game);
-			e->hit_points = 10;
-			e->max_hit_points = 10;
+			auto info = get_entity_info(game, e);
+			info->hit_points = 10;
+			info->max_hit_points = 10;
 			e->pos = cur_pos;
-			e->appearance = APPEARANCE_CREATURE_SKELETON;
+			info->appearance = APPEARANCE_CREATURE_SKELETON;
 			e->block_mask = BLOCK_WALK | BLOCK_SWIM | BLOCK_FLY;
 			e->movement_type = BLOCK_WALK;
-			e->default_action = ACTION_BUMP_ATTACK;
+			info->default_action = ACTION_BUMP_ATTACK;
 
-			lich_controller->lich.skeleton_ids.append(e->id);
+			lich_controller->skeleton_ids.append(e->id);
 			break;
 		}
 		case 'd': {
@@ -592,17 +1040,17 @@ static void from_string(Game* game, char* str)
 			tiles[cur_pos].appearance = APPEARANCE_FLOOR_ROCK;
 
 			auto e = add_entity(game);
-			e->hit_points = 100;
-			e->max_hit_points = 100;
+			auto info = get_entity_info(game, e);
+			info->hit_points = 100;
+			info->max_hit_points = 100;
 			e->pos = cur_pos;
-			e->appearance = APPEARANCE_CREATURE_RED_DRAGON;
+			info->appearance = APPEARANCE_CREATURE_RED_DRAGON;
 			e->block_mask = BLOCK_WALK | BLOCK_SWIM | BLOCK_FLY;
 			e->movement_type = BLOCK_WALK;
-			e->default_action = ACTION_BUMP_ATTACK;
+			info->default_action = ACTION_BUMP_ATTACK;
 
-			auto c = add_controller(game);
-			c->type = CONTROLLER_DRAGON;
-			c->dragon.entity_id = e->id;
+			auto c = add_dragon_controller(game);
+			c->entity_id = e->id;
 
 			break;
 		}
@@ -611,11 +1059,12 @@ static void from_string(Game* game, char* str)
 			tiles[cur_pos].appearance = APPEARANCE_FLOOR_ROCK;
 
 			auto e = add_entity(game);
-			e->hit_points = 1;
-			e->max_hit_points = 1;
+			auto info = get_entity_info(game, e);
+			info->hit_points = 1;
+			info->max_hit_points = 1;
 			e->pos = cur_pos;
-			e->appearance = APPEARANCE_ITEM_TRAP_HEX;
-			// e->default_action = ACTION_BUMP_ATTACK;
+			info->appearance = APPEARANCE_ITEM_TRAP_HEX;
+			// info->default_action = ACTION_BUMP_ATTACK;
 
 			auto mh = add_message_handler(game);
 			mh->type = MESSAGE_HANDLER_TRAP_FIREBALL;
@@ -650,17 +1099,17 @@ static void from_string(Game* game, char* str)
 			tiles[cur_pos].appearance = APPEARANCE_FLOOR_ROCK;
 
 			auto e = add_entity(game);
-			e->hit_points = 5;
-			e->max_hit_points = 5;
+			auto info = get_entity_info(game, e);
+			info->hit_points = 5;
+			info->max_hit_points = 5;
 			e->pos = cur_pos;
 			e->movement_type = BLOCK_FLY;
 			e->block_mask = BLOCK_WALK | BLOCK_SWIM | BLOCK_FLY;
-			e->appearance = APPEARANCE_CREATURE_RED_BAT;
-			e->default_action = ACTION_BUMP_ATTACK;
+			info->appearance = APPEARANCE_CREATURE_RED_BAT;
+			info->default_action = ACTION_BUMP_ATTACK;
 
-			auto c = add_controller(game);
-			c->type = CONTROLLER_RANDOM_MOVE;
-			c->random_move.entity_id = e->id;
+			auto c = add_random_move_controller(game);
+			c->entity_id = e->id;
 
 			break;
 		}
@@ -674,13 +1123,14 @@ static void from_string(Game* game, char* str)
 			tiles[cur_pos].appearance = APPEARANCE_FLOOR_ROCK;
 
 			auto e = add_entity(game);
-			e->hit_points = 5;
-			e->max_hit_points = 5;
+			auto info = get_entity_info(game, e);
+			info->hit_points = 5;
+			info->max_hit_points = 5;
 			e->pos = cur_pos;
 			e->block_mask = BLOCK_WALK | BLOCK_SWIM | BLOCK_FLY;
-			e->appearance = APPEARANCE_DOOR_WOODEN_PLAIN;
+			info->appearance = APPEARANCE_DOOR_WOODEN_PLAIN;
 			e->flags = ENTITY_FLAG_BLOCKS_VISION;
-			e->default_action = ACTION_OPEN_DOOR;
+			info->default_action = ACTION_OPEN_DOOR;
 
 			break;
 		}
@@ -705,153 +1155,154 @@ static void from_string(Game* game, char* str)
 	update_fov(game);
 }
 
-void build_level_default(Game* game, Log* log)
-{
-	from_string(game,
-		"##########################################\n"
-		"#.........b...#b#..##....................#\n"
-		"#......#.bwb..#b#...............o........#\n"
-		"#.....###.b...#b#.......###...o....o.....#\n"
-		"#....#####....#b#.......#x#.....o.....o..#\n"
-		"#...##.#.##...#b#.....###x#.#......o.o...#\n"
-		"#..##..#..##..#b#.....#xxxxx#....o....o..#\n"
-		"#...b..#......#b#.....###x###.o....o.....#\n"
-		"#b.bwb.#......#w#.......#x#.....o..o..o..#\n"
-		"#wb.b..#...b..@.+.......###..............#\n"
-		"#b.....#..bwb.###........................#\n"
-		"#......#...b..#vvv.^..^....#.............#\n"
-		"#......#......#vvv.......................#\n"
-		"#~~~...#.....x#vvv.^...^.....#...........#\n"
-		"#~~~~..#.....x#vvv.......................#\n"
-		"#~~~~~~..xxxxx#............#...#.........#\n"
-		"##########x####..........................#\n"
-		"#.............#........#.................#\n"
-		"#.............#.......##.................#\n"
-		"#.............#......##.##...............#\n"
-		"#.............#.......##.................#\n"
-		"#.............#........#.................#\n"
-		"#.............+..........~~..............#\n"
-		"#.............#.........~~~~~............#\n"
-		"#.............#.........~...~~~..........#\n"
-		"#.............#.........~~.~~.~..........#\n"
-		"#.............#............~.~...........#\n"
-		"#.............#...........~~~~...........#\n"
-		"#.............#..........................#\n"
-		"#.............#..........................#\n"
-		"#.............#..........................#\n"
-		"#.............#..........................#\n"
-		"##########################################\n");
-}
-
-void build_level_imp_test(Game* game, Log* log)
-{
-	from_string(game,
-		"###############\n"
-		"#.............#\n"
-		"#.............#\n"
-		"#.............#\n"
-		"#.....i.......#\n"
-		"#.............#\n"
-		"#.............#\n"
-		"#.....@.......#\n"
-		"#.............#\n"
-		"#.............#\n"
-		"###############\n");
-}
-
-void build_level_anim_test(Game* game, Log* log)
-{
-	from_string(game,
-		"###########\n"
-		"#b#b#b#b#b#\n"
-		"#.#.#.#.#.#\n"
-		"#^#^#^#^#^#\n"
-		"#.#.#.#.#.#\n"
-		"#....@....#\n"
-		"###########\n");
-}
-
-void build_level_slime_test(Game* game, Log* log)
-{
-	from_string(game,
-		"##############################\n"
-		"#............................#\n"
-		"#............................#\n"
-		"#............................#\n"
-		"#............................#\n"
-		"#.............s..............#\n"
-		"#............................#\n"
-		"#........s........s..........#\n"
-		"#............................#\n"
-		"#............................#\n"
-		"#......s......@......s.......#\n"
-		"#............................#\n"
-		"#............................#\n"
-		"#........s.........s.........#\n"
-		"#.............s..............#\n"
-		"#............................#\n"
-		"#............................#\n"
-		"#............................#\n"
-		"#............................#\n"
-		"#............................#\n"
-		"#............................#\n"
-		"##############################\n");
-}
-
-void build_level_lich_test(Game* game, Log* log)
-{
-	from_string(game,
-		"##############################\n"
-		"#............................#\n"
-		"#............................#\n"
-		"#............................#\n"
-		"#............................#\n"
-		"#.............L..............#\n"
-		"#............................#\n"
-		"#........S........S..........#\n"
-		"#............................#\n"
-		"#............................#\n"
-		"#......S......@......S.......#\n"
-		"#............................#\n"
-		"#............................#\n"
-		"#........S.........S.........#\n"
-		"#.............S..............#\n"
-		"#............................#\n"
-		"#............................#\n"
-		"#............................#\n"
-		"#............................#\n"
-		"#............................#\n"
-		"#............................#\n"
-		"##############################\n");
-}
-
-void build_level_field_of_vision_test(Game* game, Log* log)
-{
-	from_string(game,
-		"##############################\n"
-		"#............................#\n"
-		"#............................#\n"
-		"#.................#.#.#......#\n"
-		"#............................#\n"
-		"#.............#...#...#...#..#\n"
-		"#............................#\n"
-		"#........#....#...#.#.#.#.#..#\n"
-		"#..................#.........#\n"
-		"#................#..#........#\n"
-		"#......#......@......#.......#\n"
-		"#............................#\n"
-		"#............................#\n"
-		"#........#.........#.........#\n"
-		"#.............#.....#..#.....#\n"
-		"#............................#\n"
-		"#................#...#.#.....#\n"
-		"#............................#\n"
-		"#................#..#........#\n"
-		"#............................#\n"
-		"#............................#\n"
-		"##############################\n");
+// Sources of the prebuilt levels. At runtime these are only parsed when
+// PREBUILT_LEVELS_FILE_NAME can't be used -- see prebuilt_level.h.
+
+static const char LEVEL_SOURCE_default[] =
+	"##########################################\n"
+	"#.........b...#b#..##....................#\n"
+	"#......#.bwb..#b#...............o........#\n"
+	"#.....###.b...#b#.......###...o....o.....#\n"
+	"#....#####....#b#.......#x#.....o.....o..#\n"
+	"#...##.#.##...#b#.....###x#.#......o.o...#\n"
+	"#..##..#..##..#b#.....#xxxxx#....o....o..#\n"
+	"#...b..#......#b#.....###x###.o....o.....#\n"
+	"#b.bwb.#......#w#.......#x#.....o..o..o..#\n"
+	"#wb.b..#...b..@.+.......###..............#\n"
+	"#b.....#..bwb.###........................#\n"
+	"#......#...b..#vvv.^..^....#.............#\n"
+	"#......#......#vvv.......................#\n"
+	"#~~~...#.....x#vvv.^...^.....#...........#\n"
+	"#~~~~..#.....x#vvv.......................#\n"
+	"#~~~~~~..xxxxx#............#...#.........#\n"
+	"##########x####..........................#\n"
+	"#.............#........#.................#\n"
+	"#.............#.......##.................#\n"
+	"#.............#......##.##...............#\n"
+	"#.............#.......##.................#\n"
+	"#.............#........#.................#\n"
+	"#.............+..........~~..............#\n"
+	"#.............#.........~~~~~............#\n"
+	"#.............#.........~...~~~..........#\n"
+	"#.............#.........~~.~~.~..........#\n"
+	"#.............#............~.~...........#\n"
+	"#.............#...........~~~~...........#\n"
+	"#.............#..........................#\n"
+	"#.............#..........................#\n"
+	"#.............#..........................#\n"
+	"#.............#..........................#\n"
+	"##########################################\n";
+
+static const char LEVEL_SOURCE_imp_test[] =
+	"###############\n"
+	"#.............#\n"
+	"#.............#\n"
+	"#.............#\n"
+	"#.....i.......#\n"
+	"#.............#\n"
+	"#.............#\n"
+	"#.....@.......#\n"
+	"#.............#\n"
+	"#.............#\n"
+	"###############\n";
+
+static const char LEVEL_SOURCE_anim_test[] =
+	"###########\n"
+	"#b#b#b#b#b#\n"
+	"#.#.#.#.#.#\n"
+	"#^#^#^#^#^#\n"
+	"#.#.#.#.#.#\n"
+	"#....@....#\n"
+	"###########\n";
+
+static const char LEVEL_SOURCE_slime_test[] =
+	"##############################\n"
+	"#............................#\n"
+	"#............................#\n"
+	"#............................#\n"
+	"#............................#\n"
+	"#.............s..............#\n"
+	"#............................#\n"
+	"#........s........s..........#\n"
+	"#............................#\n"
+	"#............................#\n"
+	"#......s......@......s.......#\n"
+	"#............................#\n"
+	"#............................#\n"
+	"#........s.........s.........#\n"
+	"#.............s..............#\n"
+	"#............................#\n"
+	"#............................#\n"
+	"#............................#\n"
+	"#............................#\n"
+	"#............................#\n"
+	"#............................#\n"
+	"##############################\n";
+
+static const char LEVEL_SOURCE_lich_test[] =
+	"##############################\n"
+	"#............................#\n"
+	"#............................#\n"
+	"#............................#\n"
+	"#............................#\n"
+	"#.............L..............#\n"
+	"#............................#\n"
+	"#........S........S..........#\n"
+	"#............................#\n"
+	"#............................#\n"
+	"#......S......@......S.......#\n"
+	"#............................#\n"
+	"#............................#\n"
+	"#........S.........S.........#\n"
+	"#.............S..............#\n"
+	"#............................#\n"
+	"#............................#\n"
+	"#............................#\n"
+	"#............................#\n"
+	"#............................#\n"
+	"#............................#\n"
+	"##############################\n";
+
+static const char LEVEL_SOURCE_field_of_vision_test[] =
+	"##############################\n"
+	"#............................#\n"
+	"#............................#\n"
+	"#.................#.#.#......#\n"
+	"#............................#\n"
+	"#.............#...#...#...#..#\n"
+	"#............................#\n"
+	"#........#....#...#.#.#.#.#..#\n"
+	"#..................#.........#\n"
+	"#................#..#........#\n"
+	"#......#......@......#.......#\n"
+	"#............................#\n"
+	"#............................#\n"
+	"#........#.........#.........#\n"
+	"#.............#.....#..#.....#\n"
+	"#............................#\n"
+	"#................#...#.#.....#\n"
+	"#............................#\n"
+	"#................#..#........#\n"
+	"#............................#\n"
+	"#............................#\n"
+	"##############################\n";
+
+static const char *LEVEL_SOURCES[] = {
+#define LEVEL(name) LEVEL_SOURCE_##name,
+	PREBUILT_LEVELS
+#undef LEVEL
+};
+
+void parse_prebuilt_level(Game* game, Prebuilt_Level_ID level_id)
+{
+	from_string(game, LEVEL_SOURCES[level_id]);
 }
 
+#define LEVEL(name) \
+	void build_level_##name(Game* game, Log* log) { load_prebuilt_level(game, PREBUILT_LEVEL_##name); }
+	PREBUILT_LEVELS
+#undef LEVEL
+
 // =============================================================================
 // XXX
 
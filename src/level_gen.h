@@ -4,6 +4,7 @@
 
 #include "log.h"
 #include "game.h"
+#include "work_queue.h"
 
 typedef void (*Build_Level_Function)(Game* game, Log* log);
 
@@ -36,4 +37,21 @@ struct Build_Level_Func_Metadata
 	Build_Level_Function func;
 };
 
-extern Build_Level_Func_Metadata BUILD_LEVEL_FUNCS[NUM_LEVEL_GEN_FUNCS];
\ No newline at end of file
+extern Build_Level_Func_Metadata BUILD_LEVEL_FUNCS[NUM_LEVEL_GEN_FUNCS];
+
+// Counters the build functions add to while stats are set for the calling
+// thread. Attempts only count up to the one that was picked, so they don't
+// depend on how many threads the cellular automata ran on.
+struct Level_Gen_Stats
+{
+	u32 cellular_automata_runs;
+	u32 cellular_automata_attempts;
+	u32 cellular_automata_failures; // runs where no attempt reached the minimum area
+};
+
+// NULL to stop counting
+void level_gen_set_thread_stats(Level_Gen_Stats* stats);
+
+// Cellular automata attempts are shared out over queue's workers. NULL, the
+// default, runs them all on the calling thread.
+void level_gen_set_work_queue(Work_Queue* queue);
\ No newline at end of file
@@ -0,0 +1,81 @@
+#pragma once
+
+// Shared by the headless level generation tools (level_gen_stats,
+// validate_seeds) -- running a build function without letting an ASSERT take
+// the whole run down, and looking generators up by name.
+
+#include "stdafx.h"
+
+// glibc's signal.h declares POSIX sleep(), which clashes with the platform one
+#define sleep posix_sleep
+#include <signal.h>
+#undef sleep
+
+#include "game.h"
+#include "level_gen.h"
+
+// -----------------------------------------------------------------------------
+// ASSERT catching -- ASSERT is assert() so a failing build raises SIGABRT on the
+// thread running it. Jump back out, count it and move on to the next seed. The
+// build's allocations leak but that doesn't matter here.
+
+#ifdef _WIN32
+typedef jmp_buf Harness_Jump_Buffer;
+#define harness_setjmp(buf)  setjmp(buf)
+#define harness_longjmp(buf) longjmp(buf, 1)
+#else
+typedef sigjmp_buf Harness_Jump_Buffer;
+#define harness_setjmp(buf)  sigsetjmp(buf, 1)
+#define harness_longjmp(buf) siglongjmp(buf, 1)
+#endif
+
+static thread_local Harness_Jump_Buffer *assert_jump = NULL;
+
+static void on_abort(int signal_number)
+{
+	// the CRT resets the handler before calling it
+	signal(SIGABRT, on_abort);
+	if (assert_jump) {
+		Harness_Jump_Buffer *jump = assert_jump;
+		assert_jump = NULL;
+		harness_longjmp(*jump);
+	}
+	signal(SIGABRT, SIG_DFL);
+	raise(signal_number);
+}
+
+// call once before any builds
+static void catch_asserts()
+{
+	signal(SIGABRT, on_abort);
+}
+
+// 0 if the build hit an ASSERT
+static u8 try_build_level(Build_Level_Function build, Game* game)
+{
+	Harness_Jump_Buffer jump;
+	if (harness_setjmp(jump)) {
+		return 0;
+	}
+	assert_jump = &jump;
+	build(game, NULL);
+	assert_jump = NULL;
+	return 1;
+}
+
+// -----------------------------------------------------------------------------
+// generators
+
+// names as in BUILD_LEVEL_FUNCS, with or without "build_level_"
+static u8 find_level_func(const char* name, u32* func_id)
+{
+	for (u32 i = 0; i < NUM_LEVEL_GEN_FUNCS; ++i) {
+		const char *full_name = BUILD_LEVEL_FUNCS[i].name;
+		const char *short_name = full_name + strlen("build_level_");
+		if (!strcmp(name, full_name) || !strcmp(name, short_name)) {
+			*func_id = i;
+			return 1;
+		}
+	}
+	return 0;
+}
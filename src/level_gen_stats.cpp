@@ -0,0 +1,332 @@
+// Headless level generation statistics.
+//
+// Runs BUILD_LEVEL_FUNCS entries over a range of seeds, a thread per core each
+// taking the next (generator, seed) pair, and prints a CSV row per generator:
+// generation time percentiles, cellular automata attempts and failures, floor
+// area, connected components, entity counts and how often the build hit an
+// ASSERT. Used to pick generator parameters that keep p99 generation time
+// bounded.
+//
+// Each seed seeds the thread's MT19937 before the build so a seed gives the same
+// level here as anywhere else. No level gen work queue is set so the cellular
+// automata attempts run inline on the seed's thread rather than every thread
+// fanning out again.
+//
+// usage: level_gen_stats [--seeds first count] [--threads n] [--per-seed file.csv]
+//                        [generator ...]
+//
+// generators are named as in BUILD_LEVEL_FUNCS, with or without "build_level_".
+
+#include "stdafx.h"
+
+#include <thread>
+#include <chrono>
+
+#include "level_gen_harness.h"
+#include "random.h"
+
+#include "thread.h"
+
+#define STATS_MAX_THREADS 64
+
+// -----------------------------------------------------------------------------
+// level measurements
+
+static u32 count_floor_tiles(Game* game)
+{
+	u32 result = 0;
+	for (u32 i = 0; i < ARRAY_SIZE(game->tiles.items); ++i) {
+		if (game->tiles.items[i].type == TILE_FLOOR) {
+			++result;
+		}
+	}
+	return result;
+}
+
+// 4-connected groups of floor tiles -- anything above 1 is floor the player can't
+// walk to. stack has room for every tile.
+static u32 count_floor_components(Game* game, u8* visited, u16* stack)
+{
+	memset(visited, 0, 256 * 256);
+	u32 result = 0;
+	for (u32 start = 0; start < 256 * 256; ++start) {
+		if (visited[start] || game->tiles.items[start].type != TILE_FLOOR) {
+			continue;
+		}
+		++result;
+		u32 stack_len = 0;
+		visited[start] = 1;
+		stack[stack_len++] = (u16)start;
+		while (stack_len) {
+			u16 idx = stack[--stack_len];
+			u32 x = idx % 256, y = idx / 256;
+			u32 neighbours[4];
+			u32 num_neighbours = 0;
+			if (x > 0)   { neighbours[num_neighbours++] = idx - 1; }
+			if (x < 255) { neighbours[num_neighbours++] = idx + 1; }
+			if (y > 0)   { neighbours[num_neighbours++] = idx - 256; }
+			if (y < 255) { neighbours[num_neighbours++] = idx + 256; }
+			for (u32 i = 0; i < num_neighbours; ++i) {
+				u32 n = neighbours[i];
+				if (!visited[n] && game->tiles.items[n].type == TILE_FLOOR) {
+					visited[n] = 1;
+					stack[stack_len++] = (u16)n;
+				}
+			}
+		}
+	}
+	return result;
+}
+
+// -----------------------------------------------------------------------------
+// jobs
+
+struct Seed_Result
+{
+	f64             time_us;
+	Level_Gen_Stats level_gen;
+	u32             floor_tiles;
+	u32             components;
+	u32             entities;
+	u8              asserted;
+};
+
+struct Stats_Jobs
+{
+	u32          first_seed;
+	u32          num_seeds;
+	u32          num_funcs;
+	u32          func_ids[NUM_LEVEL_GEN_FUNCS];
+	u32 volatile next_job;
+	Seed_Result *results; // num_funcs * num_seeds, by func then seed
+};
+
+typedef std::chrono::steady_clock Stats_Clock;
+
+static void stats_worker(Stats_Jobs* jobs)
+{
+	// far too big for the stack
+	Game *game = (Game*)malloc(sizeof(Game));
+	u8 *visited = (u8*)malloc(256 * 256);
+	u16 *stack = (u16*)malloc(256 * 256 * sizeof(u16));
+	ASSERT(game && visited && stack);
+
+	MT19937 rng;
+	rng.set_current();
+
+	u32 num_jobs = jobs->num_funcs * jobs->num_seeds;
+	for (;;) {
+		u32 job = interlocked_increment(&jobs->next_job) - 1;
+		if (job >= num_jobs) {
+			break;
+		}
+		u32 func_id = jobs->func_ids[job / jobs->num_seeds];
+		u32 seed = jobs->first_seed + job % jobs->num_seeds;
+		Seed_Result *result = &jobs->results[job];
+		memset(result, 0, sizeof(*result));
+
+		rng.seed(seed);
+		level_gen_set_thread_stats(&result->level_gen);
+		auto start = Stats_Clock::now();
+		u8 built = try_build_level(BUILD_LEVEL_FUNCS[func_id].func, game);
+		result->time_us = std::chrono::duration<f64, std::micro>(Stats_Clock::now() - start).count();
+		level_gen_set_thread_stats(NULL);
+
+		if (!built) {
+			result->asserted = 1;
+			continue;
+		}
+		result->floor_tiles = count_floor_tiles(game);
+		result->components = count_floor_components(game, visited, stack);
+		result->entities = game->entities.len;
+	}
+
+	free(stack);
+	free(visited);
+	free(game);
+}
+
+// -----------------------------------------------------------------------------
+// reporting
+
+static int compare_f64(const void* a, const void* b)
+{
+	f64 x = *(f64*)a, y = *(f64*)b;
+	return (x > y) - (x < y);
+}
+
+// nearest rank
+static f64 percentile(f64* sorted, u32 len, f64 p)
+{
+	u32 rank = (u32)ceil(p / 100.0 * (f64)len);
+	rank = rank ? rank - 1 : 0;
+	return sorted[min_u32(rank, len - 1)];
+}
+
+static void print_summary(Stats_Jobs* jobs, u32 func_idx, f64* times)
+{
+	Seed_Result *results = &jobs->results[func_idx * jobs->num_seeds];
+
+	u32 num_built = 0, num_asserted = 0;
+	u32 ca_runs = 0, ca_attempts = 0, ca_attempts_max = 0, ca_failures = 0;
+	u32 floor_min = (u32)-1, components_max = 0, entities_max = 0;
+	f64 time_total = 0.0, floor_total = 0.0, components_total = 0.0, entities_total = 0.0;
+	for (u32 i = 0; i < jobs->num_seeds; ++i) {
+		Seed_Result *r = &results[i];
+		if (r->asserted) {
+			++num_asserted;
+			continue;
+		}
+		times[num_built++] = r->time_us;
+		time_total += r->time_us;
+
+		ca_runs += r->level_gen.cellular_automata_runs;
+		ca_attempts += r->level_gen.cellular_automata_attempts;
+		ca_failures += r->level_gen.cellular_automata_failures;
+		ca_attempts_max = max_u32(ca_attempts_max, r->level_gen.cellular_automata_attempts);
+
+		floor_total += r->floor_tiles;
+		floor_min = min_u32(floor_min, r->floor_tiles);
+		components_total += r->components;
+		components_max = max_u32(components_max, r->components);
+		entities_total += r->entities;
+		entities_max = max_u32(entities_max, r->entities);
+	}
+
+	const char *name = BUILD_LEVEL_FUNCS[jobs->func_ids[func_idx]].name;
+	f64 assert_rate = (f64)num_asserted / (f64)jobs->num_seeds;
+	if (!num_built) {
+		printf("%s,%u,%u,,,,,,,,,,,,,,,%f\n", name, jobs->num_seeds, num_built, assert_rate);
+		return;
+	}
+
+	qsort(times, num_built, sizeof(times[0]), compare_f64);
+	f64 n = (f64)num_built;
+	printf("%s,%u,%u,%.1f,%.1f,%.1f,%.1f,%.1f,%u,%.2f,%u,%f,%.1f,%u,%.3f,%u,%.1f,%u,%f\n",
+	       name,
+	       jobs->num_seeds,
+	       num_built,
+	       time_total / n,
+	       percentile(times, num_built, 50.0),
+	       percentile(times, num_built, 90.0),
+	       percentile(times, num_built, 99.0),
+	       times[num_built - 1],
+	       ca_runs,
+	       (f64)ca_attempts / n,
+	       ca_attempts_max,
+	       ca_runs ? (f64)ca_failures / (f64)ca_runs : 0.0,
+	       floor_total / n,
+	       floor_min,
+	       components_total / n,
+	       components_max,
+	       entities_total / n,
+	       entities_max,
+	       assert_rate);
+}
+
+static void write_per_seed(Stats_Jobs* jobs, FILE* f)
+{
+	fprintf(f, "generator,seed,time_us,ca_runs,ca_attempts,ca_failures,"
+	           "floor_tiles,components,entities,asserted\n");
+	for (u32 func_idx = 0; func_idx < jobs->num_funcs; ++func_idx) {
+		const char *name = BUILD_LEVEL_FUNCS[jobs->func_ids[func_idx]].name;
+		for (u32 i = 0; i < jobs->num_seeds; ++i) {
+			Seed_Result *r = &jobs->results[func_idx * jobs->num_seeds + i];
+			fprintf(f, "%s,%u,%.1f,%u,%u,%u,%u,%u,%u,%u\n",
+			        name,
+			        jobs->first_seed + i,
+			        r->time_us,
+			        r->level_gen.cellular_automata_runs,
+			        r->level_gen.cellular_automata_attempts,
+			        r->level_gen.cellular_automata_failures,
+			        r->floor_tiles,
+			        r->components,
+			        r->entities,
+			        r->asserted);
+		}
+	}
+}
+
+// -----------------------------------------------------------------------------
+// main
+
+int main(int argc, char** argv)
+{
+	Stats_Jobs jobs = {};
+	jobs.first_seed = 0;
+	jobs.num_seeds = 1000;
+	u32 num_threads = std::thread::hardware_concurrency();
+	const char *per_seed_filename = NULL;
+
+	for (int i = 1; i < argc; ++i) {
+		if (!strcmp(argv[i], "--seeds") && i + 2 < argc) {
+			jobs.first_seed = strtoul(argv[++i], NULL, 10);
+			jobs.num_seeds = strtoul(argv[++i], NULL, 10);
+		} else if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+			num_threads = strtoul(argv[++i], NULL, 10);
+		} else if (!strcmp(argv[i], "--per-seed") && i + 1 < argc) {
+			per_seed_filename = argv[++i];
+		} else if (jobs.num_funcs < NUM_LEVEL_GEN_FUNCS
+		        && find_level_func(argv[i], &jobs.func_ids[jobs.num_funcs])) {
+			++jobs.num_funcs;
+		} else {
+			fprintf(stderr, "unknown argument \"%s\"\n", argv[i]);
+			fprintf(stderr, "usage: %s [--seeds first count] [--threads n] "
+			                "[--per-seed file.csv] [generator ...]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (!jobs.num_funcs) {
+		for (u32 i = 0; i < NUM_LEVEL_GEN_FUNCS; ++i) {
+			jobs.func_ids[jobs.num_funcs++] = i;
+		}
+	}
+	if (!jobs.num_seeds) {
+		fprintf(stderr, "no seeds to run\n");
+		return 1;
+	}
+	num_threads = max_u32(1, min_u32(num_threads, STATS_MAX_THREADS));
+
+	jobs.results = (Seed_Result*)calloc(jobs.num_funcs * jobs.num_seeds, sizeof(Seed_Result));
+	f64 *times = (f64*)malloc(jobs.num_seeds * sizeof(f64));
+	ASSERT(jobs.results && times);
+
+	catch_asserts();
+
+	auto start = Stats_Clock::now();
+	std::thread threads[STATS_MAX_THREADS];
+	for (u32 i = 1; i < num_threads; ++i) {
+		threads[i] = std::thread(stats_worker, &jobs);
+	}
+	stats_worker(&jobs);
+	for (u32 i = 1; i < num_threads; ++i) {
+		threads[i].join();
+	}
+	f64 seconds = std::chrono::duration<f64>(Stats_Clock::now() - start).count();
+
+	printf("generator,seeds,built,time_mean_us,time_p50_us,time_p90_us,time_p99_us,time_max_us,"
+	       "ca_runs,ca_attempts_mean,ca_attempts_max,ca_failure_rate,"
+	       "floor_mean,floor_min,components_mean,components_max,"
+	       "entities_mean,entities_max,assert_rate\n");
+	for (u32 i = 0; i < jobs.num_funcs; ++i) {
+		print_summary(&jobs, i, times);
+	}
+
+	u32 num_levels = jobs.num_funcs * jobs.num_seeds;
+	fprintf(stderr, "%u levels in %.2fs on %u threads -- %.1f levels/s\n",
+	        num_levels, seconds, num_threads, (f64)num_levels / seconds);
+
+	if (per_seed_filename) {
+		FILE *f = fopen(per_seed_filename, "w");
+		if (!f) {
+			fprintf(stderr, "couldn't open \"%s\" for writing\n", per_seed_filename);
+			return 1;
+		}
+		write_per_seed(&jobs, f);
+		fclose(f);
+	}
+
+	free(times);
+	free(jobs.results);
+	return 0;
+}
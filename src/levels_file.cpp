@@ -0,0 +1,94 @@
+// Writes PREBUILT_LEVELS_FILE_NAME (or the file named on the command line) from
+// the level sources in level_gen.cpp. Needs rerunning whenever the sources or the
+// layout of the entity, controller or Message_Handler structs change -- the game
+// falls back to parsing the sources if the file doesn't match. The build runs it
+// after building the game.
+//
+// Before writing, every level is loaded back out of the buffer and checked to be
+// byte for byte the Game parsing its source gives, so the file is never written
+// if loading it would change a level.
+//
+// usage: build_levels_file [output_filename]
+
+#include "stdafx.h"
+
+#include "prebuilt_level.h"
+#include "random.h"
+
+#include "thread.h"
+
+#define LEVELS_FILE_MAX_SIZE (64*1024*1024)
+
+int main(int argc, char** argv)
+{
+	const char *filename = argc > 1 ? argv[1] : PREBUILT_LEVELS_FILE_NAME;
+
+	// far too big for the stack
+	Game *game = (Game*)malloc(sizeof(Game));
+	Game *loaded = (Game*)malloc(sizeof(Game));
+	u8 *buffer = (u8*)malloc(LEVELS_FILE_MAX_SIZE);
+	ASSERT(game && loaded && buffer);
+
+	// the few random choices in the sources (spiderweb appearances) are fixed
+	// when the file is built
+	MT19937 rng;
+	rng.seed(0);
+	rng.set_current();
+
+	size_t size = write_prebuilt_levels(game, buffer, LEVELS_FILE_MAX_SIZE);
+	if (!size) {
+		fprintf(stderr, "levels don't fit in %u bytes\n", LEVELS_FILE_MAX_SIZE);
+		return EXIT_FAILURE;
+	}
+
+	// the same random choices as writing, level by level
+	Prebuilt_Levels_Header *header = (Prebuilt_Levels_Header*)buffer;
+	rng.seed(0);
+	u32 num_mismatched = 0;
+	for (u32 i = 0; i < NUM_PREBUILT_LEVELS; ++i) {
+		parse_prebuilt_level(game, (Prebuilt_Level_ID)i);
+		copy_prebuilt_level(loaded, header, (Prebuilt_Level_ID)i);
+		if (memcmp(game, loaded, sizeof(Game))) {
+			fprintf(stderr, "%s loads differently from its source\n", PREBUILT_LEVEL_NAMES[i]);
+			++num_mismatched;
+		}
+	}
+	if (num_mismatched) {
+		return EXIT_FAILURE;
+	}
+
+	FILE *fp = fopen(filename, "wb");
+	if (!fp) {
+		fprintf(stderr, "couldn't open \"%s\" for writing\n", filename);
+		return EXIT_FAILURE;
+	}
+	size_t written = fwrite(buffer, size, 1, fp);
+	fclose(fp);
+	if (!written) {
+		fprintf(stderr, "couldn't write \"%s\"\n", filename);
+		return EXIT_FAILURE;
+	}
+
+	for (u32 i = 0; i < NUM_PREBUILT_LEVELS; ++i) {
+		Prebuilt_Level *level = (Prebuilt_Level*)(buffer + header->levels[i].file_offset);
+		u32 num_controllers = 0;
+		for (u32 j = 0; j < NUM_CONTROLLER_TYPES; ++j) {
+			num_controllers += level->num_controllers[j];
+		}
+		printf("%-24s %3ux%-3u tiles %4u entities %4u controllers %4u handlers %4u timers %7u bytes\n",
+		       PREBUILT_LEVEL_NAMES[i],
+		       level->tiles_size.w ? level->tiles_size.w : 256,
+		       level->tiles_size.h ? level->tiles_size.h : 256,
+		       level->num_entities,
+		       num_controllers,
+		       level->num_handlers,
+		       level->num_timers - 1, // timers[0] isn't a timer
+		       header->levels[i].size);
+	}
+	printf("wrote %zu bytes to \"%s\"\n", size, filename);
+
+	free(buffer);
+	free(loaded);
+	free(game);
+	return EXIT_SUCCESS;
+}
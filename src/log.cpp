@@ -6,6 +6,28 @@
 
 const char ESCAPE = 0x1B;
 
+const char *LOG_LEVEL_NAMES[] = {
+	"error",
+	"warning",
+	"info",
+	"debug",
+	"trace",
+};
+
+const char *LOG_CATEGORY_NAMES[] = {
+#define LOG_CATEGORY(name, default_level) #name,
+	LOG_CATEGORIES
+#undef LOG_CATEGORY
+};
+
+Log_Level log_category_levels[] = {
+#define LOG_CATEGORY(name, default_level) default_level,
+	LOG_CATEGORIES
+#undef LOG_CATEGORY
+};
+
+static void scroll_buffer(Log* l, Log_Scroll scroll);
+
 void init(Log* l, char* buffer, size_t buffer_size)
 {
 	memset(l, 0, sizeof(*l));
@@ -14,6 +36,13 @@ void init(Log* l, char* buffer, size_t buffer_size)
 	reset(l);
 }
 
+void init_records(Log* l, u8* records, u32 records_size)
+{
+	l->records = records;
+	l->records_size = records_size;
+	l->records_len = 0;
+}
+
 void reset(Log* l)
 {
 	l->start_pos = 0;
@@ -22,9 +51,10 @@ void reset(Log* l)
 	// XXX - is this necessary?
 	l->buffer[0] = 0;
 	l->scroll_state = LOG_SCROLL_STATE_BOTTOM;
+	l->records_len = 0;
 }
 
-void log(Log* l, const char* str)
+static void append_line(Log* l, const char* str)
 {
 	size_t buffer_size = l->buffer_size;
 	u32 buffer_pos = l->end_pos;
@@ -49,10 +79,93 @@ void log(Log* l, const char* str)
 		l->read_pos = l->start_pos;
 	}
 	if (l->scroll_state == LOG_SCROLL_STATE_BOTTOM) {
-		scroll(l, LOG_SCROLL_BOTTOM);
+		scroll_buffer(l, LOG_SCROLL_BOTTOM);
 	}
 }
 
+#define LOG_MAP_ROW_WORDS (256 / 64)
+
+static void append_map(Log* l, u64* rows, v2_u32 size)
+{
+	char line[257];
+	for (u32 y = 0; y < size.h; ++y) {
+		u64 *row = &rows[y * LOG_MAP_ROW_WORDS];
+		for (u32 x = 0; x < size.w; ++x) {
+			line[x] = row[x / 64] & ((u64)1 << (x % 64)) ? '#' : '.';
+		}
+		line[size.w] = 0;
+		append_line(l, line);
+	}
+}
+
+// =============================================================================
+// records
+
+enum Log_Record_Type
+{
+	LOG_RECORD_TEXT, // followed by the string
+	LOG_RECORD_MAP,  // followed by the size then LOG_MAP_ROW_WORDS words per row
+};
+
+struct Log_Record_Header
+{
+	Log_Record_Type type;
+	u32             size; // including the header
+};
+
+// NULL if the record can never fit
+static void* push_record(Log* l, Log_Record_Type type, u32 payload_size)
+{
+	u32 size = (sizeof(Log_Record_Header) + payload_size + 7) & ~7;
+	if (size > l->records_size) {
+		return NULL;
+	}
+	if (l->records_len + size > l->records_size) {
+		flush_records(l);
+	}
+	Log_Record_Header *header = (Log_Record_Header*)&l->records[l->records_len];
+	header->type = type;
+	header->size = size;
+	l->records_len += size;
+	return header + 1;
+}
+
+void flush_records(Log* l)
+{
+	for (u32 pos = 0; pos < l->records_len; ) {
+		Log_Record_Header *header = (Log_Record_Header*)&l->records[pos];
+		switch (header->type) {
+		case LOG_RECORD_TEXT:
+			append_line(l, (char*)(header + 1));
+			break;
+		case LOG_RECORD_MAP: {
+			v2_u32 *size = (v2_u32*)(header + 1);
+			append_map(l, (u64*)(size + 1), *size);
+			break;
+		}
+		}
+		pos += header->size;
+	}
+	l->records_len = 0;
+}
+
+// =============================================================================
+// logging
+
+void log(Log* l, const char* str)
+{
+	if (l->records) {
+		u32 len = strlen(str) + 1;
+		char *dest = (char*)push_record(l, LOG_RECORD_TEXT, len);
+		if (dest) {
+			memcpy(dest, str, len);
+			return;
+		}
+		flush_records(l);
+	}
+	append_line(l, str);
+}
+
 void logf(Log* l, const char* format_string, ...)
 {
 	char print_buffer[4096];
@@ -64,8 +177,25 @@ void logf(Log* l, const char* format_string, ...)
 	log(l, print_buffer);
 }
 
+void log_map(Log* l, Map_Cache_Bool* map, v2_u32 size)
+{
+	if (l->records) {
+		u32 rows_size = size.h * LOG_MAP_ROW_WORDS * sizeof(u64);
+		v2_u32 *dest = (v2_u32*)push_record(l, LOG_RECORD_MAP, sizeof(size) + rows_size);
+		if (dest) {
+			*dest = size;
+			memcpy(dest + 1, map->items, rows_size);
+			return;
+		}
+		flush_records(l);
+	}
+	append_map(l, map->items, size);
+}
+
 void render(Log* l, Render* render)
 {
+	flush_records(l);
+
 	auto r = &render->render_job_buffer;
 
 	v2 glyph_size = v2(9.0f, 16.0f);
@@ -188,6 +318,12 @@ static u32 get_prev_line_start(Log* l, u32 pos)
 }
 
 void scroll(Log* l, Log_Scroll scroll)
+{
+	flush_records(l);
+	scroll_buffer(l, scroll);
+}
+
+static void scroll_buffer(Log* l, Log_Scroll scroll)
 {
 	switch (scroll) {
 	case LOG_SCROLL_TOP:
@@ -216,6 +352,8 @@ void scroll(Log* l, Log_Scroll scroll)
 
 JFG_Error write_to_file(Log* log, const char* filename)
 {
+	flush_records(log);
+
 	u32 start_pos = log->start_pos;
 	u32 end_pos = log->end_pos;
 	size_t buffer_size = log->buffer_size;
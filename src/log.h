@@ -19,6 +19,66 @@ enum Log_Scroll_State
 	LOG_SCROLL_STATE_MIDDLE,
 };
 
+// =============================================================================
+// levels and categories
+//
+// Messages at levels more verbose than LOG_MAX_LEVEL (later in Log_Level)
+// compile to nothing -- the arguments aren't even evaluated. The rest are checked
+// against the category's runtime level before anything is formatted.
+
+enum Log_Level
+{
+	LOG_LEVEL_ERROR,
+	LOG_LEVEL_WARNING,
+	LOG_LEVEL_INFO,
+	LOG_LEVEL_DEBUG,
+	LOG_LEVEL_TRACE,
+
+	NUM_LOG_LEVELS
+};
+
+#ifndef LOG_MAX_LEVEL
+#ifdef DEBUG
+#define LOG_MAX_LEVEL LOG_LEVEL_TRACE
+#else
+#define LOG_MAX_LEVEL LOG_LEVEL_INFO
+#endif
+#endif
+
+#define LOG_CATEGORIES \
+	LOG_CATEGORY(level_gen, LOG_LEVEL_INFO)
+
+enum Log_Category
+{
+#define LOG_CATEGORY(name, default_level) LOG_CATEGORY_##name,
+	LOG_CATEGORIES
+#undef LOG_CATEGORY
+
+	NUM_LOG_CATEGORIES
+};
+
+extern const char *LOG_LEVEL_NAMES[NUM_LOG_LEVELS];
+extern const char *LOG_CATEGORY_NAMES[NUM_LOG_CATEGORIES];
+extern Log_Level log_category_levels[NUM_LOG_CATEGORIES];
+
+#define LOG_ENABLED(category, level) \
+	((level) <= LOG_MAX_LEVEL && (level) <= log_category_levels[LOG_CATEGORY_##category])
+
+// l may be NULL
+#define LOG(l, category, level, str) \
+	do { if (LOG_ENABLED(category, level) && (l)) { log(l, str); } } while (0)
+#define LOGF(l, category, level, ...) \
+	do { if (LOG_ENABLED(category, level) && (l)) { logf(l, __VA_ARGS__); } } while (0)
+#define LOG_MAP(l, category, level, map, size) \
+	do { if (LOG_ENABLED(category, level) && (l)) { log_map(l, map, size); } } while (0)
+
+// =============================================================================
+// log
+
+// Logs with a record buffer keep what's logged as records -- text as it was
+// passed, maps as their bits -- and only turn them into lines when the log is
+// read (rendered, scrolled or written out), so logging a map costs a memcpy of
+// its rows. Without one everything is formatted straight into the buffer.
 struct Log
 {
 	char            *buffer;
@@ -28,12 +88,20 @@ struct Log
 	u32              read_pos;
 	v2_u32           grid_size;
 	Log_Scroll_State scroll_state;
+
+	u8              *records;
+	u32              records_size;
+	u32              records_len;
 };
 
 void init(Log* l, char* buffer, size_t buffer_size);
+void init_records(Log* l, u8* records, u32 records_size);
 void reset(Log* l);
 void log(Log* l, const char* str);
 void logf(Log* l, const char* format_string, ...);
+// one line per row, '#' for set bits
+void log_map(Log* l, Map_Cache_Bool* map, v2_u32 size);
+void flush_records(Log* l);
 void render(Log* l, Render* render);
 void scroll(Log* l, Log_Scroll scroll);
 JFG_Error write_to_file(Log* log, const char* filename);
\ No newline at end of file
@@ -47,6 +47,36 @@ u32 win32_try_read_file(char* filename, void* dest, u32 max_size)
 	return bytes_read;
 }
 
+// read only, NULL on failure. The view outlives the handles so nothing needs
+// closing.
+void* win32_map_file(const char* filename, size_t* size)
+{
+	HANDLE file_handle = CreateFile(filename,
+	                                GENERIC_READ,
+	                                FILE_SHARE_READ,
+	                                NULL,
+	                                OPEN_EXISTING,
+	                                FILE_ATTRIBUTE_NORMAL,
+	                                NULL);
+	if (file_handle == INVALID_HANDLE_VALUE) {
+		return NULL;
+	}
+	void *result = NULL;
+	LARGE_INTEGER file_size = {};
+	if (GetFileSizeEx(file_handle, &file_size) && file_size.QuadPart) {
+		HANDLE mapping_handle = CreateFileMapping(file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping_handle) {
+			result = MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0);
+			CloseHandle(mapping_handle);
+		}
+	}
+	CloseHandle(file_handle);
+	if (result) {
+		*size = (size_t)file_size.QuadPart;
+	}
+	return result;
+}
+
 JFG_Error win32_try_write_file(const char* filename, void* src, size_t size)
 {
 	HANDLE file_handle = CreateFile(filename,
@@ -137,6 +167,35 @@ void win32_sleep(u32 time_in_milliseconds)
 	Sleep(time_in_milliseconds);
 }
 
+u32 win32_get_num_processors()
+{
+	SYSTEM_INFO system_info = {};
+	GetSystemInfo(&system_info);
+	return system_info.dwNumberOfProcessors;
+}
+
+Semaphore* win32_create_semaphore(u32 initial_count)
+{
+	HANDLE semaphore = CreateSemaphoreA(NULL, (LONG)initial_count, LONG_MAX, NULL);
+	ASSERT(semaphore);
+	return (Semaphore*)semaphore;
+}
+
+void win32_free_semaphore(Semaphore* semaphore)
+{
+	CloseHandle((HANDLE)semaphore);
+}
+
+void win32_wait_semaphore(Semaphore* semaphore)
+{
+	WaitForSingleObject((HANDLE)semaphore, INFINITE);
+}
+
+void win32_signal_semaphore(Semaphore* semaphore)
+{
+	ReleaseSemaphore((HANDLE)semaphore, 1, NULL);
+}
+
 static u8 running = 1;
 static Input input_buffers[2];
 static Input *input_front_buffer, *input_back_buffer;
@@ -331,12 +390,24 @@ void game_loop(void *uncast_args)
 	Platform_Functions platform_functions = {};
 	platform_functions.start_thread = win32_start_thread;
 	platform_functions.sleep = win32_sleep;
+	platform_functions.get_num_processors = win32_get_num_processors;
+	platform_functions.create_semaphore = win32_create_semaphore;
+	platform_functions.free_semaphore = win32_free_semaphore;
+	platform_functions.wait_semaphore = win32_wait_semaphore;
+	platform_functions.signal_semaphore = win32_signal_semaphore;
 	platform_functions.try_read_file = win32_try_read_file;
+	platform_functions.map_file = win32_map_file;
 	platform_functions.try_write_file = win32_try_write_file;
 
 	start_thread = win32_start_thread;
 	sleep = win32_sleep;
+	get_num_processors = win32_get_num_processors;
+	create_semaphore = win32_create_semaphore;
+	free_semaphore = win32_free_semaphore;
+	wait_semaphore = win32_wait_semaphore;
+	signal_semaphore = win32_signal_semaphore;
 	try_read_file = win32_try_read_file;
+	map_file = win32_map_file;
 	try_write_file = win32_try_write_file;
 
 	program_init(program, &draw_data, &renderer, platform_functions);
@@ -4,20 +4,40 @@
 #include "prelude.h"
 #include "containers.hpp"
 #include "jfg_math.h"
+#include "simd.h"
+#include "fixed_point.h"
 
 #include "types.h"
 #include "debug_draw_world.h"
 
+// limits can be raised by defining them before including this file
+#ifndef PHYSICS_MAX_STATIC_LINES
 #define PHYSICS_MAX_STATIC_LINES   1024
+#endif
+#ifndef PHYSICS_MAX_STATIC_CIRCLES
 #define PHYSICS_MAX_STATIC_CIRCLES 1024
+#endif
+#ifndef PHYSICS_MAX_LINEAR_CIRCLES
 #define PHYSICS_MAX_LINEAR_CIRCLES 1024
+#endif
 #define PHYSICS_MAX_COLLISIONS     1024
+#ifndef PHYSICS_MAX_EVENTS
+#define PHYSICS_MAX_EVENTS         10240
+#endif
+
+#define PHYSICS_MAX_2(a, b) ((a) > (b) ? (a) : (b))
+#define PHYSICS_MAX_OBJECTS_PER_TYPE \
+	PHYSICS_MAX_2(PHYSICS_MAX_2(PHYSICS_MAX_STATIC_LINES, PHYSICS_MAX_STATIC_CIRCLES), \
+	              PHYSICS_MAX_LINEAR_CIRCLES)
 
 struct Physics_Object_Meta_Data
 {
 	Entity_ID owner_id;
 	u32 collision_mask;
 	u32 collides_with_mask;
+	// set when the object is added, changed or removed -- pairs involving it
+	// are recomputed by the next physics_update_collisions
+	u8  dirty;
 };
 
 struct Physics_Static_Line : Physics_Object_Meta_Data
@@ -119,8 +139,56 @@ struct Physics_Event
 	};
 };
 
+// Events sorted by time -- everything before head is in the past
+struct Physics_Event_Queue
+{
+	u32 head;
+	Max_Length_Array<Physics_Event, PHYSICS_MAX_EVENTS> events;
+};
+
+struct Physics_Interval_Overlap
+{
+	u32 object_index_1;
+	u32 object_index_2;
+};
+
+template <typename T>
+struct Physics_Buffer
+{
+	T   *items;
+	u32  len;
+	u32  size;
+
+	operator Slice<T>()         { return Slice<T>(items, len); }
+	operator Output_Buffer<T>() { return Output_Buffer<T>(items, &len, size); }
+	T& operator[](u32 idx) { ASSERT(idx < len); return items[idx]; }
+};
+
+// Scratch memory reused by every physics_compute_collisions call on a context.
+// Buffers grow to fit the current object counts and are never shrunk.
+struct Physics_Scratch
+{
+	Physics_Buffer<Physics_Interval_Overlap> overlaps;
+	Physics_Buffer<Physics_Interval_Overlap> overlapping_x_intervals;
+	Physics_Buffer<Physics_Interval_Overlap> overlapping_y_intervals;
+
+	// events for dirty pairs before they are merged into the caller's list
+	Physics_Buffer<Physics_Event> events;
+
+	// radix sort buffers and objects already placed while rebuilding an interval list
+	Physics_Buffer<Physics_Interval>        sorted_intervals;
+	Physics_Buffer<Physics_Event>           sorted_events;
+	Bit_Array<PHYSICS_MAX_OBJECTS_PER_TYPE> listed;
+
+	// bitmap of x overlaps indexed by object index pair -- kept all zero between uses
+	u64 *overlap_bits;
+	u32  overlap_bits_size;
+};
+
 struct Physics_Context
 {
+	Physics_Scratch scratch;
+
 	Max_Length_Array<Physics_Static_Line, PHYSICS_MAX_STATIC_LINES> static_lines;
 	Max_Length_Array<Physics_Interval,    PHYSICS_MAX_STATIC_LINES> static_line_x_intervals;
 	Max_Length_Array<Physics_Interval,    PHYSICS_MAX_STATIC_LINES> static_line_y_intervals;
@@ -132,8 +200,17 @@ struct Physics_Context
 	Max_Length_Array<Physics_Linear_Circle, PHYSICS_MAX_LINEAR_CIRCLES> linear_circles;
 	Max_Length_Array<Physics_Interval,      PHYSICS_MAX_LINEAR_CIRCLES> linear_circle_x_intervals;
 	Max_Length_Array<Physics_Interval,      PHYSICS_MAX_LINEAR_CIRCLES> linear_circle_y_intervals;
+
+	// subsets of the above containing only dirty objects, still sorted
+	Max_Length_Array<Physics_Interval, PHYSICS_MAX_STATIC_LINES>   dirty_static_line_x_intervals;
+	Max_Length_Array<Physics_Interval, PHYSICS_MAX_STATIC_LINES>   dirty_static_line_y_intervals;
+	Max_Length_Array<Physics_Interval, PHYSICS_MAX_STATIC_CIRCLES> dirty_static_circle_x_intervals;
+	Max_Length_Array<Physics_Interval, PHYSICS_MAX_STATIC_CIRCLES> dirty_static_circle_y_intervals;
+	Max_Length_Array<Physics_Interval, PHYSICS_MAX_LINEAR_CIRCLES> dirty_linear_circle_x_intervals;
+	Max_Length_Array<Physics_Interval, PHYSICS_MAX_LINEAR_CIRCLES> dirty_linear_circle_y_intervals;
 };
 
+// not every function uses every member, hence the casts
 #define USE_PHYSICS_CONTEXT(name) \
 	auto& static_lines = name->static_lines; \
 	auto& static_line_x_intervals = name->static_line_x_intervals; \
@@ -143,7 +220,28 @@ struct Physics_Context
 	auto& static_circle_y_intervals = name->static_circle_y_intervals; \
 	auto& linear_circles = name->linear_circles; \
 	auto& linear_circle_x_intervals = name->linear_circle_x_intervals; \
-	auto& linear_circle_y_intervals = name->linear_circle_y_intervals;
+	auto& linear_circle_y_intervals = name->linear_circle_y_intervals; \
+	auto& dirty_static_line_x_intervals = name->dirty_static_line_x_intervals; \
+	auto& dirty_static_line_y_intervals = name->dirty_static_line_y_intervals; \
+	auto& dirty_static_circle_x_intervals = name->dirty_static_circle_x_intervals; \
+	auto& dirty_static_circle_y_intervals = name->dirty_static_circle_y_intervals; \
+	auto& dirty_linear_circle_x_intervals = name->dirty_linear_circle_x_intervals; \
+	auto& dirty_linear_circle_y_intervals = name->dirty_linear_circle_y_intervals; \
+	(void)static_lines; \
+	(void)static_line_x_intervals; \
+	(void)static_line_y_intervals; \
+	(void)static_circles; \
+	(void)static_circle_x_intervals; \
+	(void)static_circle_y_intervals; \
+	(void)linear_circles; \
+	(void)linear_circle_x_intervals; \
+	(void)linear_circle_y_intervals; \
+	(void)dirty_static_line_x_intervals; \
+	(void)dirty_static_line_y_intervals; \
+	(void)dirty_static_circle_x_intervals; \
+	(void)dirty_static_circle_y_intervals; \
+	(void)dirty_linear_circle_x_intervals; \
+	(void)dirty_linear_circle_y_intervals;
 
 void physics_reset(Physics_Context* context)
 {
@@ -156,6 +254,56 @@ void physics_reset(Physics_Context* context)
 	context->linear_circles.reset();
 	context->linear_circle_x_intervals.reset();
 	context->linear_circle_y_intervals.reset();
+	context->dirty_static_line_x_intervals.reset();
+	context->dirty_static_line_y_intervals.reset();
+	context->dirty_static_circle_x_intervals.reset();
+	context->dirty_static_circle_y_intervals.reset();
+	context->dirty_linear_circle_x_intervals.reset();
+	context->dirty_linear_circle_y_intervals.reset();
+}
+
+void physics_init(Physics_Context* context)
+{
+	memset(&context->scratch, 0, sizeof(context->scratch));
+	physics_reset(context);
+}
+
+void physics_free(Physics_Context* context)
+{
+	Physics_Scratch *scratch = &context->scratch;
+	free(scratch->overlaps.items);
+	free(scratch->overlapping_x_intervals.items);
+	free(scratch->overlapping_y_intervals.items);
+	free(scratch->events.items);
+	free(scratch->sorted_intervals.items);
+	free(scratch->sorted_events.items);
+	free(scratch->overlap_bits);
+	memset(scratch, 0, sizeof(*scratch));
+}
+
+template <typename T>
+static void physics_reserve(Physics_Buffer<T>* buffer, u32 size)
+{
+	buffer->len = 0;
+	if (buffer->size >= size) {
+		return;
+	}
+	free(buffer->items);
+	buffer->items = (T*)malloc(size * sizeof(buffer->items[0]));
+	ASSERT(buffer->items);
+	buffer->size = size;
+}
+
+static void physics_reserve_overlap_bits(Physics_Scratch* scratch, u32 num_bits)
+{
+	u32 num_words = (num_bits + 63) / 64;
+	if (scratch->overlap_bits_size >= num_words) {
+		return;
+	}
+	free(scratch->overlap_bits);
+	scratch->overlap_bits = (u64*)calloc(num_words, sizeof(u64));
+	ASSERT(scratch->overlap_bits);
+	scratch->overlap_bits_size = num_words;
 }
 
 static inline u8 physics_do_objects_collide(Physics_Object_Meta_Data *object_1,
@@ -165,9 +313,11 @@ static inline u8 physics_do_objects_collide(Physics_Object_Meta_Data *object_1,
 	     && object_2->collides_with_mask & object_1->collision_mask);
 }
 
-static void physics_sort_intervals(Slice<Physics_Interval> intervals)
+// below this many out of order neighbours an insertion sort beats the radix sort
+#define PHYSICS_NEARLY_SORTED_MAX_DESCENTS 8
+
+static void physics_insertion_sort_intervals(Slice<Physics_Interval> intervals)
 {
-	// XXX - use insertion sort for now because it's simple
 	for (u32 i = 1; i < intervals.len; ++i) {
 		Physics_Interval interval = intervals[i];
 		u32 j = i;
@@ -181,95 +331,181 @@ static void physics_sort_intervals(Slice<Physics_Interval> intervals)
 	}
 }
 
-void physics_start_frame(Physics_Context* context)
+static inline u32 physics_sort_key(f32 x)
 {
-	USE_PHYSICS_CONTEXT(context)
-
-	static_line_x_intervals.reset();
-	static_line_y_intervals.reset();
-	for (u32 i = 0; i < static_lines.len; ) {
-		Physics_Static_Line line = static_lines[i];
-		if (!line.owner_id) {
-			static_lines.remove(i);
-			continue;
-		}
+	// flip the bits so that unsigned order matches float order -- all bits of
+	// negative numbers, just the sign bit of positive ones
+	u32 bits;
+	memcpy(&bits, &x, sizeof(bits));
+	u32 mask = (u32)(-(i32)(bits >> 31)) | 0x80000000;
+	return bits ^ mask;
+}
 
-		Physics_Interval interval_x;
-		interval_x.object_index = i;
-		interval_x.start = min(line.start.x, line.end.x);
-		interval_x.end = max(line.start.x, line.end.x);
-		static_line_x_intervals.append(interval_x);
+// stable LSD radix sort on the f32 member key, one byte per pass -- buffer
+// must hold items.len items
+template <typename T, f32 T::*key>
+static void physics_radix_sort(Slice<T> items, T* buffer)
+{
+	u32 n = items.len;
+	if (n < 2) {
+		return;
+	}
 
-		Physics_Interval interval_y;
-		interval_y.object_index = i;
-		interval_y.start = min(line.start.y, line.end.y);
-		interval_y.end = max(line.start.y, line.end.y);
-		static_line_y_intervals.append(interval_y);
-		++i;
+	u32 counts[4][256];
+	memset(counts, 0, sizeof(counts));
+	for (u32 i = 0; i < n; ++i) {
+		u32 sort_key = physics_sort_key(items[i].*key);
+		for (u32 pass = 0; pass < 4; ++pass) {
+			++counts[pass][(sort_key >> (8 * pass)) & 0xFF];
+		}
 	}
 
-	static_circle_x_intervals.reset();
-	static_circle_y_intervals.reset();
-	for (u32 i = 0; i < static_circles.len; ) {
-		Physics_Static_Circle circle = static_circles[i];
-		if (!circle.owner_id) {
-			static_circles.remove(i);
+	T *src = items.base;
+	T *dst = buffer;
+	u32 first_key = physics_sort_key(src[0].*key);
+	for (u32 pass = 0; pass < 4; ++pass) {
+		u32 shift = 8 * pass;
+		u32 *count = counts[pass];
+		// every key has the same byte here so this pass wouldn't move anything
+		if (count[(first_key >> shift) & 0xFF] == n) {
 			continue;
 		}
 
-		Physics_Interval interval_x;
-		interval_x.object_index = i;
-		interval_x.start = circle.pos.x - circle.radius;
-		interval_x.end = circle.pos.x + circle.radius;
-		static_circle_x_intervals.append(interval_x);
+		u32 offset = 0;
+		for (u32 i = 0; i < 256; ++i) {
+			u32 c = count[i];
+			count[i] = offset;
+			offset += c;
+		}
 
-		Physics_Interval interval_y;
-		interval_y.object_index = i;
-		interval_y.start = circle.pos.y - circle.radius;
-		interval_y.end = circle.pos.y + circle.radius;
-		static_circle_y_intervals.append(interval_y);
-		++i;
+		for (u32 i = 0; i < n; ++i) {
+			u32 digit = (physics_sort_key(src[i].*key) >> shift) & 0xFF;
+			dst[count[digit]++] = src[i];
+		}
+
+		T *tmp = src;
+		src = dst;
+		dst = tmp;
 	}
 
-	linear_circle_x_intervals.reset();
-	linear_circle_y_intervals.reset();
-	for (u32 i = 0; i < linear_circles.len; ) {
-		Physics_Linear_Circle circle = linear_circles[i];
-		if (!circle.owner_id) {
-			linear_circles.remove(i);
-			continue;
+	if (src != items.base) {
+		memcpy(items.base, src, n * sizeof(items.base[0]));
+	}
+}
+
+static void physics_radix_sort_intervals(Physics_Scratch* scratch, Slice<Physics_Interval> intervals)
+{
+	physics_reserve(&scratch->sorted_intervals, intervals.len);
+	physics_radix_sort<Physics_Interval, &Physics_Interval::start>(intervals, scratch->sorted_intervals.items);
+}
+
+static void physics_sort_intervals(Physics_Scratch* scratch, Slice<Physics_Interval> intervals)
+{
+	u32 descents = 0;
+	for (u32 i = 1; i < intervals.len; ++i) {
+		if (intervals[i - 1].start > intervals[i].start) {
+			++descents;
 		}
+	}
 
-		v2 start = circle.start;
-		v2 end = circle.start + circle.duration * circle.velocity;
+	if (!descents) {
+		return;
+	}
+	if (descents <= PHYSICS_NEARLY_SORTED_MAX_DESCENTS) {
+		physics_insertion_sort_intervals(intervals);
+		return;
+	}
+	physics_radix_sort_intervals(scratch, intervals);
+}
 
-		Physics_Interval interval_x;
-		interval_x.object_index = i;
-		interval_x.start = min(start.x, end.x) - circle.radius;
-		interval_x.end = max(start.x, end.x) + circle.radius;
-		linear_circle_x_intervals.append(interval_x);
+static void physics_get_intervals(Physics_Static_Line* line, Physics_Interval* x, Physics_Interval* y)
+{
+	x->start = min_f32(line->start.x, line->end.x);
+	x->end   = max_f32(line->start.x, line->end.x);
+	y->start = min_f32(line->start.y, line->end.y);
+	y->end   = max_f32(line->start.y, line->end.y);
+}
 
-		Physics_Interval interval_y;
-		interval_y.object_index = i;
-		interval_y.start = min(start.y, end.y) - circle.radius;
-		interval_y.end = max(start.y, end.y) + circle.radius;
-		linear_circle_y_intervals.append(interval_y);
-		++i;
+static void physics_get_intervals(Physics_Static_Circle* circle, Physics_Interval* x, Physics_Interval* y)
+{
+	x->start = circle->pos.x - circle->radius;
+	x->end   = circle->pos.x + circle->radius;
+	y->start = circle->pos.y - circle->radius;
+	y->end   = circle->pos.y + circle->radius;
+}
+
+static void physics_get_intervals(Physics_Linear_Circle* circle, Physics_Interval* x, Physics_Interval* y)
+{
+	v2 start = circle->start;
+	v2 end = circle->start + circle->duration * circle->velocity;
+	x->start = min_f32(start.x, end.x) - circle->radius;
+	x->end   = max_f32(start.x, end.x) + circle->radius;
+	y->start = min_f32(start.y, end.y) - circle->radius;
+	y->end   = max_f32(start.y, end.y) + circle->radius;
+}
+
+// Rebuilds an interval list keeping last frame's order -- live objects stay
+// where they were (with their interval refreshed if dirty) and objects not
+// yet in the list go on the end, so the list is usually almost sorted.
+template <typename T>
+static void physics_rebuild_intervals(Physics_Scratch*                scratch,
+                                      Slice<T>                        objects,
+                                      u8                              axis,
+                                      Output_Buffer<Physics_Interval> intervals)
+{
+	auto &listed = scratch->listed;
+	ASSERT(objects.len <= PHYSICS_MAX_OBJECTS_PER_TYPE);
+	listed.reset();
+
+	Physics_Interval x, y;
+	u32 num_kept = 0;
+	for (u32 i = 0; i < *intervals.len; ++i) {
+		Physics_Interval interval = intervals[i];
+		if (interval.object_index >= objects.len) {
+			continue;
+		}
+		T *object = &objects[interval.object_index];
+		if (!object->owner_id) {
+			continue;
+		}
+		if (object->dirty) {
+			physics_get_intervals(object, &x, &y);
+			interval.start = axis ? y.start : x.start;
+			interval.end   = axis ? y.end   : x.end;
+		}
+		listed.set(interval.object_index);
+		intervals[num_kept++] = interval;
+	}
+	*intervals.len = num_kept;
+
+	for (u32 i = 0; i < objects.len; ++i) {
+		if (!objects[i].owner_id || listed.get(i)) {
+			continue;
+		}
+		physics_get_intervals(&objects[i], &x, &y);
+		Physics_Interval interval;
+		interval.object_index = i;
+		interval.start = axis ? y.start : x.start;
+		interval.end   = axis ? y.end   : x.end;
+		intervals.append(interval);
 	}
 
-	physics_sort_intervals(static_line_x_intervals);
-	physics_sort_intervals(static_line_y_intervals);
-	physics_sort_intervals(static_circle_x_intervals);
-	physics_sort_intervals(static_circle_y_intervals);
-	physics_sort_intervals(linear_circle_x_intervals);
-	physics_sort_intervals(linear_circle_y_intervals);
+	physics_sort_intervals(scratch, Slice<Physics_Interval>(intervals.base, *intervals.len));
 }
 
-struct Physics_Interval_Overlap
+void physics_start_frame(Physics_Context* context)
 {
-	u32 object_index_1;
-	u32 object_index_2;
-};
+	USE_PHYSICS_CONTEXT(context)
+
+	Physics_Scratch *scratch = &context->scratch;
+
+	physics_rebuild_intervals<Physics_Static_Line>(scratch, static_lines, 0, static_line_x_intervals);
+	physics_rebuild_intervals<Physics_Static_Line>(scratch, static_lines, 1, static_line_y_intervals);
+	physics_rebuild_intervals<Physics_Static_Circle>(scratch, static_circles, 0, static_circle_x_intervals);
+	physics_rebuild_intervals<Physics_Static_Circle>(scratch, static_circles, 1, static_circle_y_intervals);
+	physics_rebuild_intervals<Physics_Linear_Circle>(scratch, linear_circles, 0, linear_circle_x_intervals);
+	physics_rebuild_intervals<Physics_Linear_Circle>(scratch, linear_circles, 1, linear_circle_y_intervals);
+}
 
 static void physics_get_overlapping_intervals_1d(Slice<Physics_Interval>                 intervals_1,
                                                  Slice<Physics_Interval>                 intervals_2,
@@ -280,12 +516,12 @@ static void physics_get_overlapping_intervals_1d(Slice<Physics_Interval>
 		return;
 	}
 
-	Max_Length_Array<Physics_Interval, 1024> cur_intervals_1;
-	Max_Length_Array<Physics_Interval, 1024> cur_intervals_2;
+	Max_Length_Array<Physics_Interval, PHYSICS_MAX_OBJECTS_PER_TYPE> cur_intervals_1;
+	Max_Length_Array<Physics_Interval, PHYSICS_MAX_OBJECTS_PER_TYPE> cur_intervals_2;
 	cur_intervals_1.reset();
 	cur_intervals_2.reset();
 
-	f32 cur_x = min(intervals_1[0].start, intervals_1[0].start);
+	f32 cur_x = min_f32(intervals_1[0].start, intervals_2[0].start);
 
 	u32 idx_1 = 0, idx_2 = 0;
 	while (idx_1 < intervals_1.len || idx_2 < intervals_2.len) {
@@ -318,7 +554,7 @@ static void physics_get_overlapping_intervals_1d(Slice<Physics_Interval>
 				}
 				continue;
 			}
-			next_x = min(next_x, interval_2.start);
+			next_x = min_f32(next_x, interval_2.start);
 		}
 		for (u32 i = 0; i < cur_intervals_1.len; ) {
 			if (cur_intervals_1[i].end < next_x) {
@@ -338,51 +574,60 @@ static void physics_get_overlapping_intervals_1d(Slice<Physics_Interval>
 	}
 }
 
-static void physics_get_overlapping_intervals_2d(Slice<Physics_Interval> x_intervals_1,
+static void physics_get_overlapping_intervals_2d(Physics_Scratch*        scratch,
+                                                 Slice<Physics_Interval> x_intervals_1,
                                                  Slice<Physics_Interval> y_intervals_1,
                                                  Slice<Physics_Interval> x_intervals_2,
-                                                 Slice<Physics_Interval> y_intervals_2,
-                                                 Output_Buffer<Physics_Interval_Overlap> output)
+                                                 Slice<Physics_Interval> y_intervals_2)
 {
-	ASSERT(PHYSICS_MAX_STATIC_LINES == PHYSICS_MAX_LINEAR_CIRCLES);
-	ASSERT(PHYSICS_MAX_LINEAR_CIRCLES == PHYSICS_MAX_STATIC_CIRCLES);
-	ASSERT(PHYSICS_MAX_STATIC_CIRCLES == 1024);
-
-	struct Tmp_Stuff
-	{
-		Max_Length_Array<Physics_Interval_Overlap, 1024*1024> overlapping_x_intervals;
-		Max_Length_Array<Physics_Interval_Overlap, 1024*1024> overlapping_y_intervals;
-		u64 overlaps[1024 * 1024 / 64] = {};
-	} *stuff = NULL;
+	u32 n1 = x_intervals_1.len;
+	u32 n2 = x_intervals_2.len;
+	ASSERT(n1 == y_intervals_1.len);
+	ASSERT(n2 == y_intervals_2.len);
+
+	// the interval lists may be subsets, so the bitmap is indexed by object
+	// index rather than by position in the lists
+	u32 stride = 0, num_rows = 0;
+	for (u32 i = 0; i < n1; ++i) {
+		num_rows = max_u32(num_rows, x_intervals_1[i].object_index + 1);
+	}
+	for (u32 i = 0; i < n2; ++i) {
+		stride = max_u32(stride, x_intervals_2[i].object_index + 1);
+	}
 
-	stuff = (Tmp_Stuff*)malloc(sizeof(*stuff));
+	auto &overlapping_x_intervals = scratch->overlapping_x_intervals;
+	auto &overlapping_y_intervals = scratch->overlapping_y_intervals;
+	auto &output = scratch->overlaps;
 
-	auto &overlapping_x_intervals = stuff->overlapping_x_intervals;
-	auto &overlapping_y_intervals = stuff->overlapping_y_intervals;
-	auto &overlaps = stuff->overlaps;
-	memset(&overlaps, 0, sizeof(overlaps));
+	physics_reserve(&overlapping_x_intervals, n1 * n2);
+	physics_reserve(&overlapping_y_intervals, n1 * n2);
+	physics_reserve(&output, n1 * n2);
+	physics_reserve_overlap_bits(scratch, num_rows * stride);
+	u64 *overlaps = scratch->overlap_bits;
 
 	physics_get_overlapping_intervals_1d(x_intervals_1, x_intervals_2, overlapping_x_intervals);
 	physics_get_overlapping_intervals_1d(y_intervals_1, y_intervals_2, overlapping_y_intervals);
 
-	output.reset();
-
-
 	for (u32 i = 0; i < overlapping_x_intervals.len; ++i) {
 		auto overlap_x = overlapping_x_intervals[i];
-		u32 idx = overlap_x.object_index_1 * 1024 + overlap_x.object_index_2;
-		overlaps[idx / 64] |= 1 << (idx % 64);
+		u32 idx = overlap_x.object_index_1 * stride + overlap_x.object_index_2;
+		overlaps[idx / 64] |= (u64)1 << (idx % 64);
 	}
 
 	for (u32 i = 0; i < overlapping_y_intervals.len; ++i) {
 		auto overlap_y = overlapping_y_intervals[i];
-		u32 idx = overlap_y.object_index_1 * 1024 + overlap_y.object_index_2;
-		if (overlaps[idx / 64] & (1 << (idx % 64))) {
-			output.append(overlap_y);
+		u32 idx = overlap_y.object_index_1 * stride + overlap_y.object_index_2;
+		if (overlaps[idx / 64] & ((u64)1 << (idx % 64))) {
+			output.items[output.len++] = overlap_y;
 		}
 	}
 
-	free(stuff);
+	// clear only the words we touched so the bitmap never needs a full memset
+	for (u32 i = 0; i < overlapping_x_intervals.len; ++i) {
+		auto overlap_x = overlapping_x_intervals[i];
+		u32 idx = overlap_x.object_index_1 * stride + overlap_x.object_index_2;
+		overlaps[idx / 64] = 0;
+	}
 }
 
 static u8 physics_get_linear_circle_origin_intersection_times(v2 p, v2 v, f32 r, f32* t_0, f32* t_1)
@@ -414,6 +659,517 @@ static u8 physics_get_linear_circle_origin_intersection_times(v2 p, v2 v, f32 r,
 	return 1;
 }
 
+// SIMD versions of the above. Each kernel handles a batch of PHYSICS_BATCH_SIZE
+// object pairs laid out SoA and returns a lane mask of which pairs intersect.
+// Lanes past the batch length hold zeroes and their results are ignored.
+
+#define PHYSICS_BATCH_SIZE 4
+
+static inline b32x4 physics_get_linear_circle_origin_intersection_times_x4(f32x4 p_x, f32x4 p_y,
+                                                                          f32x4 v_x, f32x4 v_y,
+                                                                          f32x4 r,
+                                                                          f32x4* t_0, f32x4* t_1)
+{
+	f32x4 zero = f32x4_set1(0.0f);
+	f32x4 one  = f32x4_set1(1.0f);
+
+	f32x4 r_squared = r*r;
+	f32x4 speed_squared = v_x*v_x + v_y*v_y;
+	b32x4 moving = speed_squared != zero;
+	// non-moving lanes are masked off, this just keeps them finite
+	speed_squared = select(moving, speed_squared, one);
+
+	f32x4 t_closest = -(v_x*p_x + v_y*p_y) / speed_squared;
+	f32x4 u_x = p_x + t_closest * v_x;
+	f32x4 u_y = p_y + t_closest * v_y;
+	f32x4 a_squared = u_x*u_x + u_y*u_y;
+
+	f32x4 b_squared = f32x4_max(r_squared - a_squared, zero);
+	f32x4 t_offset = f32x4_sqrt(b_squared / speed_squared);
+	*t_0 = t_closest - t_offset;
+	*t_1 = t_closest + t_offset;
+
+	return moving & (a_squared < r_squared);
+}
+
+struct Physics_Static_Line_Linear_Circle_Batch
+{
+	u32 len;
+	f32 line_start_x[PHYSICS_BATCH_SIZE];
+	f32 line_start_y[PHYSICS_BATCH_SIZE];
+	f32 line_dir_x[PHYSICS_BATCH_SIZE];
+	f32 line_dir_y[PHYSICS_BATCH_SIZE];
+	f32 circle_start_x[PHYSICS_BATCH_SIZE];
+	f32 circle_start_y[PHYSICS_BATCH_SIZE];
+	f32 velocity_x[PHYSICS_BATCH_SIZE];
+	f32 velocity_y[PHYSICS_BATCH_SIZE];
+	f32 radius[PHYSICS_BATCH_SIZE];
+	f32 start_time[PHYSICS_BATCH_SIZE];
+	f32 min_time[PHYSICS_BATCH_SIZE];
+	f32 max_time[PHYSICS_BATCH_SIZE];
+	Physics_Static_Line   *lines[PHYSICS_BATCH_SIZE];
+	Physics_Linear_Circle *circles[PHYSICS_BATCH_SIZE];
+};
+
+struct Physics_Static_Circle_Linear_Circle_Batch
+{
+	u32 len;
+	f32 p_x[PHYSICS_BATCH_SIZE];
+	f32 p_y[PHYSICS_BATCH_SIZE];
+	f32 v_x[PHYSICS_BATCH_SIZE];
+	f32 v_y[PHYSICS_BATCH_SIZE];
+	f32 radius[PHYSICS_BATCH_SIZE];
+	f32 start_time[PHYSICS_BATCH_SIZE];
+	f32 min_time[PHYSICS_BATCH_SIZE];
+	f32 max_time[PHYSICS_BATCH_SIZE];
+	Physics_Static_Circle *static_circles[PHYSICS_BATCH_SIZE];
+	Physics_Linear_Circle *linear_circles[PHYSICS_BATCH_SIZE];
+};
+
+struct Physics_Linear_Circle_Linear_Circle_Batch
+{
+	u32 len;
+	f32 p_x[PHYSICS_BATCH_SIZE];
+	f32 p_y[PHYSICS_BATCH_SIZE];
+	f32 v_x[PHYSICS_BATCH_SIZE];
+	f32 v_y[PHYSICS_BATCH_SIZE];
+	f32 radius[PHYSICS_BATCH_SIZE];
+	f32 start_time[PHYSICS_BATCH_SIZE];
+	f32 min_time[PHYSICS_BATCH_SIZE];
+	f32 max_time[PHYSICS_BATCH_SIZE];
+	Physics_Linear_Circle *circles_1[PHYSICS_BATCH_SIZE];
+	Physics_Linear_Circle *circles_2[PHYSICS_BATCH_SIZE];
+};
+
+static void physics_emit_penetration_events(Output_Buffer<Physics_Event> output,
+                                            Physics_Event*               event,
+                                            Physics_Event_Type           begin_type,
+                                            Physics_Event_Type           end_type,
+                                            f32 t_begin, f32 t_end,
+                                            f32 min_time, f32 max_time)
+{
+	if (min_time <= t_begin && t_begin < max_time) {
+		event->type = begin_type;
+		event->time = t_begin;
+		output.append(*event);
+	}
+	if (min_time <= t_end && t_end < max_time) {
+		event->type = end_type;
+		event->time = t_end;
+		output.append(*event);
+	}
+}
+
+#ifndef PHYSICS_FIXED_POINT
+
+static void physics_flush(Physics_Static_Line_Linear_Circle_Batch* batch,
+                          Output_Buffer<Physics_Event>             output)
+{
+	if (!batch->len) {
+		return;
+	}
+
+	f32x4 zero = f32x4_set1(0.0f);
+	f32x4 one  = f32x4_set1(1.0f);
+
+	// work in the line's frame -- line runs from (0, 0) to (len, 0). The frame
+	// is built from the unit direction directly rather than atan2 + rotation.
+	f32x4 d_x = f32x4_load(batch->line_dir_x);
+	f32x4 d_y = f32x4_load(batch->line_dir_y);
+	f32x4 len = f32x4_sqrt(d_x*d_x + d_y*d_y);
+	b32x4 has_len = len != zero;
+	f32x4 dir_x = select(has_len, d_x / select(has_len, len, one), one);
+	f32x4 dir_y = select(has_len, d_y / select(has_len, len, one), zero);
+
+	f32x4 q_x = f32x4_load(batch->circle_start_x) - f32x4_load(batch->line_start_x);
+	f32x4 q_y = f32x4_load(batch->circle_start_y) - f32x4_load(batch->line_start_y);
+	f32x4 w_x = f32x4_load(batch->velocity_x);
+	f32x4 w_y = f32x4_load(batch->velocity_y);
+
+	f32x4 p_x = dir_x*q_x + dir_y*q_y;
+	f32x4 p_y = dir_x*q_y - dir_y*q_x;
+	f32x4 v_x = dir_x*w_x + dir_y*w_y;
+	f32x4 v_y = dir_x*w_y - dir_y*w_x;
+	f32x4 r   = f32x4_load(batch->radius);
+
+	// parallel case
+	b32x4 parallel = v_y == zero;
+	b32x4 parallel_hit = f32x4_max(p_y, -p_y) <= r;
+	f32x4 offset = f32x4_sqrt(f32x4_max(r*r - p_y*p_y, zero));
+	f32x4 t_left  = (-p_x - offset) / v_x;
+	f32x4 t_right = (-p_x + len + offset) / v_x;
+	f32x4 parallel_t_begin = f32x4_min(t_left, t_right);
+	f32x4 parallel_t_end   = f32x4_max(t_left, t_right);
+
+	// crossing the line's band |y| < r
+	f32x4 safe_v_y = select(parallel, one, v_y);
+	f32x4 t_0 = (r - p_y) / safe_v_y;
+	f32x4 t_1 = (-r - p_y) / safe_v_y;
+	f32x4 t_begin = f32x4_min(t_0, t_1);
+	f32x4 t_end   = f32x4_max(t_0, t_1);
+
+	// if the band is entered/left beyond an end of the segment then the end
+	// cap circles give the times instead
+	f32x4 left_t_0, left_t_1, right_t_0, right_t_1;
+	b32x4 left_hit = physics_get_linear_circle_origin_intersection_times_x4(p_x, p_y, v_x, v_y, r,
+	                                                                        &left_t_0, &left_t_1);
+	b32x4 right_hit = physics_get_linear_circle_origin_intersection_times_x4(p_x - len, p_y, v_x, v_y, r,
+	                                                                         &right_t_0, &right_t_1);
+
+	f32x4 p_begin_x = p_x + t_begin * v_x;
+	b32x4 begin_left  = p_begin_x < zero;
+	b32x4 begin_right = p_begin_x > len;
+	f32x4 p_end_x = p_x + t_end * v_x;
+	b32x4 end_left  = p_end_x < zero;
+	b32x4 end_right = p_end_x > len;
+
+	b32x4 all = zero == zero;
+	b32x4 begin_hit = select(begin_left, left_hit, select(begin_right, right_hit, all));
+	b32x4 end_hit   = select(end_left,   left_hit, select(end_right,   right_hit, all));
+	t_begin = select(begin_left, left_t_0, select(begin_right, right_t_0, t_begin));
+	t_end   = select(end_left,   left_t_1, select(end_right,   right_t_1, t_end));
+
+	f32x4 start_time = f32x4_load(batch->start_time);
+	t_begin = select(parallel, parallel_t_begin, t_begin) + start_time;
+	t_end   = select(parallel, parallel_t_end,   t_end)   + start_time;
+
+	u32 parallel_mask  = lane_mask(parallel);
+	u32 hit_mask       = (lane_mask(parallel_hit) & parallel_mask)
+	                   | (lane_mask(begin_hit)    & ~parallel_mask);
+	u32 end_hit_mask   = lane_mask(end_hit) | parallel_mask;
+	(void)end_hit_mask; // only read by the ASSERT below
+
+	f32 t_begins[PHYSICS_BATCH_SIZE], t_ends[PHYSICS_BATCH_SIZE];
+	f32x4_store(t_begins, t_begin);
+	f32x4_store(t_ends, t_end);
+
+	Physics_Event event = {};
+	for (u32 i = 0; i < batch->len; ++i) {
+		if (!(hit_mask & (1 << i))) {
+			continue;
+		}
+		// if we _began_ penetrating we should end it somewhere
+		ASSERT(end_hit_mask & (1 << i));
+		event.sl_lc.line   = batch->lines[i];
+		event.sl_lc.circle = batch->circles[i];
+		physics_emit_penetration_events(output, &event,
+		                                PHYSICS_EVENT_BEGIN_PENETRATE_SL_LC,
+		                                PHYSICS_EVENT_END_PENETRATE_SL_LC,
+		                                t_begins[i], t_ends[i],
+		                                batch->min_time[i], batch->max_time[i]);
+	}
+
+	memset(batch, 0, sizeof(*batch));
+}
+
+static void physics_flush(Physics_Static_Circle_Linear_Circle_Batch* batch,
+                          Output_Buffer<Physics_Event>               output)
+{
+	if (!batch->len) {
+		return;
+	}
+
+	f32x4 t_begin, t_end;
+	b32x4 hit = physics_get_linear_circle_origin_intersection_times_x4(f32x4_load(batch->p_x),
+	                                                                   f32x4_load(batch->p_y),
+	                                                                   f32x4_load(batch->v_x),
+	                                                                   f32x4_load(batch->v_y),
+	                                                                   f32x4_load(batch->radius),
+	                                                                   &t_begin, &t_end);
+	f32x4 start_time = f32x4_load(batch->start_time);
+	t_begin = f32x4_max(t_begin + start_time, f32x4_load(batch->min_time));
+	t_end = t_end + start_time;
+
+	u32 hit_mask = lane_mask(hit);
+	u32 begin_mask = lane_mask(t_begin <= t_end);
+
+	f32 t_begins[PHYSICS_BATCH_SIZE], t_ends[PHYSICS_BATCH_SIZE];
+	f32x4_store(t_begins, t_begin);
+	f32x4_store(t_ends, t_end);
+
+	Physics_Event event = {};
+	for (u32 i = 0; i < batch->len; ++i) {
+		if (!(hit_mask & (1 << i))) {
+			continue;
+		}
+		event.sc_lc.static_circle = batch->static_circles[i];
+		event.sc_lc.linear_circle = batch->linear_circles[i];
+		// a begin after the end means we were already inside at min_time
+		f32 t_begin_penetrate = (begin_mask & (1 << i)) ? t_begins[i] : batch->max_time[i];
+		physics_emit_penetration_events(output, &event,
+		                                PHYSICS_EVENT_BEGIN_PENETRATE_SC_LC,
+		                                PHYSICS_EVENT_END_PENETRATE_SC_LC,
+		                                t_begin_penetrate, t_ends[i],
+		                                batch->min_time[i], batch->max_time[i]);
+	}
+
+	memset(batch, 0, sizeof(*batch));
+}
+
+static void physics_flush(Physics_Linear_Circle_Linear_Circle_Batch* batch,
+                          Output_Buffer<Physics_Event>               output)
+{
+	if (!batch->len) {
+		return;
+	}
+
+	f32x4 t_begin, t_end;
+	b32x4 hit = physics_get_linear_circle_origin_intersection_times_x4(f32x4_load(batch->p_x),
+	                                                                   f32x4_load(batch->p_y),
+	                                                                   f32x4_load(batch->v_x),
+	                                                                   f32x4_load(batch->v_y),
+	                                                                   f32x4_load(batch->radius),
+	                                                                   &t_begin, &t_end);
+	f32x4 start_time = f32x4_load(batch->start_time);
+	t_begin = t_begin + start_time;
+	t_end = t_end + start_time;
+
+	u32 hit_mask = lane_mask(hit);
+
+	f32 t_begins[PHYSICS_BATCH_SIZE], t_ends[PHYSICS_BATCH_SIZE];
+	f32x4_store(t_begins, t_begin);
+	f32x4_store(t_ends, t_end);
+
+	Physics_Event event = {};
+	for (u32 i = 0; i < batch->len; ++i) {
+		if (!(hit_mask & (1 << i))) {
+			continue;
+		}
+		event.lc_lc.circle_1 = batch->circles_1[i];
+		event.lc_lc.circle_2 = batch->circles_2[i];
+		physics_emit_penetration_events(output, &event,
+		                                PHYSICS_EVENT_BEGIN_PENETRATE_LC_LC,
+		                                PHYSICS_EVENT_END_PENETRATE_LC_LC,
+		                                t_begins[i], t_ends[i],
+		                                batch->min_time[i], batch->max_time[i]);
+	}
+
+	memset(batch, 0, sizeof(*batch));
+}
+
+#else
+
+// Fixed point versions of the flushes for PHYSICS_FIXED_POINT builds. They work
+// straight from the objects rather than the precomputed f32 lanes so nothing
+// before the final event times goes through float maths, and event times only
+// depend on the object data -- not the compiler or the SIMD path.
+
+struct Physics_Fixed_Linear_Circle
+{
+	fixed start_x, start_y;
+	fixed velocity_x, velocity_y;
+	fixed radius;
+	fixed start_time;
+};
+
+static Physics_Fixed_Linear_Circle physics_to_fixed(Physics_Linear_Circle* circle)
+{
+	Physics_Fixed_Linear_Circle result;
+	result.start_x    = f32_to_fixed(circle->start.x);
+	result.start_y    = f32_to_fixed(circle->start.y);
+	result.velocity_x = f32_to_fixed(circle->velocity.x);
+	result.velocity_y = f32_to_fixed(circle->velocity.y);
+	result.radius     = f32_to_fixed(circle->radius);
+	result.start_time = f32_to_fixed(circle->start_time);
+	return result;
+}
+
+// Squares and dot products are kept at double the fraction bits and only
+// narrowed by taking square roots, so slow circles don't lose all precision.
+// |t_closest * v| <= |p| so nothing here overflows for sane positions.
+static u8 physics_get_linear_circle_origin_intersection_times_fixed(fixed p_x, fixed p_y,
+                                                                    fixed v_x, fixed v_y,
+                                                                    fixed r,
+                                                                    fixed* t_0, fixed* t_1)
+{
+	fixed speed_squared = v_x*v_x + v_y*v_y;
+	if (!speed_squared) {
+		return 0;
+	}
+
+	fixed t_closest = -((v_x*p_x + v_y*p_y) << FIXED_POINT_FRACTION_BITS) / speed_squared;
+	fixed u_x = p_x + fixed_mul(t_closest, v_x);
+	fixed u_y = p_y + fixed_mul(t_closest, v_y);
+	fixed a_squared = u_x*u_x + u_y*u_y;
+	fixed r_squared = r*r;
+	if (a_squared >= r_squared) {
+		return 0;
+	}
+
+	fixed b = (fixed)isqrt_u64((u64)(r_squared - a_squared));
+	fixed speed = (fixed)isqrt_u64((u64)speed_squared);
+	fixed t_offset = fixed_div(b, speed);
+	*t_0 = t_closest - t_offset;
+	*t_1 = t_closest + t_offset;
+
+	return 1;
+}
+
+static u8 physics_get_static_line_linear_circle_times_fixed(Physics_Static_Line*   line,
+                                                            Physics_Linear_Circle* circle,
+                                                            f32* t_begin_out, f32* t_end_out)
+{
+	Physics_Fixed_Linear_Circle c = physics_to_fixed(circle);
+	fixed line_start_x = f32_to_fixed(line->start.x);
+	fixed line_start_y = f32_to_fixed(line->start.y);
+	fixed d_x = f32_to_fixed(line->end.x) - line_start_x;
+	fixed d_y = f32_to_fixed(line->end.y) - line_start_y;
+
+	// line's frame, as in the f32 version
+	fixed len = (fixed)isqrt_u64((u64)(d_x*d_x + d_y*d_y));
+	fixed dir_x = FIXED_ONE, dir_y = 0;
+	if (len) {
+		dir_x = fixed_div(d_x, len);
+		dir_y = fixed_div(d_y, len);
+	}
+
+	fixed q_x = c.start_x - line_start_x;
+	fixed q_y = c.start_y - line_start_y;
+	fixed p_x = fixed_mul(dir_x, q_x) + fixed_mul(dir_y, q_y);
+	fixed p_y = fixed_mul(dir_x, q_y) - fixed_mul(dir_y, q_x);
+	fixed v_x = fixed_mul(dir_x, c.velocity_x) + fixed_mul(dir_y, c.velocity_y);
+	fixed v_y = fixed_mul(dir_x, c.velocity_y) - fixed_mul(dir_y, c.velocity_x);
+	fixed r = c.radius;
+
+	fixed t_begin, t_end;
+	if (!v_y) {
+		// parallel case -- not moving at all never starts or stops penetrating
+		if (fixed_abs(p_y) > r || !v_x) {
+			return 0;
+		}
+		fixed offset = (fixed)isqrt_u64((u64)(r*r - p_y*p_y));
+		fixed t_left  = fixed_div(-p_x - offset, v_x);
+		fixed t_right = fixed_div(-p_x + len + offset, v_x);
+		t_begin = fixed_min(t_left, t_right);
+		t_end   = fixed_max(t_left, t_right);
+	} else {
+		fixed t_0 = fixed_div(r - p_y, v_y);
+		fixed t_1 = fixed_div(-r - p_y, v_y);
+		t_begin = fixed_min(t_0, t_1);
+		t_end   = fixed_max(t_0, t_1);
+
+		fixed left_t_0 = 0, left_t_1 = 0, right_t_0 = 0, right_t_1 = 0;
+		u8 left_hit = physics_get_linear_circle_origin_intersection_times_fixed(p_x, p_y, v_x, v_y, r,
+		                                                                        &left_t_0, &left_t_1);
+		u8 right_hit = physics_get_linear_circle_origin_intersection_times_fixed(p_x - len, p_y, v_x, v_y, r,
+		                                                                         &right_t_0, &right_t_1);
+
+		fixed p_begin_x = p_x + fixed_mul(t_begin, v_x);
+		if (p_begin_x < 0) {
+			if (!left_hit) {
+				return 0;
+			}
+			t_begin = left_t_0;
+		} else if (p_begin_x > len) {
+			if (!right_hit) {
+				return 0;
+			}
+			t_begin = right_t_0;
+		}
+
+		// the end cap should always be hit here, but rounding can put a grazing
+		// exit just past the end of the line, in which case keep the band time
+		fixed p_end_x = p_x + fixed_mul(t_end, v_x);
+		if (p_end_x < 0 && left_hit) {
+			t_end = left_t_1;
+		} else if (p_end_x > len && right_hit) {
+			t_end = right_t_1;
+		}
+	}
+
+	*t_begin_out = fixed_to_f32(t_begin + c.start_time);
+	*t_end_out = fixed_to_f32(t_end + c.start_time);
+	return 1;
+}
+
+static void physics_flush(Physics_Static_Line_Linear_Circle_Batch* batch,
+                          Output_Buffer<Physics_Event>             output)
+{
+	Physics_Event event = {};
+	for (u32 i = 0; i < batch->len; ++i) {
+		f32 t_begin, t_end;
+		if (!physics_get_static_line_linear_circle_times_fixed(batch->lines[i], batch->circles[i],
+		                                                       &t_begin, &t_end)) {
+			continue;
+		}
+		event.sl_lc.line   = batch->lines[i];
+		event.sl_lc.circle = batch->circles[i];
+		physics_emit_penetration_events(output, &event,
+		                                PHYSICS_EVENT_BEGIN_PENETRATE_SL_LC,
+		                                PHYSICS_EVENT_END_PENETRATE_SL_LC,
+		                                t_begin, t_end,
+		                                batch->min_time[i], batch->max_time[i]);
+	}
+	batch->len = 0;
+}
+
+static void physics_flush(Physics_Static_Circle_Linear_Circle_Batch* batch,
+                          Output_Buffer<Physics_Event>               output)
+{
+	Physics_Event event = {};
+	for (u32 i = 0; i < batch->len; ++i) {
+		Physics_Static_Circle *static_circle = batch->static_circles[i];
+		Physics_Linear_Circle *linear_circle = batch->linear_circles[i];
+		Physics_Fixed_Linear_Circle c = physics_to_fixed(linear_circle);
+
+		fixed t_0, t_1;
+		if (!physics_get_linear_circle_origin_intersection_times_fixed(c.start_x - f32_to_fixed(static_circle->pos.x),
+		                                                               c.start_y - f32_to_fixed(static_circle->pos.y),
+		                                                               c.velocity_x, c.velocity_y,
+		                                                               c.radius + f32_to_fixed(static_circle->radius),
+		                                                               &t_0, &t_1)) {
+			continue;
+		}
+		f32 t_begin = max_f32(fixed_to_f32(t_0 + c.start_time), batch->min_time[i]);
+		f32 t_end = fixed_to_f32(t_1 + c.start_time);
+
+		event.sc_lc.static_circle = static_circle;
+		event.sc_lc.linear_circle = linear_circle;
+		// a begin after the end means we were already inside at min_time
+		physics_emit_penetration_events(output, &event,
+		                                PHYSICS_EVENT_BEGIN_PENETRATE_SC_LC,
+		                                PHYSICS_EVENT_END_PENETRATE_SC_LC,
+		                                t_begin <= t_end ? t_begin : batch->max_time[i], t_end,
+		                                batch->min_time[i], batch->max_time[i]);
+	}
+	batch->len = 0;
+}
+
+static void physics_flush(Physics_Linear_Circle_Linear_Circle_Batch* batch,
+                          Output_Buffer<Physics_Event>               output)
+{
+	Physics_Event event = {};
+	for (u32 i = 0; i < batch->len; ++i) {
+		Physics_Fixed_Linear_Circle c_1 = physics_to_fixed(batch->circles_1[i]);
+		Physics_Fixed_Linear_Circle c_2 = physics_to_fixed(batch->circles_2[i]);
+
+		fixed t_start_offset = c_2.start_time - c_1.start_time;
+		fixed p_x = c_1.start_x - (c_2.start_x - fixed_mul(t_start_offset, c_2.velocity_x));
+		fixed p_y = c_1.start_y - (c_2.start_y - fixed_mul(t_start_offset, c_2.velocity_y));
+
+		fixed t_0, t_1;
+		if (!physics_get_linear_circle_origin_intersection_times_fixed(p_x, p_y,
+		                                                               c_1.velocity_x - c_2.velocity_x,
+		                                                               c_1.velocity_y - c_2.velocity_y,
+		                                                               c_1.radius + c_2.radius,
+		                                                               &t_0, &t_1)) {
+			continue;
+		}
+
+		event.lc_lc.circle_1 = batch->circles_1[i];
+		event.lc_lc.circle_2 = batch->circles_2[i];
+		physics_emit_penetration_events(output, &event,
+		                                PHYSICS_EVENT_BEGIN_PENETRATE_LC_LC,
+		                                PHYSICS_EVENT_END_PENETRATE_LC_LC,
+		                                fixed_to_f32(t_0 + c_1.start_time),
+		                                fixed_to_f32(t_1 + c_1.start_time),
+		                                batch->min_time[i], batch->max_time[i]);
+	}
+	batch->len = 0;
+}
+
+#endif
+
 void physics_debug_draw(Physics_Context* context, f32 time)
 {
 	USE_PHYSICS_CONTEXT(context)
@@ -422,11 +1178,17 @@ void physics_debug_draw(Physics_Context* context, f32 time)
 
 	for (u32 i = 0; i < static_lines.len; ++i) {
 		Physics_Static_Line line = static_lines[i];
+		if (!line.owner_id) {
+			continue;
+		}
 		debug_draw_world_line(line.start, line.end);
 	}
 
 	for (u32 i = 0; i < static_circles.len; ++i) {
 		Physics_Static_Circle circle = static_circles[i];
+		if (!circle.owner_id) {
+			continue;
+		}
 		debug_draw_world_circle(circle.pos, circle.radius);
 	}
 
@@ -435,7 +1197,7 @@ void physics_debug_draw(Physics_Context* context, f32 time)
 	for (u32 i = 0; i < linear_circles.len; ++i) {
 		Physics_Linear_Circle circle = linear_circles[i];
 		f32 dt = time - circle.start_time;
-		if (dt < 0.0f || dt > circle.duration) {
+		if (!circle.owner_id || dt < 0.0f || dt > circle.duration) {
 			continue;
 		}
 		v2 p = circle.start + dt * circle.velocity;
@@ -444,185 +1206,101 @@ void physics_debug_draw(Physics_Context* context, f32 time)
 	}
 }
 
-void physics_compute_collisions(Physics_Context* context,
-                                f32 start_time,
-                                Output_Buffer<Physics_Event> output)
+static void physics_compute_static_line_linear_circle_collisions(Physics_Context*             context,
+                                                                 f32                          start_time,
+                                                                 Slice<Physics_Interval>      line_x_intervals,
+                                                                 Slice<Physics_Interval>      line_y_intervals,
+                                                                 Slice<Physics_Interval>      circle_x_intervals,
+                                                                 Slice<Physics_Interval>      circle_y_intervals,
+                                                                 u8                           skip_dirty_circles,
+                                                                 Output_Buffer<Physics_Event> output)
 {
 	USE_PHYSICS_CONTEXT(context)
 
-	struct Tmp_Stuff
-	{
-		Max_Length_Array<Physics_Interval_Overlap, 1024*1024> overlaps;
-	} *stuff = NULL;
-
-	stuff = (Tmp_Stuff*)malloc(sizeof(*stuff));
-
-	auto &overlaps = stuff->overlaps;
-
-	output.reset();
-	Physics_Event event = {};
-
-	// add linear circle start/end events
-	for (u32 i = 0; i < linear_circles.len; ++i) {
-		Physics_Linear_Circle *circle = &linear_circles[i];
-		if (circle->start_time > start_time) {
-			event.type = PHYSICS_EVENT_LC_START;
-			event.time = circle->start_time;
-			event.lc.circle = circle;
-			output.append(event);
-		}
-		if (circle->start_time + circle->duration > start_time) {
-			event.type = PHYSICS_EVENT_LC_END;
-			event.time = circle->start_time + circle->duration;
-			event.lc.circle = circle;
-			output.append(event);
-		}
-	}
+	Physics_Scratch *scratch = &context->scratch;
+	auto &overlaps = scratch->overlaps;
 
-	// static line linear circle collisions
-	physics_get_overlapping_intervals_2d(static_line_x_intervals,
-	                                     static_line_y_intervals,
-	                                     linear_circle_x_intervals,
-	                                     linear_circle_y_intervals,
-	                                     overlaps);
+	physics_get_overlapping_intervals_2d(scratch,
+	                                     line_x_intervals,
+	                                     line_y_intervals,
+	                                     circle_x_intervals,
+	                                     circle_y_intervals);
+	Physics_Static_Line_Linear_Circle_Batch sl_lc_batch = {};
 	for (u32 i = 0; i < overlaps.len; ++i) {
 		Physics_Interval_Overlap overlap = overlaps[i];
 		Physics_Static_Line *line = &static_lines[overlap.object_index_1];
 		Physics_Linear_Circle *circle = &linear_circles[overlap.object_index_2];
 
-		if (!physics_do_objects_collide(line, circle)) {
+		if (skip_dirty_circles && circle->dirty) {
 			continue;
 		}
 
-		f32 min_time = max(start_time, circle->start_time);
-		f32 max_time = circle->start_time + circle->duration;
-		if (min_time >= max_time) {
+		if (!physics_do_objects_collide(line, circle)) {
 			continue;
 		}
 
-		v2 d = line->end - line->start;
-		f32 theta = atan2f(d.y, d.x);
-
-		f32 len = sqrtf(d.x*d.x + d.y*d.y);
-		m2 m = m2::rotation(-theta);
-
-		v2 p = m * (circle->start - line->start);
-		v2 v = m * circle->velocity;
-		f32 r = circle->radius;
-
-		// handle parallel case separately
-		if (!v.y) {
-			if (fabsf(p.y) > r) {
-				continue;
-			}
-			f32 r_squared = r*r;
-			f32 offset = sqrtf(r_squared - p.y*p.y);
-			f32 t_left = (-p.x - offset) / v.x;
-			f32 t_right = (-p.x + len + offset) / v.x;
-			f32 t_begin_penetrate = min(t_left, t_right);
-			f32 t_end_penetrate = max(t_left, t_right);
-			if (min_time <= t_begin_penetrate && t_begin_penetrate < max_time) {
-				event.type =  PHYSICS_EVENT_BEGIN_PENETRATE_SL_LC;
-				event.time = t_begin_penetrate;
-				event.sl_lc.line   = line;
-				event.sl_lc.circle = circle;
-				output.append(event);
-			}
-			if (min_time <= t_end_penetrate && t_end_penetrate < max_time) {
-				event.type = PHYSICS_EVENT_END_PENETRATE_SL_LC;
-				event.time = t_end_penetrate;
-				event.sl_lc.line   = line;
-				event.sl_lc.circle = circle;
-				output.append(event);
-			}
+		f32 min_time = max_f32(start_time, circle->start_time);
+		f32 max_time = circle->start_time + circle->duration;
+		if (min_time >= max_time) {
 			continue;
 		}
 
-		f32 t_0 = (r - p.y) / v.y;
-		f32 t_1 = (- r - p.y) / v.y;
-		f32 t_begin_penetrate = min(t_0, t_1);
-		f32 t_end_penetrate = max(t_0, t_1);
-
-		f32 p_begin_x = p.x + t_begin_penetrate * v.x;
-
-		if (p_begin_x < 0.0f) {
-			f32 t_begin, t_end;
-			if (!physics_get_linear_circle_origin_intersection_times(p, v, r,
-			                                                         &t_begin,
-			                                                         &t_end)) {
-				continue;
-			}
-			t_begin_penetrate = t_begin;
-		} else if (p_begin_x > len) {
-			v2 p_dash = p;
-			p_dash.x -= len;
-			f32 t_begin, t_end;
-			if (!physics_get_linear_circle_origin_intersection_times(p_dash, v, r,
-			                                                         &t_begin,
-			                                                         &t_end)) {
-				continue;
-			}
-			t_begin_penetrate = t_begin;
-		}
-
-		f32 p_end_x = p.x + t_end_penetrate * v.x;
-		if (p_end_x < 0.0f) {
-			f32 t_begin, t_end;
-			if (!physics_get_linear_circle_origin_intersection_times(p, v, r,
-			                                                         &t_begin,
-			                                                         &t_end)) {
-				// if we're here we _began_ penetrating, so should end it somewhere
-				ASSERT(0);
-			}
-			t_end_penetrate = t_end;
-		} else if (p_end_x > len) {
-			v2 p_dash = p;
-			p_dash.x -= len;
-			f32 t_begin, t_end;
-			if (!physics_get_linear_circle_origin_intersection_times(p_dash, v, r,
-			                                                         &t_begin,
-			                                                         &t_end)) {
-				// same as above
-				ASSERT(0);
-			}
-			t_end_penetrate = t_end;
+		u32 lane = sl_lc_batch.len++;
+		sl_lc_batch.line_start_x[lane]   = line->start.x;
+		sl_lc_batch.line_start_y[lane]   = line->start.y;
+		sl_lc_batch.line_dir_x[lane]     = line->end.x - line->start.x;
+		sl_lc_batch.line_dir_y[lane]     = line->end.y - line->start.y;
+		sl_lc_batch.circle_start_x[lane] = circle->start.x;
+		sl_lc_batch.circle_start_y[lane] = circle->start.y;
+		sl_lc_batch.velocity_x[lane]     = circle->velocity.x;
+		sl_lc_batch.velocity_y[lane]     = circle->velocity.y;
+		sl_lc_batch.radius[lane]         = circle->radius;
+		sl_lc_batch.start_time[lane]     = circle->start_time;
+		sl_lc_batch.min_time[lane]       = min_time;
+		sl_lc_batch.max_time[lane]       = max_time;
+		sl_lc_batch.lines[lane]          = line;
+		sl_lc_batch.circles[lane]        = circle;
+		if (sl_lc_batch.len == PHYSICS_BATCH_SIZE) {
+			physics_flush(&sl_lc_batch, output);
 		}
+	}
+	physics_flush(&sl_lc_batch, output);
+}
 
-		t_begin_penetrate += circle->start_time;
-		t_end_penetrate += circle->start_time;
+static void physics_compute_static_circle_linear_circle_collisions(Physics_Context*             context,
+                                                                   f32                          start_time,
+                                                                   Slice<Physics_Interval>      static_x_intervals,
+                                                                   Slice<Physics_Interval>      static_y_intervals,
+                                                                   Slice<Physics_Interval>      linear_x_intervals,
+                                                                   Slice<Physics_Interval>      linear_y_intervals,
+                                                                   u8                           skip_dirty_linear_circles,
+                                                                   Output_Buffer<Physics_Event> output)
+{
+	USE_PHYSICS_CONTEXT(context)
 
-		if (min_time <= t_begin_penetrate && t_begin_penetrate < max_time) {
-			event.type =  PHYSICS_EVENT_BEGIN_PENETRATE_SL_LC;
-			event.time = t_begin_penetrate;
-			event.sl_lc.line   = line;
-			event.sl_lc.circle = circle;
-			output.append(event);
-		}
-		if (min_time <= t_end_penetrate && t_end_penetrate < max_time) {
-			event.type = PHYSICS_EVENT_END_PENETRATE_SL_LC;
-			event.time = t_end_penetrate;
-			event.sl_lc.line   = line;
-			event.sl_lc.circle = circle;
-			output.append(event);
-		}
-	}
+	Physics_Scratch *scratch = &context->scratch;
+	auto &overlaps = scratch->overlaps;
 
-	// static circle linear circle collisions
-	physics_get_overlapping_intervals_2d(static_circle_x_intervals,
-	                                     static_circle_y_intervals,
-	                                     linear_circle_x_intervals,
-	                                     linear_circle_y_intervals,
-	                                     overlaps);
+	physics_get_overlapping_intervals_2d(scratch,
+	                                     static_x_intervals,
+	                                     static_y_intervals,
+	                                     linear_x_intervals,
+	                                     linear_y_intervals);
+	Physics_Static_Circle_Linear_Circle_Batch sc_lc_batch = {};
 	for (u32 i = 0; i < overlaps.len; ++i) {
 		Physics_Interval_Overlap overlap = overlaps[i];
 		Physics_Static_Circle *static_circle = &static_circles[overlap.object_index_1];
 		Physics_Linear_Circle *linear_circle = &linear_circles[overlap.object_index_2];
 
+		if (skip_dirty_linear_circles && linear_circle->dirty) {
+			continue;
+		}
+
 		if (!physics_do_objects_collide(static_circle, linear_circle)) {
 			continue;
 		}
 
-		f32 min_time = max(start_time, linear_circle->start_time);
+		f32 min_time = max_f32(start_time, linear_circle->start_time);
 		f32 max_time = linear_circle->start_time + linear_circle->duration;
 		if (min_time >= max_time) {
 			continue;
@@ -630,58 +1308,61 @@ void physics_compute_collisions(Physics_Context* context,
 
 		v2 p = linear_circle->start - static_circle->pos;
 		v2 v = linear_circle->velocity;
-		f32 r = linear_circle->radius + static_circle->radius;
 
-		f32 t_begin_penetrate, t_end_penetrate;
-		if (!physics_get_linear_circle_origin_intersection_times(p, v, r,
-		                                                         &t_begin_penetrate,
-		                                                         &t_end_penetrate)) {
-			continue;
+		u32 lane = sc_lc_batch.len++;
+		sc_lc_batch.p_x[lane]            = p.x;
+		sc_lc_batch.p_y[lane]            = p.y;
+		sc_lc_batch.v_x[lane]            = v.x;
+		sc_lc_batch.v_y[lane]            = v.y;
+		sc_lc_batch.radius[lane]         = linear_circle->radius + static_circle->radius;
+		sc_lc_batch.start_time[lane]     = linear_circle->start_time;
+		sc_lc_batch.min_time[lane]       = min_time;
+		sc_lc_batch.max_time[lane]       = max_time;
+		sc_lc_batch.static_circles[lane] = static_circle;
+		sc_lc_batch.linear_circles[lane] = linear_circle;
+		if (sc_lc_batch.len == PHYSICS_BATCH_SIZE) {
+			physics_flush(&sc_lc_batch, output);
 		}
+	}
+	physics_flush(&sc_lc_batch, output);
+}
 
-		t_begin_penetrate += linear_circle->start_time;
-		t_begin_penetrate = max(t_begin_penetrate, min_time);
-		t_end_penetrate += linear_circle->start_time;
+static void physics_compute_linear_circle_linear_circle_collisions(Physics_Context*             context,
+                                                                   f32                          start_time,
+                                                                   Output_Buffer<Physics_Event> output)
+{
+	USE_PHYSICS_CONTEXT(context)
 
-		if (t_begin_penetrate <= t_end_penetrate) {
-			if (min_time <= t_begin_penetrate && t_begin_penetrate < max_time) {
-				event.type =  PHYSICS_EVENT_BEGIN_PENETRATE_SC_LC;
-				event.time = t_begin_penetrate;
-				event.sc_lc.static_circle = static_circle;
-				event.sc_lc.linear_circle = linear_circle;
-				output.append(event);
-			}
-		}
-		if (min_time <= t_end_penetrate && t_end_penetrate < max_time) {
-			event.type = PHYSICS_EVENT_END_PENETRATE_SC_LC;
-			event.time = t_end_penetrate;
-			event.sc_lc.static_circle = static_circle;
-			event.sc_lc.linear_circle = linear_circle;
-			output.append(event);
-		}
-	}
+	Physics_Scratch *scratch = &context->scratch;
+	auto &overlaps = scratch->overlaps;
 
-	// linear circle linear circle collisions
-	physics_get_overlapping_intervals_2d(linear_circle_x_intervals,
-	                                     linear_circle_y_intervals,
+	// all circles against dirty circles -- a pair of two dirty circles shows
+	// up twice so only keep it the way round with the lower index first
+	physics_get_overlapping_intervals_2d(scratch,
 	                                     linear_circle_x_intervals,
 	                                     linear_circle_y_intervals,
-	                                     overlaps);
+	                                     dirty_linear_circle_x_intervals,
+	                                     dirty_linear_circle_y_intervals);
+	Physics_Linear_Circle_Linear_Circle_Batch lc_lc_batch = {};
 	for (u32 i = 0; i < overlaps.len; ++i) {
 		Physics_Interval_Overlap overlap = overlaps[i];
-		// filter out duplicate/self-self overlaps
-		if (overlap.object_index_1 >= overlap.object_index_2) {
+		u32 idx_1 = overlap.object_index_1;
+		u32 idx_2 = overlap.object_index_2;
+		if (idx_1 == idx_2) {
 			continue;
 		}
-		Physics_Linear_Circle *circle_1 = &linear_circles[overlap.object_index_1];
-		Physics_Linear_Circle *circle_2 = &linear_circles[overlap.object_index_2];
+		if (linear_circles[idx_1].dirty && idx_1 > idx_2) {
+			continue;
+		}
+		Physics_Linear_Circle *circle_1 = &linear_circles[min_u32(idx_1, idx_2)];
+		Physics_Linear_Circle *circle_2 = &linear_circles[max_u32(idx_1, idx_2)];
 
 		if (!physics_do_objects_collide(circle_1, circle_2)) {
 			continue;
 		}
 
-		f32 min_time = max(max(start_time, circle_1->start_time), circle_2->start_time);
-		f32 max_time = min(circle_1->start_time + circle_1->duration,
+		f32 min_time = max_f32(max_f32(start_time, circle_1->start_time), circle_2->start_time);
+		f32 max_time = min_f32(circle_1->start_time + circle_1->duration,
 		                   circle_2->start_time + circle_2->duration);
 
 		if (min_time >= max_time) {
@@ -689,72 +1370,292 @@ void physics_compute_collisions(Physics_Context* context,
 		}
 
 		f32 t_start_offset = circle_2->start_time - circle_1->start_time;
-		v2 p = circle_1->start - (circle_2->start + t_start_offset * circle_2->velocity);
+		v2 p = circle_1->start - (circle_2->start - t_start_offset * circle_2->velocity);
 		v2 v = circle_1->velocity - circle_2->velocity;
-		f32 r = circle_1->radius + circle_2->radius;
 
-		f32 t_begin_penetrate, t_end_penetrate;
-		if (!physics_get_linear_circle_origin_intersection_times(p, v, r,
-		                                                         &t_begin_penetrate,
-		                                                         &t_end_penetrate)) {
+		u32 lane = lc_lc_batch.len++;
+		lc_lc_batch.p_x[lane]        = p.x;
+		lc_lc_batch.p_y[lane]        = p.y;
+		lc_lc_batch.v_x[lane]        = v.x;
+		lc_lc_batch.v_y[lane]        = v.y;
+		lc_lc_batch.radius[lane]     = circle_1->radius + circle_2->radius;
+		lc_lc_batch.start_time[lane] = circle_1->start_time;
+		lc_lc_batch.min_time[lane]   = min_time;
+		lc_lc_batch.max_time[lane]   = max_time;
+		lc_lc_batch.circles_1[lane]  = circle_1;
+		lc_lc_batch.circles_2[lane]  = circle_2;
+		if (lc_lc_batch.len == PHYSICS_BATCH_SIZE) {
+			physics_flush(&lc_lc_batch, output);
+		}
+	}
+	physics_flush(&lc_lc_batch, output);
+}
+
+template <typename T>
+static void physics_collect_dirty_intervals(Slice<Physics_Interval>        intervals,
+                                            Slice<T>                       objects,
+                                            Output_Buffer<Physics_Interval> output)
+{
+	output.reset();
+	for (u32 i = 0; i < intervals.len; ++i) {
+		Physics_Interval interval = intervals[i];
+		if (objects[interval.object_index].dirty) {
+			output.append(interval);
+		}
+	}
+}
+
+static u8 physics_event_is_dirty(Physics_Event* event)
+{
+	switch (event->type) {
+	case PHYSICS_EVENT_BEGIN_PENETRATE_SL_LC:
+	case PHYSICS_EVENT_END_PENETRATE_SL_LC:
+		return event->sl_lc.line->dirty || event->sl_lc.circle->dirty;
+	case PHYSICS_EVENT_BEGIN_PENETRATE_SC_LC:
+	case PHYSICS_EVENT_END_PENETRATE_SC_LC:
+		return event->sc_lc.static_circle->dirty || event->sc_lc.linear_circle->dirty;
+	case PHYSICS_EVENT_BEGIN_PENETRATE_LC_LC:
+	case PHYSICS_EVENT_END_PENETRATE_LC_LC:
+		return event->lc_lc.circle_1->dirty || event->lc_lc.circle_2->dirty;
+	case PHYSICS_EVENT_LC_START:
+	case PHYSICS_EVENT_LC_END:
+		return event->lc.circle->dirty;
+	case PHYSICS_EVENT_NONE:
+		// never queued
+		ASSERT(0);
+		break;
+	}
+	return 1;
+}
+
+// Recomputes events only for pairs involving a dirty object and merges them
+// into the queue. Pairs of clean objects keep
+// their events -- recomputing them from a later start_time can only drop
+// events at or before start_time, which have already been processed.
+// physics_start_frame must have been called since objects were last changed.
+void physics_update_collisions(Physics_Context*     context,
+                               f32                  start_time,
+                               Physics_Event_Queue* queue)
+{
+	USE_PHYSICS_CONTEXT(context)
+
+	Physics_Scratch *scratch = &context->scratch;
+
+	physics_collect_dirty_intervals<Physics_Static_Line>(static_line_x_intervals, static_lines,
+	                                                     dirty_static_line_x_intervals);
+	physics_collect_dirty_intervals<Physics_Static_Line>(static_line_y_intervals, static_lines,
+	                                                     dirty_static_line_y_intervals);
+	physics_collect_dirty_intervals<Physics_Static_Circle>(static_circle_x_intervals, static_circles,
+	                                                       dirty_static_circle_x_intervals);
+	physics_collect_dirty_intervals<Physics_Static_Circle>(static_circle_y_intervals, static_circles,
+	                                                       dirty_static_circle_y_intervals);
+	physics_collect_dirty_intervals<Physics_Linear_Circle>(linear_circle_x_intervals, linear_circles,
+	                                                       dirty_linear_circle_x_intervals);
+	physics_collect_dirty_intervals<Physics_Linear_Circle>(linear_circle_y_intervals, linear_circles,
+	                                                       dirty_linear_circle_y_intervals);
+
+	// drop past and stale events -- order is kept so the queue stays sorted
+	auto &events = queue->events;
+	u32 num_kept = 0;
+	for (u32 i = queue->head; i < events.len; ++i) {
+		Physics_Event *event = &events[i];
+		if (event->time < start_time || physics_event_is_dirty(event)) {
 			continue;
 		}
+		events[num_kept++] = *event;
+	}
+	events.len = num_kept;
+	queue->head = 0;
 
-		t_begin_penetrate += circle_1->start_time;
-		t_end_penetrate += circle_1->start_time;
+	physics_reserve(&scratch->events, events.max_size);
+	Output_Buffer<Physics_Event> output = scratch->events;
+	Physics_Event event = {};
 
-		if (min_time <= t_begin_penetrate && t_begin_penetrate < max_time) {
-			event.type =  PHYSICS_EVENT_BEGIN_PENETRATE_LC_LC;
-			event.time = t_begin_penetrate;
-			event.lc_lc.circle_1 = circle_1;
-			event.lc_lc.circle_1 = circle_2;
+	// add linear circle start/end events
+	for (u32 i = 0; i < dirty_linear_circle_x_intervals.len; ++i) {
+		Physics_Linear_Circle *circle = &linear_circles[dirty_linear_circle_x_intervals[i].object_index];
+		if (circle->start_time > start_time) {
+			event.type = PHYSICS_EVENT_LC_START;
+			event.time = circle->start_time;
+			event.lc.circle = circle;
 			output.append(event);
 		}
-		if (min_time <= t_end_penetrate && t_end_penetrate < max_time) {
-			event.type = PHYSICS_EVENT_END_PENETRATE_LC_LC;
-			event.time = t_end_penetrate;
-			event.lc_lc.circle_1 = circle_1;
-			event.lc_lc.circle_1 = circle_2;
+		if (circle->start_time + circle->duration > start_time) {
+			event.type = PHYSICS_EVENT_LC_END;
+			event.time = circle->start_time + circle->duration;
+			event.lc.circle = circle;
 			output.append(event);
 		}
 	}
 
-	// sort events
+	// every line against dirty circles, then dirty lines against the rest
+	physics_compute_static_line_linear_circle_collisions(context, start_time,
+	                                                     static_line_x_intervals,
+	                                                     static_line_y_intervals,
+	                                                     dirty_linear_circle_x_intervals,
+	                                                     dirty_linear_circle_y_intervals,
+	                                                     0, output);
+	physics_compute_static_line_linear_circle_collisions(context, start_time,
+	                                                     dirty_static_line_x_intervals,
+	                                                     dirty_static_line_y_intervals,
+	                                                     linear_circle_x_intervals,
+	                                                     linear_circle_y_intervals,
+	                                                     1, output);
+
+	physics_compute_static_circle_linear_circle_collisions(context, start_time,
+	                                                       static_circle_x_intervals,
+	                                                       static_circle_y_intervals,
+	                                                       dirty_linear_circle_x_intervals,
+	                                                       dirty_linear_circle_y_intervals,
+	                                                       0, output);
+	physics_compute_static_circle_linear_circle_collisions(context, start_time,
+	                                                       dirty_static_circle_x_intervals,
+	                                                       dirty_static_circle_y_intervals,
+	                                                       linear_circle_x_intervals,
+	                                                       linear_circle_y_intervals,
+	                                                       1, output);
+
+	physics_compute_linear_circle_linear_circle_collisions(context, start_time, output);
+
+	// sort new events -- stable, so ties keep the order they were found in
 	u32 output_len = *output.len;
-	for (u32 i = 1; i < output_len; ++i) {
-		Physics_Event event = output[i];
-		u32 j = i;
-		for ( ; j; --j) {
-			if (output[j - 1].time <= event.time) {
-				break;
-			}
-			output[j] = output[j - 1];
+	physics_reserve(&scratch->sorted_events, output_len);
+	physics_radix_sort<Physics_Event, &Physics_Event::time>(Slice<Physics_Event>(output.base, output_len),
+	                                                        scratch->sorted_events.items);
+
+	// merge from the back so it can be done in place
+	ASSERT(num_kept + output_len <= events.max_size);
+	u32 idx_old = num_kept, idx_new = output_len, idx_out = num_kept + output_len;
+	events.len = idx_out;
+	while (idx_new) {
+		if (idx_old && events.items[idx_old - 1].time > output[idx_new - 1].time) {
+			events.items[--idx_out] = events.items[--idx_old];
+		} else {
+			events.items[--idx_out] = output[--idx_new];
+		}
+	}
+
+	for (u32 i = 0; i < static_lines.len; ++i) {
+		static_lines[i].dirty = 0;
+	}
+	for (u32 i = 0; i < static_circles.len; ++i) {
+		static_circles[i].dirty = 0;
+	}
+	for (u32 i = 0; i < linear_circles.len; ++i) {
+		linear_circles[i].dirty = 0;
+	}
+}
+
+void physics_compute_collisions(Physics_Context*     context,
+                                f32                  start_time,
+                                Physics_Event_Queue* queue)
+{
+	USE_PHYSICS_CONTEXT(context)
+
+	for (u32 i = 0; i < static_lines.len; ++i) {
+		static_lines[i].dirty = 1;
+	}
+	for (u32 i = 0; i < static_circles.len; ++i) {
+		static_circles[i].dirty = 1;
+	}
+	for (u32 i = 0; i < linear_circles.len; ++i) {
+		linear_circles[i].dirty = 1;
+	}
+
+	queue->head = 0;
+	queue->events.reset();
+	physics_update_collisions(context, start_time, queue);
+}
+
+// Skips events before time and returns the run of events at exactly time.
+Slice<Physics_Event> physics_events_at(Physics_Event_Queue* queue, f32 time)
+{
+	auto &events = queue->events;
+	while (queue->head < events.len && events[queue->head].time < time) {
+		++queue->head;
+	}
+	u32 end = queue->head;
+	while (end < events.len && events[end].time == time) {
+		++end;
+	}
+	return Slice<Physics_Event>(&events.items[queue->head], end - queue->head);
+}
+
+// Gets the time of the first event after time, returns whether there is one.
+u8 physics_next_event_time(Physics_Event_Queue* queue, f32 time, f32* next_time)
+{
+	auto &events = queue->events;
+	for (u32 i = queue->head; i < events.len; ++i) {
+		if (events[i].time > time) {
+			*next_time = events[i].time;
+			return 1;
 		}
-		output[j] = event;
 	}
+	return 0;
+}
 
-	free(stuff);
+// Objects are never moved once added since events point at them. Removed
+// objects are left in place with a zero owner_id and their slots are reused,
+// but only once physics_update_collisions has cleared their dirty flag -- until
+// then the queue can still hold events for the old object, and handing out the
+// slot would attribute those to the new one.
+
+void physics_remove_object(Physics_Object_Meta_Data* object)
+{
+	object->owner_id = 0;
+	object->dirty = 1;
+}
+
+void physics_mark_changed(Physics_Object_Meta_Data* object)
+{
+	object->dirty = 1;
+}
+
+template <typename T, u32 size>
+static T* physics_add_object(Max_Length_Array<T, size>* objects, T object)
+{
+	object.dirty = 1;
+	for (u32 i = 0; i < objects->len; ++i) {
+		T *slot = &objects->items[i];
+		if (!slot->owner_id && !slot->dirty) {
+			*slot = object;
+			return slot;
+		}
+	}
+	T *slot = objects->append();
+	*slot = object;
+	return slot;
+}
+
+Physics_Static_Line* physics_add_static_line(Physics_Context* context, Physics_Static_Line line)
+{
+	return physics_add_object(&context->static_lines, line);
+}
+
+Physics_Static_Circle* physics_add_static_circle(Physics_Context* context, Physics_Static_Circle circle)
+{
+	return physics_add_object(&context->static_circles, circle);
+}
+
+Physics_Linear_Circle* physics_add_linear_circle(Physics_Context* context, Physics_Linear_Circle circle)
+{
+	return physics_add_object(&context->linear_circles, circle);
 }
 
 void physics_remove_objects_for_entity(Physics_Context* context, Entity_ID entity_id)
 {
 	USE_PHYSICS_CONTEXT(context)
 
-	for (u32 i = 0; i < static_circles.len; ) {
+	for (u32 i = 0; i < static_circles.len; ++i) {
 		if (static_circles[i].owner_id == entity_id) {
-			// TODO -- update collision objects here?
-			static_circles.remove(i);
-			continue;
+			physics_remove_object(&static_circles[i]);
 		}
-		++i;
 	}
 
-	for (u32 i = 0; i < linear_circles.len; ) {
+	for (u32 i = 0; i < linear_circles.len; ++i) {
 		if (linear_circles[i].owner_id == entity_id) {
-			linear_circles.remove(i);
-			continue;
+			physics_remove_object(&linear_circles[i]);
 		}
-		++i;
 	}
 }
 
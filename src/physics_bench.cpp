@@ -0,0 +1,840 @@
+// Standalone physics benchmark and brute force oracle.
+//
+// Builds randomised scenes of wall segments, entities and fireball/lightning
+// projectiles, times physics_start_frame/physics_compute_collisions over a
+// range of object counts and checks the events against an O(n^2) pass over
+// every pair of objects which doesn't use the broadphase or the SIMD kernels.
+//
+// The scenes are also copied into scalar::, the same code built with simd.h's
+// plain loop fallback, and its events have to match the SIMD ones exactly.
+//
+// Built with PHYSICS_FIXED_POINT it checks the fixed point path instead, with the
+// oracle timing each pair with the same fixed point maths so the events have to
+// match exactly, and the hash column can be compared between machines to check
+// it is deterministic.
+//
+// usage: physics_bench [seed] [--no-check]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+#include "prelude.h"
+#include "containers.hpp"
+#include "jfg_math.h"
+
+#define PHYSICS_MAX_STATIC_LINES   8192
+#define PHYSICS_MAX_STATIC_CIRCLES 8192
+#define PHYSICS_MAX_LINEAR_CIRCLES 8192
+#define PHYSICS_MAX_EVENTS         (1024 * 1024)
+
+// A second copy of the collision code with simd.h's plain loop fallback, so the
+// SSE2 flushes can be checked against it. physics.h's dependencies have to be
+// included first so only simd.h and physics.h end up in the namespace.
+#include <math.h>
+#include "fixed_point.h"
+#include "types.h"
+#include "debug_draw_world.h"
+namespace scalar {
+#define JFG_SIMD_SCALAR
+#include "simd.h"
+#include "physics.h"
+#undef JFG_SIMD_SCALAR
+#undef JFG_SIMD_SSE2
+}
+#undef JFG_SIMD_H
+#undef PHYSICS_H
+
+#include "physics.h"
+
+#define BENCH_MAP_SIZE       250
+
+// The f32 oracle builds the line's frame with atan2 and a rotation so its times
+// can be off in the last few bits. The fixed point oracle does the same
+// arithmetic as the fixed point flushes, so there it has to match exactly.
+#ifdef PHYSICS_FIXED_POINT
+#define BENCH_TIME_TOLERANCE 0.0f
+#else
+#define BENCH_TIME_TOLERANCE 1e-3f
+#endif
+
+// same masks as game_simulate_actions
+#define MASK_WALL       (1 << 0)
+#define MASK_ENTITY     (1 << 1)
+#define MASK_PROJECTILE (1 << 2)
+
+#define ENTITY_ID_BENCH_WALLS 1
+
+// -----------------------------------------------------------------------------
+// scene generation
+
+struct Bench_Random
+{
+	u64 state;
+};
+
+static u32 bench_rand_u32(Bench_Random* r)
+{
+	// xorshift64*
+	r->state ^= r->state >> 12;
+	r->state ^= r->state << 25;
+	r->state ^= r->state >> 27;
+	return (u32)((r->state * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+static f32 bench_rand_f32(Bench_Random* r, f32 low, f32 high)
+{
+	return low + (high - low) * ((f32)(bench_rand_u32(r) >> 8) / (f32)(1 << 24));
+}
+
+static void bench_add_wall_tile(Physics_Context* context, v2 p)
+{
+	Physics_Static_Line line = {};
+	line.owner_id = ENTITY_ID_BENCH_WALLS;
+	line.collision_mask = MASK_WALL;
+	line.collides_with_mask = MASK_PROJECTILE;
+
+	v2 corners[4] = {
+		p + v2(-0.5f, -0.5f),
+		p + v2( 0.5f, -0.5f),
+		p + v2( 0.5f,  0.5f),
+		p + v2(-0.5f,  0.5f),
+	};
+	for (u32 i = 0; i < 4; ++i) {
+		if (context->static_lines.len == PHYSICS_MAX_STATIC_LINES) {
+			return;
+		}
+		line.start = corners[i];
+		line.end = corners[(i + 1) % 4];
+		context->static_lines.append(line);
+	}
+}
+
+// roughly 40% wall segments, 20% entities, 40% projectiles
+static void bench_make_scene(Physics_Context* context, u32 num_objects, u64 seed)
+{
+	Bench_Random r = { seed * 0x9E3779B97F4A7C15ULL + 1 };
+	physics_reset(context);
+
+	u32 num_lines = num_objects * 2 / 5;
+	u32 num_entities = num_objects / 5;
+	u32 num_projectiles = num_objects - num_lines - num_entities;
+
+	// walls as straight runs of tiles
+	while (context->static_lines.len < num_lines) {
+		u32 x = 1 + bench_rand_u32(&r) % (BENCH_MAP_SIZE - 12);
+		u32 y = 1 + bench_rand_u32(&r) % (BENCH_MAP_SIZE - 12);
+		u32 len = 3 + bench_rand_u32(&r) % 8;
+		u8 vertical = bench_rand_u32(&r) & 1;
+		for (u32 i = 0; i < len && context->static_lines.len < num_lines; ++i) {
+			v2 p = vertical ? v2((f32)x, (f32)(y + i)) : v2((f32)(x + i), (f32)y);
+			bench_add_wall_tile(context, p);
+		}
+	}
+	context->static_lines.len = num_lines;
+
+	Entity_ID next_id = 2;
+	for (u32 i = 0; i < num_entities; ++i) {
+		Physics_Static_Circle circle = {};
+		circle.owner_id = next_id++;
+		circle.collision_mask = MASK_ENTITY;
+		circle.collides_with_mask = MASK_PROJECTILE;
+		circle.pos = v2((f32)(1 + bench_rand_u32(&r) % (BENCH_MAP_SIZE - 2)),
+		                (f32)(1 + bench_rand_u32(&r) % (BENCH_MAP_SIZE - 2)));
+		circle.radius = 0.4f;
+		context->static_circles.append(circle);
+	}
+
+	// fireball offshoot bursts of 20 and the odd lightning bolt, a few of
+	// which are entities moving so projectiles hit moving circles too
+	u32 num_added = 0;
+	while (num_added < num_projectiles) {
+		Physics_Linear_Circle circle = {};
+		circle.owner_id = next_id++;
+		circle.collision_mask = MASK_PROJECTILE;
+		circle.collides_with_mask = MASK_WALL | MASK_ENTITY;
+		circle.start = v2(bench_rand_f32(&r, 2.0f, BENCH_MAP_SIZE - 2.0f),
+		                  bench_rand_f32(&r, 2.0f, BENCH_MAP_SIZE - 2.0f));
+		circle.start_time = bench_rand_f32(&r, 0.0f, 1.0f);
+
+		u32 kind = bench_rand_u32(&r) % 8;
+		if (kind == 0) {
+			f32 angle = bench_rand_f32(&r, 0.0f, 2.0f * PI_F32);
+			circle.velocity = 10.0f * v2(cosf(angle), sinf(angle));
+			circle.radius = 0.1f;
+			circle.duration = 1.0f;
+			context->linear_circles.append(circle);
+			++num_added;
+		} else if (kind == 1) {
+			circle.collision_mask = MASK_ENTITY;
+			circle.collides_with_mask = MASK_PROJECTILE;
+			v2 dirs[4] = { v2(1.0f, 0.0f), v2(-1.0f, 0.0f), v2(0.0f, 1.0f), v2(0.0f, -1.0f) };
+			circle.velocity = 5.0f * dirs[bench_rand_u32(&r) % 4];
+			circle.radius = 0.4f;
+			circle.duration = 0.2f;
+			context->linear_circles.append(circle);
+			++num_added;
+		} else {
+			circle.radius = 0.1f;
+			circle.duration = 0.5f;
+			for (u32 i = 0; i < 5 && num_added < num_projectiles; ++i) {
+				f32 angle = PI_F32 * ((f32)i / 5.0f) / 2.0f;
+				f32 ca = cosf(angle);
+				f32 sa = sinf(angle);
+				v2 dirs[4] = { v2(ca, sa), v2(-sa, ca), v2(-ca, -sa), v2(sa, -ca) };
+				for (u32 j = 0; j < 4 && num_added < num_projectiles; ++j) {
+					circle.velocity = 5.0f * dirs[j];
+					context->linear_circles.append(circle);
+					++num_added;
+				}
+			}
+		}
+	}
+}
+
+// -----------------------------------------------------------------------------
+// brute force oracle
+
+struct Bench_Event
+{
+	u32 type;
+	u32 object_1;
+	u32 object_2;
+	f32 time;
+};
+
+static int bench_compare_events(const void* a, const void* b)
+{
+	const Bench_Event *e1 = (const Bench_Event*)a;
+	const Bench_Event *e2 = (const Bench_Event*)b;
+	if (e1->type != e2->type) {
+		return e1->type < e2->type ? -1 : 1;
+	}
+	if (e1->object_1 != e2->object_1) {
+		return e1->object_1 < e2->object_1 ? -1 : 1;
+	}
+	if (e1->object_2 != e2->object_2) {
+		return e1->object_2 < e2->object_2 ? -1 : 1;
+	}
+	if (e1->time != e2->time) {
+		return e1->time < e2->time ? -1 : 1;
+	}
+	return 0;
+}
+
+// templated so it works for scalar:: contexts too
+template <typename Context, typename Event>
+static Bench_Event bench_event(Context* context, Event* pe)
+{
+	Bench_Event e = {};
+	e.type = pe->type;
+	e.time = pe->time;
+	switch (e.type) {
+	case PHYSICS_EVENT_BEGIN_PENETRATE_SL_LC:
+	case PHYSICS_EVENT_END_PENETRATE_SL_LC:
+		e.object_1 = (u32)(pe->sl_lc.line - context->static_lines.items);
+		e.object_2 = (u32)(pe->sl_lc.circle - context->linear_circles.items);
+		break;
+	case PHYSICS_EVENT_BEGIN_PENETRATE_SC_LC:
+	case PHYSICS_EVENT_END_PENETRATE_SC_LC:
+		e.object_1 = (u32)(pe->sc_lc.static_circle - context->static_circles.items);
+		e.object_2 = (u32)(pe->sc_lc.linear_circle - context->linear_circles.items);
+		break;
+	case PHYSICS_EVENT_BEGIN_PENETRATE_LC_LC:
+	case PHYSICS_EVENT_END_PENETRATE_LC_LC:
+		e.object_1 = (u32)(pe->lc_lc.circle_1 - context->linear_circles.items);
+		e.object_2 = (u32)(pe->lc_lc.circle_2 - context->linear_circles.items);
+		break;
+	case PHYSICS_EVENT_LC_START:
+	case PHYSICS_EVENT_LC_END:
+		e.object_1 = (u32)(pe->lc.circle - context->linear_circles.items);
+		break;
+	default:
+		ASSERT(0);
+	}
+	return e;
+}
+
+static void bench_push_penetration(Bench_Event* events, u32* num_events,
+                                   Physics_Event_Type begin_type, Physics_Event_Type end_type,
+                                   u32 object_1, u32 object_2,
+                                   f32 t_begin, f32 t_end, u8 has_begin,
+                                   f32 min_time, f32 max_time)
+{
+	if (has_begin && min_time <= t_begin && t_begin < max_time) {
+		events[(*num_events)++] = { (u32)begin_type, object_1, object_2, t_begin };
+	}
+	if (min_time <= t_end && t_end < max_time) {
+		events[(*num_events)++] = { (u32)end_type, object_1, object_2, t_end };
+	}
+}
+
+// Times a pair of objects begin and end penetrating, as absolute times. Built
+// with PHYSICS_FIXED_POINT these use the fixed point maths, since no f32
+// calculation gives the same times as it -- comparing against one could only
+// ever be approximate, and grazing contacts land either side of touching.
+
+#ifndef PHYSICS_FIXED_POINT
+
+// atan2 and a rotation into the line's frame the way the collision code
+// originally did
+static u8 bench_static_line_times(Physics_Static_Line*   line,
+                                  Physics_Linear_Circle* circle,
+                                  f32* t_begin_out, f32* t_end_out)
+{
+	v2 d = line->end - line->start;
+	f32 len = sqrtf(d.x*d.x + d.y*d.y);
+	m2 m = m2::rotation(-atan2f(d.y, d.x));
+
+	v2 p = m * (circle->start - line->start);
+	v2 v = m * circle->velocity;
+	f32 r = circle->radius;
+	f32 t_begin, t_end;
+
+	if (!v.y) {
+		if (fabsf(p.y) > r) {
+			return 0;
+		}
+		f32 offset = sqrtf(r*r - p.y*p.y);
+		f32 t_left = (-p.x - offset) / v.x;
+		f32 t_right = (-p.x + len + offset) / v.x;
+		t_begin = min_f32(t_left, t_right);
+		t_end = max_f32(t_left, t_right);
+	} else {
+		f32 t_0 = (r - p.y) / v.y;
+		f32 t_1 = (-r - p.y) / v.y;
+		t_begin = min_f32(t_0, t_1);
+		t_end = max_f32(t_0, t_1);
+
+		f32 t_cap_begin, t_cap_end;
+		f32 p_begin_x = p.x + t_begin * v.x;
+		if (p_begin_x < 0.0f || p_begin_x > len) {
+			v2 cap = p_begin_x < 0.0f ? p : p - v2(len, 0.0f);
+			if (!physics_get_linear_circle_origin_intersection_times(cap, v, r,
+			                                                         &t_cap_begin,
+			                                                         &t_cap_end)) {
+				return 0;
+			}
+			t_begin = t_cap_begin;
+		}
+		f32 p_end_x = p.x + t_end * v.x;
+		if (p_end_x < 0.0f || p_end_x > len) {
+			v2 cap = p_end_x < 0.0f ? p : p - v2(len, 0.0f);
+			if (!physics_get_linear_circle_origin_intersection_times(cap, v, r,
+			                                                         &t_cap_begin,
+			                                                         &t_cap_end)) {
+				return 0;
+			}
+			t_end = t_cap_end;
+		}
+	}
+
+	*t_begin_out = t_begin + circle->start_time;
+	*t_end_out = t_end + circle->start_time;
+	return 1;
+}
+
+static u8 bench_static_circle_times(Physics_Static_Circle* static_circle,
+                                    Physics_Linear_Circle* linear_circle,
+                                    f32* t_begin, f32* t_end)
+{
+	if (!physics_get_linear_circle_origin_intersection_times(linear_circle->start - static_circle->pos,
+	                                                         linear_circle->velocity,
+	                                                         linear_circle->radius + static_circle->radius,
+	                                                         t_begin, t_end)) {
+		return 0;
+	}
+	*t_begin += linear_circle->start_time;
+	*t_end += linear_circle->start_time;
+	return 1;
+}
+
+static u8 bench_linear_circle_times(Physics_Linear_Circle* circle_1,
+                                    Physics_Linear_Circle* circle_2,
+                                    f32* t_begin, f32* t_end)
+{
+	f32 t_start_offset = circle_2->start_time - circle_1->start_time;
+	v2 p = circle_1->start - (circle_2->start - t_start_offset * circle_2->velocity);
+	v2 v = circle_1->velocity - circle_2->velocity;
+	if (!physics_get_linear_circle_origin_intersection_times(p, v,
+	                                                         circle_1->radius + circle_2->radius,
+	                                                         t_begin, t_end)) {
+		return 0;
+	}
+	*t_begin += circle_1->start_time;
+	*t_end += circle_1->start_time;
+	return 1;
+}
+
+#else
+
+static u8 bench_static_line_times(Physics_Static_Line*   line,
+                                  Physics_Linear_Circle* circle,
+                                  f32* t_begin, f32* t_end)
+{
+	return physics_get_static_line_linear_circle_times_fixed(line, circle, t_begin, t_end);
+}
+
+static u8 bench_static_circle_times(Physics_Static_Circle* static_circle,
+                                    Physics_Linear_Circle* linear_circle,
+                                    f32* t_begin, f32* t_end)
+{
+	Physics_Fixed_Linear_Circle c = physics_to_fixed(linear_circle);
+	fixed t_0, t_1;
+	if (!physics_get_linear_circle_origin_intersection_times_fixed(c.start_x - f32_to_fixed(static_circle->pos.x),
+	                                                               c.start_y - f32_to_fixed(static_circle->pos.y),
+	                                                               c.velocity_x, c.velocity_y,
+	                                                               c.radius + f32_to_fixed(static_circle->radius),
+	                                                               &t_0, &t_1)) {
+		return 0;
+	}
+	*t_begin = fixed_to_f32(t_0 + c.start_time);
+	*t_end = fixed_to_f32(t_1 + c.start_time);
+	return 1;
+}
+
+static u8 bench_linear_circle_times(Physics_Linear_Circle* circle_1,
+                                    Physics_Linear_Circle* circle_2,
+                                    f32* t_begin, f32* t_end)
+{
+	Physics_Fixed_Linear_Circle c_1 = physics_to_fixed(circle_1);
+	Physics_Fixed_Linear_Circle c_2 = physics_to_fixed(circle_2);
+	fixed t_start_offset = c_2.start_time - c_1.start_time;
+	fixed p_x = c_1.start_x - (c_2.start_x - fixed_mul(t_start_offset, c_2.velocity_x));
+	fixed p_y = c_1.start_y - (c_2.start_y - fixed_mul(t_start_offset, c_2.velocity_y));
+	fixed t_0, t_1;
+	if (!physics_get_linear_circle_origin_intersection_times_fixed(p_x, p_y,
+	                                                               c_1.velocity_x - c_2.velocity_x,
+	                                                               c_1.velocity_y - c_2.velocity_y,
+	                                                               c_1.radius + c_2.radius,
+	                                                               &t_0, &t_1)) {
+		return 0;
+	}
+	*t_begin = fixed_to_f32(t_0 + c_1.start_time);
+	*t_end = fixed_to_f32(t_1 + c_1.start_time);
+	return 1;
+}
+
+#endif
+
+// Every pair of objects, one at a time.
+static u32 bench_oracle(Physics_Context* context, f32 start_time, Bench_Event* events)
+{
+	USE_PHYSICS_CONTEXT(context)
+
+	u32 num_events = 0;
+
+	for (u32 i = 0; i < linear_circles.len; ++i) {
+		Physics_Linear_Circle *circle = &linear_circles[i];
+		if (circle->start_time > start_time) {
+			events[num_events++] = { PHYSICS_EVENT_LC_START, i, 0, circle->start_time };
+		}
+		if (circle->start_time + circle->duration > start_time) {
+			events[num_events++] = { PHYSICS_EVENT_LC_END, i, 0, circle->start_time + circle->duration };
+		}
+	}
+
+	for (u32 i = 0; i < static_lines.len; ++i) {
+		Physics_Static_Line *line = &static_lines[i];
+		for (u32 j = 0; j < linear_circles.len; ++j) {
+			Physics_Linear_Circle *circle = &linear_circles[j];
+			if (!physics_do_objects_collide(line, circle)) {
+				continue;
+			}
+			f32 min_time = max_f32(start_time, circle->start_time);
+			f32 max_time = circle->start_time + circle->duration;
+			if (min_time >= max_time) {
+				continue;
+			}
+
+			f32 t_begin, t_end;
+			if (!bench_static_line_times(line, circle, &t_begin, &t_end)) {
+				continue;
+			}
+			bench_push_penetration(events, &num_events,
+			                       PHYSICS_EVENT_BEGIN_PENETRATE_SL_LC, PHYSICS_EVENT_END_PENETRATE_SL_LC,
+			                       i, j, t_begin, t_end, 1,
+			                       min_time, max_time);
+		}
+	}
+
+	for (u32 i = 0; i < static_circles.len; ++i) {
+		Physics_Static_Circle *static_circle = &static_circles[i];
+		for (u32 j = 0; j < linear_circles.len; ++j) {
+			Physics_Linear_Circle *linear_circle = &linear_circles[j];
+			if (!physics_do_objects_collide(static_circle, linear_circle)) {
+				continue;
+			}
+			f32 min_time = max_f32(start_time, linear_circle->start_time);
+			f32 max_time = linear_circle->start_time + linear_circle->duration;
+			if (min_time >= max_time) {
+				continue;
+			}
+
+			f32 t_begin, t_end;
+			if (!bench_static_circle_times(static_circle, linear_circle, &t_begin, &t_end)) {
+				continue;
+			}
+			t_begin = max_f32(t_begin, min_time);
+
+			bench_push_penetration(events, &num_events,
+			                       PHYSICS_EVENT_BEGIN_PENETRATE_SC_LC, PHYSICS_EVENT_END_PENETRATE_SC_LC,
+			                       i, j, t_begin, t_end, t_begin <= t_end,
+			                       min_time, max_time);
+		}
+	}
+
+	for (u32 i = 0; i < linear_circles.len; ++i) {
+		Physics_Linear_Circle *circle_1 = &linear_circles[i];
+		for (u32 j = i + 1; j < linear_circles.len; ++j) {
+			Physics_Linear_Circle *circle_2 = &linear_circles[j];
+			if (!physics_do_objects_collide(circle_1, circle_2)) {
+				continue;
+			}
+			f32 min_time = max_f32(max_f32(start_time, circle_1->start_time), circle_2->start_time);
+			f32 max_time = min_f32(circle_1->start_time + circle_1->duration,
+			                       circle_2->start_time + circle_2->duration);
+			if (min_time >= max_time) {
+				continue;
+			}
+
+			f32 t_begin, t_end;
+			if (!bench_linear_circle_times(circle_1, circle_2, &t_begin, &t_end)) {
+				continue;
+			}
+
+			bench_push_penetration(events, &num_events,
+			                       PHYSICS_EVENT_BEGIN_PENETRATE_LC_LC, PHYSICS_EVENT_END_PENETRATE_LC_LC,
+			                       i, j, t_begin, t_end, 1,
+			                       min_time, max_time);
+		}
+	}
+
+	return num_events;
+}
+
+// Sorts both lists and counts events which don't have a partner on the other
+// side within BENCH_TIME_TOLERANCE.
+static u32 bench_count_mismatches(Bench_Event* expected, u32 num_expected,
+                                  Bench_Event* actual, u32 num_actual,
+                                  u8 verbose)
+{
+	qsort(expected, num_expected, sizeof(expected[0]), bench_compare_events);
+	qsort(actual, num_actual, sizeof(actual[0]), bench_compare_events);
+
+	u32 mismatches = 0;
+	u32 i = 0, j = 0;
+	while (i < num_expected || j < num_actual) {
+		Bench_Event *e = i < num_expected ? &expected[i] : NULL;
+		Bench_Event *a = j < num_actual ? &actual[j] : NULL;
+		if (e && a
+		 && e->type == a->type && e->object_1 == a->object_1 && e->object_2 == a->object_2
+		 && fabsf(e->time - a->time) <= BENCH_TIME_TOLERANCE) {
+			++i;
+			++j;
+			continue;
+		}
+		Bench_Event *extra;
+		if (!a || (e && bench_compare_events(e, a) < 0)) {
+			extra = e;
+			++i;
+		} else {
+			extra = a;
+			++j;
+		}
+		++mismatches;
+		if (verbose) {
+			printf("  %s event type %u objects %u %u time %f\n",
+			       extra == e ? "missing" : "unexpected",
+			       extra->type, extra->object_1, extra->object_2, extra->time);
+		}
+	}
+	return mismatches;
+}
+
+static void bench_copy_scene(scalar::Physics_Context* dest, Physics_Context* src)
+{
+	scalar::physics_reset(dest);
+	ASSERT(sizeof(dest->static_lines) == sizeof(src->static_lines));
+	ASSERT(sizeof(dest->static_circles) == sizeof(src->static_circles));
+	ASSERT(sizeof(dest->linear_circles) == sizeof(src->linear_circles));
+	memcpy(&dest->static_lines, &src->static_lines, sizeof(src->static_lines));
+	memcpy(&dest->static_circles, &src->static_circles, sizeof(src->static_circles));
+	memcpy(&dest->linear_circles, &src->linear_circles, sizeof(src->linear_circles));
+}
+
+// Events which differ between the SIMD and scalar queues, position by position
+// -- both batch pairs in the same order so there's no need to sort, and the
+// times have to match to the bit.
+static u32 bench_count_scalar_differences(Physics_Context*             context,
+                                          Physics_Event_Queue*         queue,
+                                          scalar::Physics_Context*     scalar_context,
+                                          scalar::Physics_Event_Queue* scalar_queue,
+                                          u8                           verbose)
+{
+	u32 len = min_u32(queue->events.len, scalar_queue->events.len);
+	u32 differences = max_u32(queue->events.len, scalar_queue->events.len) - len;
+	for (u32 i = 0; i < len; ++i) {
+		Bench_Event e = bench_event(context, &queue->events[i]);
+		Bench_Event s = bench_event(scalar_context, &scalar_queue->events[i]);
+		if (!memcmp(&e, &s, sizeof(e))) {
+			continue;
+		}
+		++differences;
+		if (verbose) {
+			printf("  event %u: simd type %u objects %u %u time %a, scalar type %u objects %u %u time %a\n",
+			       i, e.type, e.object_1, e.object_2, e.time, s.type, s.object_1, s.object_2, s.time);
+		}
+	}
+	return differences;
+}
+
+// FNV-1a over the queue in order, so runs on different machines/compilers can
+// be compared for determinism
+static u32 bench_hash_events(Physics_Context* context, Physics_Event_Queue* queue)
+{
+	u32 hash = 2166136261u;
+	for (u32 i = 0; i < queue->events.len; ++i) {
+		Bench_Event event = bench_event(context, &queue->events[i]);
+		u32 words[4];
+		words[0] = event.type;
+		words[1] = event.object_1;
+		words[2] = event.object_2;
+		memcpy(&words[3], &event.time, sizeof(words[3]));
+		u8 *bytes = (u8*)words;
+		for (u32 j = 0; j < sizeof(words); ++j) {
+			hash = (hash ^ bytes[j]) * 16777619u;
+		}
+	}
+	return hash;
+}
+
+// -----------------------------------------------------------------------------
+// incremental updates
+
+#define BENCH_UPDATE_STEPS 8
+
+// Events after start_time. Exactly at start_time a full recompute gives begin
+// events for penetrations already in progress, which the incremental queue
+// handed out when they began, so those aren't comparable.
+static u32 bench_events_after(Physics_Context*     context,
+                              Physics_Event_Queue* queue,
+                              f32                  start_time,
+                              Bench_Event*         events)
+{
+	u32 num_events = 0;
+	for (u32 i = queue->head; i < queue->events.len; ++i) {
+		if (queue->events[i].time > start_time) {
+			events[num_events++] = bench_event(context, &queue->events[i]);
+		}
+	}
+	return num_events;
+}
+
+// Steps through a frame making random changes the way a turn does -- entities
+// stepping and dying, projectiles spawned and knocked out -- and after each step
+// checks physics_update_collisions against recomputing everything from scratch.
+// Returns the number of mismatched events.
+static u32 bench_check_incremental(Physics_Context*     context,
+                                   Physics_Event_Queue* queue,
+                                   Physics_Event_Queue* full_queue,
+                                   u32                  num_objects,
+                                   u64                  seed,
+                                   Bench_Event*         expected,
+                                   Bench_Event*         actual)
+{
+	USE_PHYSICS_CONTEXT(context)
+
+	Bench_Random r = { seed * 0xD1B54A32D192ED03ULL + 1 };
+	bench_make_scene(context, num_objects, seed);
+	physics_start_frame(context);
+	physics_compute_collisions(context, 0.0f, queue);
+
+	v2 dirs[4] = { v2(1.0f, 0.0f), v2(-1.0f, 0.0f), v2(0.0f, 1.0f), v2(0.0f, -1.0f) };
+	Entity_ID next_id = 1 << 20;
+	u32 num_changes = 1 + num_objects / 50;
+	u32 mismatches = 0;
+	for (u32 step = 1; step < BENCH_UPDATE_STEPS; ++step) {
+		f32 time = (f32)step / (f32)BENCH_UPDATE_STEPS;
+		for (u32 i = 0; i < num_changes; ++i) {
+			switch (bench_rand_u32(&r) % 4) {
+			case 0:
+				if (static_circles.len) {
+					Physics_Static_Circle *circle = &static_circles[bench_rand_u32(&r) % static_circles.len];
+					if (circle->owner_id) {
+						circle->pos = circle->pos + dirs[bench_rand_u32(&r) % 4];
+						physics_mark_changed(circle);
+					}
+				}
+				break;
+			case 1:
+				if (static_circles.len) {
+					Physics_Static_Circle *circle = &static_circles[bench_rand_u32(&r) % static_circles.len];
+					if (circle->owner_id) {
+						physics_remove_object(circle);
+					}
+				}
+				break;
+			case 2:
+				if (linear_circles.len) {
+					Physics_Linear_Circle *circle = &linear_circles[bench_rand_u32(&r) % linear_circles.len];
+					if (circle->owner_id) {
+						physics_remove_object(circle);
+					}
+				}
+				break;
+			case 3: {
+				Physics_Linear_Circle circle = {};
+				circle.owner_id = next_id++;
+				circle.collision_mask = MASK_PROJECTILE;
+				circle.collides_with_mask = MASK_WALL | MASK_ENTITY;
+				circle.start = v2(bench_rand_f32(&r, 2.0f, BENCH_MAP_SIZE - 2.0f),
+				                  bench_rand_f32(&r, 2.0f, BENCH_MAP_SIZE - 2.0f));
+				f32 angle = bench_rand_f32(&r, 0.0f, 2.0f * PI_F32);
+				circle.velocity = 5.0f * v2(cosf(angle), sinf(angle));
+				circle.radius = 0.1f;
+				circle.start_time = time + bench_rand_f32(&r, 0.0f, 0.25f);
+				circle.duration = 0.5f;
+				if (linear_circles.len < PHYSICS_MAX_LINEAR_CIRCLES) {
+					physics_add_linear_circle(context, circle);
+				}
+				break;
+			}
+			}
+		}
+
+		physics_start_frame(context);
+		physics_update_collisions(context, time, queue);
+		u32 num_actual = bench_events_after(context, queue, time, actual);
+
+		physics_compute_collisions(context, time, full_queue);
+		u32 num_expected = bench_events_after(context, full_queue, time, expected);
+
+		mismatches += bench_count_mismatches(expected, num_expected, actual, num_actual, 1);
+	}
+	return mismatches;
+}
+
+// -----------------------------------------------------------------------------
+// main
+
+typedef std::chrono::steady_clock Bench_Clock;
+
+static f64 bench_seconds_since(Bench_Clock::time_point start)
+{
+	return std::chrono::duration<f64>(Bench_Clock::now() - start).count();
+}
+
+int main(int argc, char** argv)
+{
+	u64 seed = 1;
+	u8 check = 1;
+	for (int i = 1; i < argc; ++i) {
+		if (!strcmp(argv[i], "--no-check")) {
+			check = 0;
+		} else {
+			seed = strtoull(argv[i], NULL, 10);
+		}
+	}
+
+	// far too big for the stack
+	Physics_Context *context = (Physics_Context*)calloc(1, sizeof(Physics_Context));
+	Physics_Event_Queue *queue = (Physics_Event_Queue*)calloc(1, sizeof(Physics_Event_Queue));
+	Physics_Event_Queue *full_queue = (Physics_Event_Queue*)calloc(1, sizeof(Physics_Event_Queue));
+	scalar::Physics_Context *scalar_context = (scalar::Physics_Context*)calloc(1, sizeof(scalar::Physics_Context));
+	scalar::Physics_Event_Queue *scalar_queue = (scalar::Physics_Event_Queue*)calloc(1, sizeof(scalar::Physics_Event_Queue));
+	Bench_Event *expected = (Bench_Event*)malloc(PHYSICS_MAX_EVENTS * sizeof(Bench_Event));
+	Bench_Event *actual = (Bench_Event*)malloc(PHYSICS_MAX_EVENTS * sizeof(Bench_Event));
+	ASSERT(context && queue && full_queue && scalar_context && scalar_queue && expected && actual);
+	physics_init(context);
+	scalar::physics_init(scalar_context);
+
+	u32 sizes[] = { 10, 30, 100, 300, 1000, 3000, 10000 };
+	u32 num_failed = 0;
+
+#ifdef PHYSICS_FIXED_POINT
+	printf("fixed point physics, %u fraction bits\n", FIXED_POINT_FRACTION_BITS);
+#endif
+	printf("%8s %8s %12s %12s %12s %10s %10s %12s %10s\n",
+	       "objects", "events", "start (us)", "collide (us)", "update (us)",
+	       "oracle", "scalar", "incremental", "hash");
+	for (u32 s = 0; s < ARRAY_SIZE(sizes); ++s) {
+		u32 n = sizes[s];
+		u32 reps = max_u32(1, 20000 / n);
+
+		f64 start_frame_time = 0.0, compute_time = 0.0, update_time = 0.0;
+		for (u32 rep = 0; rep < reps; ++rep) {
+			bench_make_scene(context, n, seed + rep);
+
+			auto t = Bench_Clock::now();
+			physics_start_frame(context);
+			start_frame_time += bench_seconds_since(t);
+
+			t = Bench_Clock::now();
+			physics_compute_collisions(context, 0.0f, queue);
+			compute_time += bench_seconds_since(t);
+
+			// knock out one projectile like a fireball offshoot hitting a wall
+			t = Bench_Clock::now();
+			physics_remove_object(&context->linear_circles[rep % context->linear_circles.len]);
+			physics_start_frame(context);
+			physics_update_collisions(context, 0.5f, queue);
+			update_time += bench_seconds_since(t);
+		}
+
+		bench_make_scene(context, n, seed);
+		physics_start_frame(context);
+		physics_compute_collisions(context, 0.0f, queue);
+		u32 hash = bench_hash_events(context, queue);
+		u32 num_events = queue->events.len;
+
+		const char *result = "skipped";
+		const char *scalar_result = "skipped";
+		const char *incremental_result = "skipped";
+		if (check) {
+			bench_copy_scene(scalar_context, context);
+			scalar::physics_start_frame(scalar_context);
+			scalar::physics_compute_collisions(scalar_context, 0.0f, scalar_queue);
+			u8 differs = bench_count_scalar_differences(context, queue,
+			                                            scalar_context, scalar_queue, 1) != 0;
+			scalar_result = differs ? "FAILED" : "ok";
+			num_failed += differs;
+
+			u32 num_actual = queue->events.len;
+			for (u32 i = 0; i < num_actual; ++i) {
+				actual[i] = bench_event(context, &queue->events[i]);
+			}
+			u32 num_expected = bench_oracle(context, 0.0f, expected);
+
+			u32 mismatches = bench_count_mismatches(expected, num_expected, actual, num_actual, 1);
+			u8 failed = mismatches != 0;
+			result = failed ? "FAILED" : "ok";
+			num_failed += failed;
+
+			u8 incremental_failed = bench_check_incremental(context, queue, full_queue, n, seed,
+			                                                expected, actual) != 0;
+			incremental_result = incremental_failed ? "FAILED" : "ok";
+			num_failed += incremental_failed;
+		}
+
+		printf("%8u %8u %12.1f %12.1f %12.1f %10s %10s %12s   %08x\n",
+		       n, num_events,
+		       1e6 * start_frame_time / reps,
+		       1e6 * compute_time / reps,
+		       1e6 * update_time / reps,
+		       result, scalar_result, incremental_result, hash);
+	}
+
+	physics_free(context);
+	scalar::physics_free(scalar_context);
+	free(context);
+	free(queue);
+	free(full_queue);
+	free(scalar_context);
+	free(scalar_queue);
+	free(expected);
+	free(actual);
+
+	return num_failed ? 1 : 0;
+}
@@ -6,10 +6,19 @@
 
 typedef void (*Thread_Function)(void* data);
 
+// counting semaphore, opaque to everything but the platform layer
+struct Semaphore;
+
 #define PLATFORM_FUNCTIONS \
 	PLATFORM_FUNCTION(void, start_thread, Thread_Function thread_function, const char* name, void* thread_args) \
 	PLATFORM_FUNCTION(void, sleep, u32 time_in_milliseconds) \
+	PLATFORM_FUNCTION(u32, get_num_processors) \
+	PLATFORM_FUNCTION(Semaphore*, create_semaphore, u32 initial_count) \
+	PLATFORM_FUNCTION(void, free_semaphore, Semaphore* semaphore) \
+	PLATFORM_FUNCTION(void, wait_semaphore, Semaphore* semaphore) \
+	PLATFORM_FUNCTION(void, signal_semaphore, Semaphore* semaphore) \
 	PLATFORM_FUNCTION(u32, try_read_file, char* filename, void* dest, u32 max_size) \
+	PLATFORM_FUNCTION(void*, map_file, const char* filename, size_t* size) \
 	PLATFORM_FUNCTION(JFG_Error, try_write_file, const char* filename, void* src, size_t size)
 
 struct Platform_Functions
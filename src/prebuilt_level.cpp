@@ -0,0 +1,299 @@
+#include "prebuilt_level.h"
+
+#include "stdafx.h"
+#include "platform_functions.h"
+
+#define PREBUILT_LEVEL_ALIGNMENT 16
+
+const char *PREBUILT_LEVEL_NAMES[] = {
+#define LEVEL(name) #name,
+	PREBUILT_LEVELS
+#undef LEVEL
+};
+
+static u32 align_up(u32 x)
+{
+	return (x + PREBUILT_LEVEL_ALIGNMENT - 1) & ~(PREBUILT_LEVEL_ALIGNMENT - 1);
+}
+
+static v2_u32 get_tiles_size(Prebuilt_Level* level)
+{
+	v2_u32 result = v2_u32(level->tiles_size.w, level->tiles_size.h);
+	if (!result.w) { result.w = 256; }
+	if (!result.h) { result.h = 256; }
+	return result;
+}
+
+// =============================================================================
+// writing
+
+static size_t write_prebuilt_level(Game* game, u8* buffer, size_t max_size)
+{
+	ASSERT(game->fovs.len == 1);
+	Field_Of_Vision *fov = &game->fovs[0];
+
+	// bounding box of everything init() doesn't leave zeroed
+	u32 min_x = 256, min_y = 256, max_x = 0, max_y = 0;
+	for (u32 y = 0; y < 256; ++y) {
+		for (u32 x = 0; x < 256; ++x) {
+			Pos p = Pos(x, y);
+			Tile t = game->tiles[p];
+			if (t.type != TILE_EMPTY || t.appearance != APPEARANCE_NONE || (*fov)[p] != FOV_NEVER_SEEN) {
+				min_x = min_u32(min_x, x);
+				min_y = min_u32(min_y, y);
+				max_x = max_u32(max_x, x);
+				max_y = max_u32(max_y, y);
+			}
+		}
+	}
+	if (min_x > max_x) {
+		min_x = max_x = min_y = max_y = 0;
+	}
+	u32 width = max_x - min_x + 1;
+	u32 height = max_y - min_y + 1;
+	u32 num_tiles = width * height;
+
+	Prebuilt_Level level = {};
+	level.tiles_min = Pos(min_x, min_y);
+	level.tiles_size = v2_u8((u8)width, (u8)height);
+	// sources only ever add entities, so there are no free indices to store
+	ASSERT(!game->free_entity_indices);
+	level.next_entity_index = game->next_entity_index;
+	level.num_entities = game->entities.len;
+#define CONTROLLER_TYPE(upper, type, name, max) \
+	level.num_controllers[CONTROLLER_##upper] = game->controllers.name.len;
+	CONTROLLER_TYPES
+#undef CONTROLLER_TYPE
+	level.num_handlers = game->handlers.len;
+	// nor any turns, so no timer has fired or been removed either
+	ASSERT(!game->timers.free_list && !game->turn);
+	level.num_timers = game->timers.next_timer_index;
+
+	u32 offset = align_up(sizeof(level));
+	level.tile_appearances_offset = offset;
+	offset = align_up(offset + num_tiles * sizeof(u16));
+	level.tile_types_offset = offset;
+	offset = align_up(offset + num_tiles * sizeof(u8));
+	level.fov_offset = offset;
+	offset = align_up(offset + num_tiles * sizeof(u8));
+	level.entities_offset = offset;
+	offset = align_up(offset + level.num_entities * sizeof(Entity));
+	level.entity_infos_offset = offset;
+	offset = align_up(offset + level.num_entities * sizeof(Entity_Info));
+#define CONTROLLER_TYPE(upper, type, name, max) \
+	level.controllers_offset[CONTROLLER_##upper] = offset; \
+	offset = align_up(offset + level.num_controllers[CONTROLLER_##upper] * sizeof(type##_Controller));
+	CONTROLLER_TYPES
+#undef CONTROLLER_TYPE
+	level.handlers_offset = offset;
+	offset = align_up(offset + level.num_handlers * sizeof(Message_Handler));
+	level.timers_offset = offset;
+	offset = align_up(offset + level.num_timers * sizeof(Timer));
+	level.timer_slots_offset = offset;
+	offset = align_up(offset + sizeof(game->timers.slots));
+
+	if (offset > max_size) {
+		return 0;
+	}
+	memset(buffer, 0, offset);
+	memcpy(buffer, &level, sizeof(level));
+
+	u16 *appearances = (u16*)(buffer + level.tile_appearances_offset);
+	u8 *types = buffer + level.tile_types_offset;
+	u8 *fov_states = buffer + level.fov_offset;
+	for (u32 y = 0; y < height; ++y) {
+		for (u32 x = 0; x < width; ++x) {
+			Pos p = Pos(min_x + x, min_y + y);
+			Tile t = game->tiles[p];
+			ASSERT(t.type <= 0xFF && t.appearance <= 0xFFFF && (*fov)[p] <= 0xFF);
+			types[y * width + x] = (u8)t.type;
+			appearances[y * width + x] = (u16)t.appearance;
+			fov_states[y * width + x] = (u8)(*fov)[p];
+		}
+	}
+
+	memcpy(buffer + level.entities_offset, game->entities.items, level.num_entities * sizeof(Entity));
+	memcpy(buffer + level.entity_infos_offset, game->entity_infos, level.num_entities * sizeof(Entity_Info));
+#define CONTROLLER_TYPE(upper, type, name, max) \
+	memcpy(buffer + level.controllers_offset[CONTROLLER_##upper], \
+	       game->controllers.name.items, \
+	       level.num_controllers[CONTROLLER_##upper] * sizeof(type##_Controller));
+	CONTROLLER_TYPES
+#undef CONTROLLER_TYPE
+	memcpy(buffer + level.handlers_offset, game->handlers.items, level.num_handlers * sizeof(Message_Handler));
+	memcpy(buffer + level.timers_offset, game->timers.timers, level.num_timers * sizeof(Timer));
+	memcpy(buffer + level.timer_slots_offset, game->timers.slots, sizeof(game->timers.slots));
+
+	return offset;
+}
+
+size_t write_prebuilt_levels(Game* game, u8* buffer, size_t max_size)
+{
+	Prebuilt_Levels_Header header = {};
+	header.magic = PREBUILT_LEVELS_MAGIC;
+	header.version = PREBUILT_LEVELS_VERSION;
+	header.entity_size = sizeof(Entity);
+	header.entity_info_size = sizeof(Entity_Info);
+#define CONTROLLER_TYPE(upper, type, name, max) \
+	header.controller_sizes[CONTROLLER_##upper] = sizeof(type##_Controller);
+	CONTROLLER_TYPES
+#undef CONTROLLER_TYPE
+	header.message_handler_size = sizeof(Message_Handler);
+	header.timer_size = sizeof(Timer);
+
+	u32 offset = align_up(sizeof(header));
+	if (offset > max_size) {
+		return 0;
+	}
+	for (u32 i = 0; i < NUM_PREBUILT_LEVELS; ++i) {
+		parse_prebuilt_level(game, (Prebuilt_Level_ID)i);
+		size_t size = write_prebuilt_level(game, buffer + offset, max_size - offset);
+		if (!size) {
+			return 0;
+		}
+		header.levels[i].file_offset = offset;
+		header.levels[i].size = (u32)size;
+		offset += (u32)size;
+	}
+
+	header.file_size = offset;
+	memcpy(buffer, &header, sizeof(header));
+	return offset;
+}
+
+// =============================================================================
+// loading
+
+static u8 is_valid(Prebuilt_Levels_Header* header, size_t file_size)
+{
+	if (file_size < sizeof(*header)
+	 || header->magic != PREBUILT_LEVELS_MAGIC
+	 || header->version != PREBUILT_LEVELS_VERSION
+	 || header->entity_size != sizeof(Entity)
+	 || header->entity_info_size != sizeof(Entity_Info)
+	 || header->message_handler_size != sizeof(Message_Handler)
+	 || header->timer_size != sizeof(Timer)
+	 || header->file_size != file_size) {
+		return 0;
+	}
+	for (u32 i = 0; i < NUM_PREBUILT_LEVELS; ++i) {
+		Prebuilt_Level_Entry entry = header->levels[i];
+		if ((entry.file_offset & (PREBUILT_LEVEL_ALIGNMENT - 1))
+		 || entry.size < sizeof(Prebuilt_Level)
+		 || (size_t)entry.file_offset + entry.size > file_size) {
+			return 0;
+		}
+		Prebuilt_Level *level = (Prebuilt_Level*)((u8*)header + entry.file_offset);
+		v2_u32 size = get_tiles_size(level);
+		u32 num_tiles = size.w * size.h;
+		if (level->tiles_min.x + size.w > 256
+		 || level->tiles_min.y + size.h > 256
+		 || level->num_entities > MAX_ENTITIES
+		 || level->num_handlers > GAME_MAX_MESSAGE_HANDLERS
+		 || !level->num_timers
+		 || level->num_timers > MAX_TIMERS
+		 || (u64)level->tile_appearances_offset + num_tiles * sizeof(u16) > entry.size
+		 || (u64)level->tile_types_offset + num_tiles * sizeof(u8) > entry.size
+		 || (u64)level->fov_offset + num_tiles * sizeof(u8) > entry.size
+		 || (u64)level->entities_offset + level->num_entities * sizeof(Entity) > entry.size
+		 || (u64)level->entity_infos_offset + level->num_entities * sizeof(Entity_Info) > entry.size
+		 || (u64)level->handlers_offset + level->num_handlers * sizeof(Message_Handler) > entry.size
+		 || (u64)level->timers_offset + level->num_timers * sizeof(Timer) > entry.size
+		 || (u64)level->timer_slots_offset + sizeof(Timer_Wheel::slots) > entry.size) {
+			return 0;
+		}
+#define CONTROLLER_TYPE(upper, type, name, max) \
+		if (header->controller_sizes[CONTROLLER_##upper] != sizeof(type##_Controller) \
+		 || level->num_controllers[CONTROLLER_##upper] > max \
+		 || (u64)level->controllers_offset[CONTROLLER_##upper] \
+		    + level->num_controllers[CONTROLLER_##upper] * sizeof(type##_Controller) > entry.size) { \
+			return 0; \
+		}
+		CONTROLLER_TYPES
+#undef CONTROLLER_TYPE
+	}
+	return 1;
+}
+
+// NULL if the file couldn't be used
+static Prebuilt_Levels_Header* map_prebuilt_levels()
+{
+	Prebuilt_Levels_Header *header = NULL;
+	size_t size = 0;
+	if (map_file) {
+		header = (Prebuilt_Levels_Header*)map_file(PREBUILT_LEVELS_FILE_NAME, &size);
+	}
+	// XXX -- leaks the view of an out of date file
+	if (header && is_valid(header, size)) {
+		return header;
+	}
+	return NULL;
+}
+
+// Maps the file the first time any thread asks -- the static's initialization is
+// thread safe, so other threads asking meanwhile block until it's done. The view
+// stays mapped for the life of the process.
+static Prebuilt_Levels_Header* get_prebuilt_levels()
+{
+	static Prebuilt_Levels_Header *prebuilt_levels = map_prebuilt_levels();
+	return prebuilt_levels;
+}
+
+void load_prebuilt_level(Game* game, Prebuilt_Level_ID level_id)
+{
+	Prebuilt_Levels_Header *header = get_prebuilt_levels();
+	if (header) {
+		copy_prebuilt_level(game, header, level_id);
+	} else {
+		parse_prebuilt_level(game, level_id);
+	}
+}
+
+void copy_prebuilt_level(Game* game, Prebuilt_Levels_Header* header, Prebuilt_Level_ID level_id)
+{
+	u8 *base = (u8*)header + header->levels[level_id].file_offset;
+	Prebuilt_Level *level = (Prebuilt_Level*)base;
+
+	init(game);
+
+	v2_u32 size = get_tiles_size(level);
+	u16 *appearances = (u16*)(base + level->tile_appearances_offset);
+	u8 *types = base + level->tile_types_offset;
+	u8 *fov_states = base + level->fov_offset;
+	for (u32 y = 0; y < size.h; ++y) {
+		Pos row_start = Pos(level->tiles_min.x, level->tiles_min.y + y);
+		Tile *row = &game->tiles[row_start];
+		FOV_State *fov_row = &game->fovs[0][row_start];
+		for (u32 x = 0; x < size.w; ++x) {
+			row[x].type = (Tile_Type)types[x];
+			row[x].appearance = (Appearance)appearances[x];
+			fov_row[x] = (FOV_State)fov_states[x];
+		}
+		types += size.w;
+		appearances += size.w;
+		fov_states += size.w;
+	}
+	pack_rows(&game->fovs[0]);
+
+	// the tables already hold the player and its controller from init()
+	memcpy(game->entities.items, base + level->entities_offset, level->num_entities * sizeof(Entity));
+	memcpy(game->entity_infos, base + level->entity_infos_offset, level->num_entities * sizeof(Entity_Info));
+	game->entities.len = level->num_entities;
+	for (u32 i = 0; i < level->num_entities; ++i) {
+		game->entity_slots[entity_id_index(game->entities[i].id)] = (u16)i;
+	}
+#define CONTROLLER_TYPE(upper, type, name, max) \
+	memcpy(game->controllers.name.items, \
+	       base + level->controllers_offset[CONTROLLER_##upper], \
+	       level->num_controllers[CONTROLLER_##upper] * sizeof(type##_Controller)); \
+	game->controllers.name.len = level->num_controllers[CONTROLLER_##upper];
+	CONTROLLER_TYPES
+#undef CONTROLLER_TYPE
+	memcpy(game->handlers.items, base + level->handlers_offset, level->num_handlers * sizeof(Message_Handler));
+	game->handlers.len = level->num_handlers;
+	memcpy(game->timers.timers, base + level->timers_offset, level->num_timers * sizeof(Timer));
+	memcpy(game->timers.slots, base + level->timer_slots_offset, sizeof(game->timers.slots));
+	game->timers.next_timer_index = level->num_timers;
+
+	game->next_entity_index = level->next_entity_index;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "prelude.h"
+
+#include "game.h"
+
+// Hand authored levels. The sources are character maps in level_gen.cpp --
+// build_levels_file parses them offline and writes the results to
+// PREBUILT_LEVELS_FILE_NAME, which the game maps and copies straight into the
+// Game rather than parsing again.
+
+#define PREBUILT_LEVELS_FILE_NAME "levels.bin"
+#define PREBUILT_LEVELS_MAGIC     0x564C4244 // "DBLV"
+#define PREBUILT_LEVELS_VERSION   5
+
+#define PREBUILT_LEVELS \
+	LEVEL(default) \
+	LEVEL(anim_test) \
+	LEVEL(imp_test) \
+	LEVEL(slime_test) \
+	LEVEL(lich_test) \
+	LEVEL(field_of_vision_test)
+
+enum Prebuilt_Level_ID
+{
+#define LEVEL(name) PREBUILT_LEVEL_##name,
+	PREBUILT_LEVELS
+#undef LEVEL
+
+	NUM_PREBUILT_LEVELS
+};
+
+extern const char *PREBUILT_LEVEL_NAMES[NUM_PREBUILT_LEVELS];
+
+// A level is a bounding box of tiles and the entities, controllers, message
+// handlers and timers as they are in the Game once the source is parsed -- the
+// player and its controller from init() included -- so loading is init() and a
+// memcpy per table. The player's field of vision is stored too rather than
+// running update_fov() again, which is most of the cost of building these
+// levels.
+// All offsets are from the start of the Prebuilt_Level and 16 byte aligned.
+struct Prebuilt_Level
+{
+	// everything outside the box is TILE_EMPTY and FOV_NEVER_SEEN
+	Pos           tiles_min;
+	v2_u8         tiles_size; // 0 means 256
+	u32           tile_types_offset;       // u8 per tile, row major
+	u32           tile_appearances_offset; // u16 per tile, row major
+	u32           fov_offset;              // u8 FOV_State per tile, row major
+
+	u32           next_entity_index;
+
+	u32           num_entities;
+	u32           entities_offset;
+	u32           entity_infos_offset; // one per entity, in the same order
+	u32           num_controllers[NUM_CONTROLLER_TYPES]; // a table per pool
+	u32           controllers_offset[NUM_CONTROLLER_TYPES];
+	u32           num_handlers;
+	u32           handlers_offset;
+	u32           num_timers;         // Timer_Wheel::next_timer_index
+	u32           timers_offset;      // timers[0] included, unused as it is
+	u32           timer_slots_offset; // the wheel's slots as they are
+};
+
+struct Prebuilt_Level_Entry
+{
+	u32 file_offset;
+	u32 size;
+};
+
+// The tables are the game's structs as they are, so a file is only usable by a
+// build with the same layouts. The sizes catch most changes -- anything else
+// needs PREBUILT_LEVELS_VERSION bumping.
+struct Prebuilt_Levels_Header
+{
+	u32                  magic;
+	u32                  version;
+	u32                  entity_size;
+	u32                  entity_info_size;
+	u32                  controller_sizes[NUM_CONTROLLER_TYPES];
+	u32                  message_handler_size;
+	u32                  timer_size;
+	u32                  file_size;
+	Prebuilt_Level_Entry levels[NUM_PREBUILT_LEVELS];
+};
+
+// Parses the level's source -- level_gen.cpp.
+void parse_prebuilt_level(Game* game, Prebuilt_Level_ID level_id);
+
+// Writes every level to buffer and returns the size, or 0 if it doesn't fit.
+// game is used as scratch.
+size_t write_prebuilt_levels(Game* game, u8* buffer, size_t max_size);
+
+// Loads the level from PREBUILT_LEVELS_FILE_NAME, mapping it on first use. Falls
+// back to parsing the source if the file is missing or out of date.
+void load_prebuilt_level(Game* game, Prebuilt_Level_ID level_id);
+
+// Copies the level out of header, which has to be valid -- the mapped file or a
+// buffer write_prebuilt_levels() filled.
+void copy_prebuilt_level(Game* game, Prebuilt_Levels_Header* header, Prebuilt_Level_ID level_id);
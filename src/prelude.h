@@ -28,6 +28,21 @@ typedef double f64;
 #define OFFSET_OF(struct_type, member) ((size_t)(&((struct_type*)0)->member))
 #define STATIC_ASSERT(COND, MSG) typedef u8 static_assertion_##MSG[(COND) ? 1 : -1]
 
+// bit twiddling -- x must be non-zero for count_trailing_zeros
+#ifdef _MSC_VER
+#include <intrin.h>
+static inline u32 count_trailing_zeros(u64 x)
+{
+	unsigned long idx;
+	_BitScanForward64(&idx, x);
+	return (u32)idx;
+}
+static inline u32 pop_count(u64 x) { return (u32)__popcnt64(x); }
+#else
+static inline u32 count_trailing_zeros(u64 x) { return (u32)__builtin_ctzll(x); }
+static inline u32 pop_count(u64 x)            { return (u32)__builtin_popcountll(x); }
+#endif
+
 #ifdef LIBRARY
 	#define LIBRARY_EXPORT extern "C" __declspec(dllexport)
 #else
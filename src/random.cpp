@@ -1,96 +1,177 @@
 #include "random.h"
 
+#include "jfg_math.h"
+#include "simd.h"
+
 static thread_local void *random_cur_state = NULL;
 thread_local u32 (*rand_u32)() = NULL;
 thread_local f32 (*rand_f32)() = NULL;
 thread_local f32 (*uniform_f32)(f32 start, f32 end) = NULL;
+thread_local void (*rand_fill_u32)(u32* out, u32 n) = NULL;
+thread_local void (*rand_fill_f32)(f32* out, u32 n) = NULL;
+thread_local void (*uniform_fill_f32)(f32* out, u32 n, f32 start, f32 end) = NULL;
 
-static u32 mt19937_rand_u32()
-{
-	ASSERT(random_cur_state);
-	MT19937 *rand = (MT19937*)random_cur_state;
-	return rand->rand_u32();
-}
+#define RANDOM_GENERATOR(Type) \
+	static u32 Type##_rand_u32() \
+	{ \
+		ASSERT(random_cur_state); \
+		return ((Type*)random_cur_state)->rand_u32(); \
+	} \
+	static f32 Type##_rand_f32() \
+	{ \
+		ASSERT(random_cur_state); \
+		return ((Type*)random_cur_state)->rand_f32(); \
+	} \
+	static f32 Type##_uniform_f32(f32 start, f32 end) \
+	{ \
+		ASSERT(random_cur_state); \
+		return ((Type*)random_cur_state)->uniform_f32(start, end); \
+	} \
+	static void Type##_rand_fill_u32(u32* out, u32 n) \
+	{ \
+		ASSERT(random_cur_state); \
+		((Type*)random_cur_state)->rand_fill_u32(out, n); \
+	} \
+	static void Type##_rand_fill_f32(f32* out, u32 n) \
+	{ \
+		ASSERT(random_cur_state); \
+		((Type*)random_cur_state)->rand_fill_f32(out, n); \
+	} \
+	static void Type##_uniform_fill_f32(f32* out, u32 n, f32 start, f32 end) \
+	{ \
+		ASSERT(random_cur_state); \
+		((Type*)random_cur_state)->uniform_fill_f32(out, n, start, end); \
+	} \
+	void Type::set_current() \
+	{ \
+		random_cur_state = this; \
+		::rand_u32 = Type##_rand_u32; \
+		::rand_f32 = Type##_rand_f32; \
+		::uniform_f32 = Type##_uniform_f32; \
+		::rand_fill_u32 = Type##_rand_fill_u32; \
+		::rand_fill_f32 = Type##_rand_fill_f32; \
+		::uniform_fill_f32 = Type##_uniform_fill_f32; \
+	}
+RANDOM_GENERATORS
+#undef RANDOM_GENERATOR
+
+// =============================================================================
+// MT19937
 
-static f32 mt19937_rand_f32()
+#define MT19937_UPPER_MASK 0x80000000
+#define MT19937_LOWER_MASK 0x7FFFFFFF
+#define MT19937_A          0x9908B0DF
+#define MT19937_M          312
+
+static inline u32 mt19937_twist_word(u32 x_i, u32 x_next, u32 x_m)
 {
-	ASSERT(random_cur_state);
-	MT19937 *rand = (MT19937*)random_cur_state;
-	return rand->rand_f32();
+	u32 tmp = (x_i & MT19937_UPPER_MASK) | (x_next & MT19937_LOWER_MASK);
+	return x_m ^ (tmp >> 1) ^ ((tmp & 1) * MT19937_A);
 }
 
-static f32 mt19937_uniform_f32(f32 start, f32 end)
+static inline u32x4 mt19937_twist_word(u32x4 x_i, u32x4 x_next, u32x4 x_m)
 {
-	ASSERT(random_cur_state);
-	MT19937 *rand = (MT19937*)random_cur_state;
-	return rand->uniform_f32(start, end);
+	u32x4 tmp = (x_i & u32x4_set1(MT19937_UPPER_MASK)) | (x_next & u32x4_set1(MT19937_LOWER_MASK));
+	u32x4 odd = u32x4_set1(0) - (tmp & u32x4_set1(1));
+	return x_m ^ (tmp >> 1) ^ (odd & u32x4_set1(MT19937_A));
 }
 
-void MT19937::set_current()
+static inline u32x4 mt19937_temper(u32x4 y)
 {
-	random_cur_state = this;
-	::rand_u32 = mt19937_rand_u32;
-	::rand_f32 = mt19937_rand_f32;
-	::uniform_f32 = mt19937_uniform_f32;
+	y = y ^ (y >> 11);
+	y = y ^ ((y << 7) & u32x4_set1(0x9D2C5680));
+	y = y ^ ((y << 15) & u32x4_set1(0xEFC60000));
+	y = y ^ (y >> 18);
+	return y;
 }
 
-static void mt19937_twist(MT19937* mt19937)
+// The same as updating x[i] from x[(i + 1) % n] and x[(i + m) % n] for each i
+// in turn, split where the indices wrap so there's no modulo. Within each part
+// a word only reads words the part doesn't write -- x[i + 1] is written after
+// it and x[i + m] and x[i + m - n] are either not written yet or were written
+// by the first part -- so 4 consecutive words can be done at once.
+void MT19937::twist()
 {
-	const u32 upper_mask = 0x80000000;
-	const u32 lower_mask = 0x7FFFFFFF;
-	const u32 a = 0x9908B0DF;
-	const u32 n = ARRAY_SIZE(mt19937->x);
-	const u32 m = 312;
-	u32 *x = mt19937->x;
-	for (u32 i = 0; i < n; ++i) {
-		u32 tmp = (x[i] & upper_mask) | (x[(i + 1) % n] & lower_mask);
-		u32 xA = (tmp >> 1) ^ ((tmp & 1) * a);
-		x[i] = x[(i + m) % n] ^ xA;
+	const u32 n = ARRAY_SIZE(x);
+	const u32 m = MT19937_M;
+
+	u32 i = 0;
+	for ( ; i + 4 <= n - m; i += 4) {
+		u32x4 words = mt19937_twist_word(u32x4_load(&x[i]), u32x4_load(&x[i + 1]), u32x4_load(&x[i + m]));
+		u32x4_store(&x[i], words);
+	}
+	for ( ; i < n - m; ++i) {
+		x[i] = mt19937_twist_word(x[i], x[i + 1], x[i + m]);
 	}
+	for ( ; i + 4 <= n - 1; i += 4) {
+		u32x4 words = mt19937_twist_word(u32x4_load(&x[i]), u32x4_load(&x[i + 1]), u32x4_load(&x[i + m - n]));
+		u32x4_store(&x[i], words);
+	}
+	for ( ; i < n - 1; ++i) {
+		x[i] = mt19937_twist_word(x[i], x[i + 1], x[i + m - n]);
+	}
+	x[n - 1] = mt19937_twist_word(x[n - 1], x[0], x[m - 1]);
+
+	idx = 0;
 }
 
-void MT19937::seed(u32 seed)
+void MT19937::rand_fill_u32(u32* out, u32 n)
 {
-	x[0] = seed;
-	const u32 f = 1812433253;
-	for (u32 i = 1; i < ARRAY_SIZE(x); ++i) {
-		seed = f * (seed ^ (seed >> 30)) + i;
-		x[i] = seed;
+	while (n) {
+		if (idx == ARRAY_SIZE(x)) {
+			twist();
+		}
+		u32 len = min_u32(n, ARRAY_SIZE(x) - idx);
+		u32 i = 0;
+		for ( ; i + 4 <= len; i += 4) {
+			u32x4_store(&out[i], mt19937_temper(u32x4_load(&x[idx + i])));
+		}
+		for ( ; i < len; ++i) {
+			out[i] = mt19937_temper(x[idx + i]);
+		}
+		idx += len;
+		out += len;
+		n -= len;
 	}
-	mt19937_twist(this);
-	idx = 0;
 }
 
-u32 MT19937::rand_u32()
+// draws into out as u32s then converts them where they are
+void MT19937::rand_fill_f32(f32* out, u32 n)
 {
-	const u32 b = 0x9D2C5680;
-	const u32 c = 0xEFC60000;
-	const u32 d = 0xFFFFFFFF;
-	const u32 s = 7;
-	const u32 t = 15;
-	const u32 u = 11;
-	const u32 l = 18;
-
-	if (idx == ARRAY_SIZE(x)) {
-		mt19937_twist(this);
-		idx = 0;
+	rand_fill_u32((u32*)out, n);
+	f32x4 scale = f32x4_set1((f32)(u32)-1);
+	u32 i = 0;
+	for ( ; i + 4 <= n; i += 4) {
+		f32x4_store(&out[i], u32x4_to_f32x4(u32x4_load((u32*)&out[i])) / scale);
+	}
+	for ( ; i < n; ++i) {
+		u32 r;
+		memcpy(&r, &out[i], sizeof(r));
+		out[i] = random_u32_to_f32(r);
 	}
-	u32 y = x[idx++];
-	y = y ^ ((y >> u) & d);
-	y = y ^ ((y << s) & b);
-	y = y ^ ((y << t) & c);
-	y = y ^ (y >> l);
-
-	return y;
 }
 
-f32 MT19937::rand_f32()
+void MT19937::uniform_fill_f32(f32* out, u32 n, f32 start, f32 end)
 {
-	u32 r = rand_u32();
-	return (f32)r / (f32)(u32)-1;
+	rand_fill_f32(out, n);
+	f32x4 start_4 = f32x4_set1(start);
+	f32x4 range_4 = f32x4_set1(end - start);
+	u32 i = 0;
+	for ( ; i + 4 <= n; i += 4) {
+		f32x4_store(&out[i], start_4 + range_4 * f32x4_load(&out[i]));
+	}
+	for ( ; i < n; ++i) {
+		out[i] = start + (end - start)*out[i];
+	}
 }
 
-f32 MT19937::uniform_f32(f32 start, f32 end)
+void MT19937::seed(u32 seed)
 {
-	return start + (end - start)*rand_f32();
-}
\ No newline at end of file
+	x[0] = seed;
+	const u32 f = 1812433253;
+	for (u32 i = 1; i < ARRAY_SIZE(x); ++i) {
+		seed = f * (seed ^ (seed >> 30)) + i;
+		x[i] = seed;
+	}
+	twist();
+}
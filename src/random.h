@@ -3,20 +3,230 @@
 
 #include "prelude.h"
 
+// Generators are plain structs with inline methods -- hold one by value and call
+// it directly. Code that doesn't carry one around uses the thread's current
+// generator through rand_u32/rand_f32/uniform_f32, which set_current() points at
+// it.
+//
+// rand_f32() is in [0, 1] for every generator. The rand_fill_* methods give the
+// same values in the same order as that many single draws, so switching between
+// them doesn't change what a seed produces.
+
+#define RANDOM_GENERATORS \
+	RANDOM_GENERATOR(MT19937) \
+	RANDOM_GENERATOR(Xoshiro256) \
+	RANDOM_GENERATOR(PCG32) \
+	RANDOM_GENERATOR(Philox)
+
+static inline f32 random_u32_to_f32(u32 r)
+{
+	return (f32)r / (f32)(u32)-1;
+}
+
+static inline u64 random_rotl(u64 x, u32 k)
+{
+	return (x << k) | (x >> (64 - k));
+}
+
+static inline u32 mt19937_temper(u32 y)
+{
+	y = y ^ (y >> 11);
+	y = y ^ ((y << 7) & 0x9D2C5680);
+	y = y ^ ((y << 15) & 0xEFC60000);
+	y = y ^ (y >> 18);
+	return y;
+}
+
+// Not quite the reference generator -- it twists with m = 312 rather than 397.
+// Left as it is since every existing seed depends on it. The twist and the bulk
+// fills run 4 words at a time (random.cpp).
 struct MT19937
 {
 	u32 idx;
 	u32 x[624];
 
 	void seed(u32 seed);
-	u32  rand_u32();
-	f32  rand_f32();
-	f32  uniform_f32(f32 start, f32 end);
+	void twist();
+
+	u32 rand_u32()
+	{
+		if (idx == ARRAY_SIZE(x)) {
+			twist();
+		}
+		return mt19937_temper(x[idx++]);
+	}
+
+	f32 rand_f32()                      { return random_u32_to_f32(rand_u32()); }
+	f32 uniform_f32(f32 start, f32 end) { return start + (end - start)*rand_f32(); }
+
+	void rand_fill_u32(u32* out, u32 n);
+	void rand_fill_f32(f32* out, u32 n);
+	void uniform_fill_f32(f32* out, u32 n, f32 start, f32 end);
+
+	void set_current();
+};
+
+// xoshiro256** -- 32 bytes of state, so cheap to keep one per job or entity.
+struct Xoshiro256
+{
+	u64 s[4];
+
+	// expands seed with splitmix64, which never gives the all zero state
+	void seed(u64 seed)
+	{
+		for (u32 i = 0; i < 4; ++i) {
+			seed += 0x9E3779B97F4A7C15;
+			u64 z = seed;
+			z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+			z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+			s[i] = z ^ (z >> 31);
+		}
+	}
+
+	u64 rand_u64()
+	{
+		u64 result = random_rotl(s[1] * 5, 7) * 9;
+		u64 t = s[1] << 17;
+		s[2] ^= s[0];
+		s[3] ^= s[1];
+		s[1] ^= s[2];
+		s[0] ^= s[3];
+		s[2] ^= t;
+		s[3] = random_rotl(s[3], 45);
+		return result;
+	}
+
+	// the high bits are the better ones
+	u32 rand_u32()                      { return (u32)(rand_u64() >> 32); }
+	f32 rand_f32()                      { return random_u32_to_f32(rand_u32()); }
+	f32 uniform_f32(f32 start, f32 end) { return start + (end - start)*rand_f32(); }
+
+	void rand_fill_u32(u32* out, u32 n) { for (u32 i = 0; i < n; ++i) { out[i] = rand_u32(); } }
+	void rand_fill_f32(f32* out, u32 n) { for (u32 i = 0; i < n; ++i) { out[i] = rand_f32(); } }
+	void uniform_fill_f32(f32* out, u32 n, f32 start, f32 end)
+	{
+		for (u32 i = 0; i < n; ++i) {
+			out[i] = uniform_f32(start, end);
+		}
+	}
+
+	void set_current();
+};
+
+// PCG32 (XSH RR) -- 16 bytes of state, with 2^63 independent streams.
+struct PCG32
+{
+	u64 state;
+	u64 inc;
+
+	void seed(u64 seed, u64 stream = 0)
+	{
+		state = 0;
+		inc = (stream << 1) | 1;
+		rand_u32();
+		state += seed;
+		rand_u32();
+	}
+
+	u32 rand_u32()
+	{
+		u64 old = state;
+		state = old * 6364136223846793005 + inc;
+		u32 xorshifted = (u32)(((old >> 18) ^ old) >> 27);
+		u32 rot = (u32)(old >> 59);
+		return (xorshifted >> rot) | (xorshifted << ((0 - rot) & 31));
+	}
+
+	f32 rand_f32()                      { return random_u32_to_f32(rand_u32()); }
+	f32 uniform_f32(f32 start, f32 end) { return start + (end - start)*rand_f32(); }
+
+	void rand_fill_u32(u32* out, u32 n) { for (u32 i = 0; i < n; ++i) { out[i] = rand_u32(); } }
+	void rand_fill_f32(f32* out, u32 n) { for (u32 i = 0; i < n; ++i) { out[i] = rand_f32(); } }
+	void uniform_fill_f32(f32* out, u32 n, f32 start, f32 end)
+	{
+		for (u32 i = 0; i < n; ++i) {
+			out[i] = uniform_f32(start, end);
+		}
+	}
+
+	void set_current();
+};
+
+// Philox4x32-10 -- counter based, so there's no state to carry from one draw to
+// the next. Each (key, counter) gives four words straight off, which makes a
+// stream cheap to start anywhere: key it on whatever identifies the draw and the
+// values don't depend on what else drew first.
+static inline void philox4x32(const u32 counter[4], const u32 key[2], u32 out[4])
+{
+	u32 c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+	u32 k0 = key[0], k1 = key[1];
+	for (u32 i = 0; i < 10; ++i) {
+		u64 p0 = (u64)0xD2511F53 * c0;
+		u64 p1 = (u64)0xCD9E8D57 * c2;
+		c0 = (u32)(p1 >> 32) ^ c1 ^ k0;
+		c1 = (u32)p1;
+		c2 = (u32)(p0 >> 32) ^ c3 ^ k1;
+		c3 = (u32)p0;
+		k0 += 0x9E3779B9;
+		k1 += 0xBB67AE85;
+	}
+	out[0] = c0;
+	out[1] = c1;
+	out[2] = c2;
+	out[3] = c3;
+}
+
+// A stream of Philox blocks. The first three counter words are the caller's and
+// the last counts blocks, so seed() with the same arguments always gives the
+// same stream.
+struct Philox
+{
+	u32 key[2];
+	u32 counter[4];
+	u32 block[4];
+	u32 idx;
+
+	void seed(u64 seed, u32 c0, u32 c1, u32 c2)
+	{
+		key[0] = (u32)seed;
+		key[1] = (u32)(seed >> 32);
+		counter[0] = c0;
+		counter[1] = c1;
+		counter[2] = c2;
+		counter[3] = 0;
+		idx = ARRAY_SIZE(block);
+	}
+
+	u32 rand_u32()
+	{
+		if (idx == ARRAY_SIZE(block)) {
+			philox4x32(counter, key, block);
+			++counter[3];
+			idx = 0;
+		}
+		return block[idx++];
+	}
+
+	f32 rand_f32()                      { return random_u32_to_f32(rand_u32()); }
+	f32 uniform_f32(f32 start, f32 end) { return start + (end - start)*rand_f32(); }
+
+	void rand_fill_u32(u32* out, u32 n) { for (u32 i = 0; i < n; ++i) { out[i] = rand_u32(); } }
+	void rand_fill_f32(f32* out, u32 n) { for (u32 i = 0; i < n; ++i) { out[i] = rand_f32(); } }
+	void uniform_fill_f32(f32* out, u32 n, f32 start, f32 end)
+	{
+		for (u32 i = 0; i < n; ++i) {
+			out[i] = uniform_f32(start, end);
+		}
+	}
+
 	void set_current();
 };
 
 extern thread_local u32 (*rand_u32)();
 extern thread_local f32 (*rand_f32)();
 extern thread_local f32 (*uniform_f32)(f32 start, f32 end);
+extern thread_local void (*rand_fill_u32)(u32* out, u32 n);
+extern thread_local void (*rand_fill_f32)(f32* out, u32 n);
+extern thread_local void (*uniform_fill_f32)(f32* out, u32 n, f32 start, f32 end);
 
 #endif
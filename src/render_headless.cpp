@@ -0,0 +1,32 @@
+// No-op versions of the render job and imgui functions the game code calls, so
+// programs which run the game without drawing anything (level_gen_stats) can
+// link it without render.cpp, imgui.cpp and the textures, Lua and D3D11 they
+// pull in.
+
+#include "render.h"
+#include "imgui.h"
+
+#include "stdafx.h"
+
+void push_triangle(Render_Job_Buffer* buffer, Triangle_Instance instance) { }
+
+void begin_sprites(Render_Job_Buffer* buffer, Source_Texture_ID texture_id, Sprite_Constants constants) { }
+void push_sprite(Render_Job_Buffer* buffer, Sprite_Instance instance) { }
+
+void begin_fov(Render_Job_Buffer* buffer, Target_Texture_ID output_tex_id, Field_Of_Vision_Render_Constant_Buffer constants) { }
+void push_fov_fill(Render_Job_Buffer* buffer, Field_Of_Vision_Fill_Instance instance) { }
+void push_fov_edge(Render_Job_Buffer* buffer, Field_Of_Vision_Edge_Instance instance) { }
+
+void clear_uint(Render_Job_Buffer* buffer, Target_Texture_ID tex_id) { }
+
+void begin(Render_Job_Buffer* buffer, Render_Event event) { }
+void end(Render_Job_Buffer* buffer, Render_Event event) { }
+
+u8 imgui_tree_begin(IMGUI_Context* context, char* name)
+{
+	return 0;
+}
+
+void imgui_tree_end(IMGUI_Context* context) { }
+void imgui_f32(IMGUI_Context* context, char* name, f32* val, f32 min_val, f32 max_val) { }
+void imgui_u32(IMGUI_Context* context, char* name, u32* val, u32 min_val, u32 max_val) { }
@@ -0,0 +1,193 @@
+#ifndef JFG_SIMD_H
+#define JFG_SIMD_H
+
+#include "prelude.h"
+#include <math.h>
+
+// 4 wide f32 lanes. Uses SSE2 where it is part of the target's baseline (x64),
+// otherwise falls back to plain loops so kernels written against f32x4 still
+// build and give the same results lane for lane. Defining JFG_SIMD_SCALAR forces
+// the fallback, physics_bench uses that to check the two agree.
+//
+// b32x4 is a per-lane mask -- all bits set for true, all bits clear for false.
+// u32x4 is 4 u32 lanes for integer and bit work.
+
+#if (defined(_M_X64) || defined(__SSE2__)) && !defined(JFG_SIMD_SCALAR)
+#define JFG_SIMD_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef JFG_SIMD_SSE2
+
+struct f32x4 { __m128 v; };
+struct b32x4 { __m128 v; };
+
+static inline f32x4 f32x4_set1(f32 x)        { return { _mm_set1_ps(x) }; }
+static inline f32x4 f32x4_load(const f32* p) { return { _mm_loadu_ps(p) }; }
+static inline void  f32x4_store(f32* p, f32x4 a) { _mm_storeu_ps(p, a.v); }
+
+static inline f32x4 operator+(f32x4 a, f32x4 b) { return { _mm_add_ps(a.v, b.v) }; }
+static inline f32x4 operator-(f32x4 a, f32x4 b) { return { _mm_sub_ps(a.v, b.v) }; }
+static inline f32x4 operator*(f32x4 a, f32x4 b) { return { _mm_mul_ps(a.v, b.v) }; }
+static inline f32x4 operator/(f32x4 a, f32x4 b) { return { _mm_div_ps(a.v, b.v) }; }
+
+// same semantics as the min/max macros -- (a < b) ? a : b, not named min/max
+// since windows.h defines those as macros
+static inline f32x4 f32x4_min(f32x4 a, f32x4 b) { return { _mm_min_ps(a.v, b.v) }; }
+static inline f32x4 f32x4_max(f32x4 a, f32x4 b) { return { _mm_max_ps(a.v, b.v) }; }
+static inline f32x4 f32x4_sqrt(f32x4 a)         { return { _mm_sqrt_ps(a.v) }; }
+
+static inline b32x4 operator< (f32x4 a, f32x4 b) { return { _mm_cmplt_ps(a.v, b.v) }; }
+static inline b32x4 operator<=(f32x4 a, f32x4 b) { return { _mm_cmple_ps(a.v, b.v) }; }
+static inline b32x4 operator> (f32x4 a, f32x4 b) { return { _mm_cmpgt_ps(a.v, b.v) }; }
+static inline b32x4 operator>=(f32x4 a, f32x4 b) { return { _mm_cmpge_ps(a.v, b.v) }; }
+static inline b32x4 operator==(f32x4 a, f32x4 b) { return { _mm_cmpeq_ps(a.v, b.v) }; }
+static inline b32x4 operator!=(f32x4 a, f32x4 b) { return { _mm_cmpneq_ps(a.v, b.v) }; }
+
+static inline b32x4 operator&(b32x4 a, b32x4 b) { return { _mm_and_ps(a.v, b.v) }; }
+static inline b32x4 operator|(b32x4 a, b32x4 b) { return { _mm_or_ps(a.v, b.v) }; }
+static inline b32x4 operator~(b32x4 a) { return { _mm_xor_ps(a.v, _mm_castsi128_ps(_mm_set1_epi32(-1))) }; }
+
+// mask ? a : b
+static inline f32x4 select(b32x4 mask, f32x4 a, f32x4 b)
+{
+	return { _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)) };
+}
+static inline b32x4 select(b32x4 mask, b32x4 a, b32x4 b)
+{
+	return { _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)) };
+}
+
+// bit i set if lane i is true
+static inline u32 lane_mask(b32x4 a) { return (u32)_mm_movemask_ps(a.v); }
+
+struct u32x4 { __m128i v; };
+
+static inline u32x4 u32x4_set1(u32 x)        { return { _mm_set1_epi32((i32)x) }; }
+static inline u32x4 u32x4_load(const u32* p) { return { _mm_loadu_si128((const __m128i*)p) }; }
+static inline void  u32x4_store(u32* p, u32x4 a) { _mm_storeu_si128((__m128i*)p, a.v); }
+
+static inline u32x4 operator+(u32x4 a, u32x4 b) { return { _mm_add_epi32(a.v, b.v) }; }
+static inline u32x4 operator-(u32x4 a, u32x4 b) { return { _mm_sub_epi32(a.v, b.v) }; }
+static inline u32x4 operator&(u32x4 a, u32x4 b) { return { _mm_and_si128(a.v, b.v) }; }
+static inline u32x4 operator|(u32x4 a, u32x4 b) { return { _mm_or_si128(a.v, b.v) }; }
+static inline u32x4 operator^(u32x4 a, u32x4 b) { return { _mm_xor_si128(a.v, b.v) }; }
+static inline u32x4 operator<<(u32x4 a, u32 n) { return { _mm_sll_epi32(a.v, _mm_cvtsi32_si128((i32)n)) }; }
+static inline u32x4 operator>>(u32x4 a, u32 n) { return { _mm_srl_epi32(a.v, _mm_cvtsi32_si128((i32)n)) }; }
+
+// Rounds each lane the same as (f32)x -- SSE2 only converts signed, but both
+// halves convert exactly and their sum is rounded once.
+static inline f32x4 u32x4_to_f32x4(u32x4 a)
+{
+	__m128 hi = _mm_cvtepi32_ps(_mm_srli_epi32(a.v, 16));
+	__m128 lo = _mm_cvtepi32_ps(_mm_and_si128(a.v, _mm_set1_epi32(0xFFFF)));
+	return { _mm_add_ps(_mm_mul_ps(hi, _mm_set1_ps(65536.0f)), lo) };
+}
+
+#else
+
+struct f32x4 { f32 v[4]; };
+struct b32x4 { u32 v[4]; };
+
+static inline f32x4 f32x4_set1(f32 x)        { return { { x, x, x, x } }; }
+static inline f32x4 f32x4_load(const f32* p) { return { { p[0], p[1], p[2], p[3] } }; }
+static inline void  f32x4_store(f32* p, f32x4 a) { for (u32 i = 0; i < 4; ++i) { p[i] = a.v[i]; } }
+
+#define F32X4_BINARY_OP(op) \
+	static inline f32x4 operator op(f32x4 a, f32x4 b) \
+	{ \
+		return { { a.v[0] op b.v[0], a.v[1] op b.v[1], a.v[2] op b.v[2], a.v[3] op b.v[3] } }; \
+	}
+F32X4_BINARY_OP(+)
+F32X4_BINARY_OP(-)
+F32X4_BINARY_OP(*)
+F32X4_BINARY_OP(/)
+#undef F32X4_BINARY_OP
+
+#define F32X4_COMPARE_OP(op) \
+	static inline b32x4 operator op(f32x4 a, f32x4 b) \
+	{ \
+		b32x4 r; \
+		for (u32 i = 0; i < 4; ++i) { r.v[i] = (a.v[i] op b.v[i]) ? 0xFFFFFFFF : 0; } \
+		return r; \
+	}
+F32X4_COMPARE_OP(<)
+F32X4_COMPARE_OP(<=)
+F32X4_COMPARE_OP(>)
+F32X4_COMPARE_OP(>=)
+F32X4_COMPARE_OP(==)
+F32X4_COMPARE_OP(!=)
+#undef F32X4_COMPARE_OP
+
+static inline f32x4 f32x4_min(f32x4 a, f32x4 b)
+{
+	f32x4 r;
+	for (u32 i = 0; i < 4; ++i) { r.v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i]; }
+	return r;
+}
+static inline f32x4 f32x4_max(f32x4 a, f32x4 b)
+{
+	f32x4 r;
+	for (u32 i = 0; i < 4; ++i) { r.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i]; }
+	return r;
+}
+static inline f32x4 f32x4_sqrt(f32x4 a)
+{
+	f32x4 r;
+	for (u32 i = 0; i < 4; ++i) { r.v[i] = sqrtf(a.v[i]); }
+	return r;
+}
+
+static inline b32x4 operator&(b32x4 a, b32x4 b) { return { { a.v[0] & b.v[0], a.v[1] & b.v[1], a.v[2] & b.v[2], a.v[3] & b.v[3] } }; }
+static inline b32x4 operator|(b32x4 a, b32x4 b) { return { { a.v[0] | b.v[0], a.v[1] | b.v[1], a.v[2] | b.v[2], a.v[3] | b.v[3] } }; }
+static inline b32x4 operator~(b32x4 a) { return { { ~a.v[0], ~a.v[1], ~a.v[2], ~a.v[3] } }; }
+
+static inline f32x4 select(b32x4 mask, f32x4 a, f32x4 b)
+{
+	f32x4 r;
+	for (u32 i = 0; i < 4; ++i) { r.v[i] = mask.v[i] ? a.v[i] : b.v[i]; }
+	return r;
+}
+static inline b32x4 select(b32x4 mask, b32x4 a, b32x4 b)
+{
+	b32x4 r;
+	for (u32 i = 0; i < 4; ++i) { r.v[i] = mask.v[i] ? a.v[i] : b.v[i]; }
+	return r;
+}
+
+static inline u32 lane_mask(b32x4 a)
+{
+	return (a.v[0] & 1) | ((a.v[1] & 1) << 1) | ((a.v[2] & 1) << 2) | ((a.v[3] & 1) << 3);
+}
+
+struct u32x4 { u32 v[4]; };
+
+static inline u32x4 u32x4_set1(u32 x)        { return { { x, x, x, x } }; }
+static inline u32x4 u32x4_load(const u32* p) { return { { p[0], p[1], p[2], p[3] } }; }
+static inline void  u32x4_store(u32* p, u32x4 a) { for (u32 i = 0; i < 4; ++i) { p[i] = a.v[i]; } }
+
+#define U32X4_BINARY_OP(op) \
+	static inline u32x4 operator op(u32x4 a, u32x4 b) \
+	{ \
+		return { { a.v[0] op b.v[0], a.v[1] op b.v[1], a.v[2] op b.v[2], a.v[3] op b.v[3] } }; \
+	}
+U32X4_BINARY_OP(+)
+U32X4_BINARY_OP(-)
+U32X4_BINARY_OP(&)
+U32X4_BINARY_OP(|)
+U32X4_BINARY_OP(^)
+#undef U32X4_BINARY_OP
+
+static inline u32x4 operator<<(u32x4 a, u32 n) { return { { a.v[0] << n, a.v[1] << n, a.v[2] << n, a.v[3] << n } }; }
+static inline u32x4 operator>>(u32x4 a, u32 n) { return { { a.v[0] >> n, a.v[1] >> n, a.v[2] >> n, a.v[3] >> n } }; }
+
+static inline f32x4 u32x4_to_f32x4(u32x4 a)
+{
+	return { { (f32)a.v[0], (f32)a.v[1], (f32)a.v[2], (f32)a.v[3] } };
+}
+
+#endif
+
+static inline f32x4 operator-(f32x4 a) { return f32x4_set1(0.0f) - a; }
+
+#endif
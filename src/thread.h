@@ -2,16 +2,46 @@
 #define JFG_THREAD_H
 
 u32 interlocked_compare_exchange(u32 volatile* destination, u32 exchange, u32 comperand);
+// both return the new value
+u32 interlocked_increment(u32 volatile* addend);
+u32 interlocked_decrement(u32 volatile* addend);
 
 #ifndef JFG_HEADER_ONLY
-// TODO -- platforms other than windows
-// should have an ifdef windows here - or ifdef MSVC
+#ifdef _MSC_VER
 #pragma intrinsic(_InterlockedCompareExchange)
+#pragma intrinsic(_InterlockedIncrement)
+#pragma intrinsic(_InterlockedDecrement)
 
 u32 interlocked_compare_exchange(u32 volatile* destination, u32 exchange, u32 comperand)
 {
 	return _InterlockedCompareExchange(destination, exchange, comperand);
 }
+
+u32 interlocked_increment(u32 volatile* addend)
+{
+	return (u32)_InterlockedIncrement((long volatile*)addend);
+}
+
+u32 interlocked_decrement(u32 volatile* addend)
+{
+	return (u32)_InterlockedDecrement((long volatile*)addend);
+}
+#else
+u32 interlocked_compare_exchange(u32 volatile* destination, u32 exchange, u32 comperand)
+{
+	return __sync_val_compare_and_swap(destination, comperand, exchange);
+}
+
+u32 interlocked_increment(u32 volatile* addend)
+{
+	return __sync_add_and_fetch(addend, 1);
+}
+
+u32 interlocked_decrement(u32 volatile* addend)
+{
+	return __sync_sub_and_fetch(addend, 1);
+}
+#endif
 #endif
 
 #endif
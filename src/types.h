@@ -37,8 +37,53 @@ struct Map_Cache_Bool
 
 #define MAX_ENTITIES 10240
 
+// An Entity_ID is a handle. The low bits are the entity's index, which is
+// reused once it dies; the bits above count the reuses, so a handle kept past
+// its entity's death never matches whatever takes the index next. First time
+// round the generation is 0 and the handle is just the index. Generations wrap
+// after 65536 reuses of one index.
+//
+// Tiles drawn as sprites get IDs too, with ENTITY_ID_TILE set and the tile's
+// position in the low 16 bits.
 typedef u32 Entity_ID;
 
+#define ENTITY_ID_INDEX_BITS      14
+#define ENTITY_ID_INDEX_MASK      ((1u << ENTITY_ID_INDEX_BITS) - 1)
+#define ENTITY_ID_GENERATION_MASK 0xFFFFu
+#define ENTITY_ID_TILE            0x80000000u
+
+STATIC_ASSERT(MAX_ENTITIES <= ENTITY_ID_INDEX_MASK + 1, entity_indices_fit_in_entity_id);
+
+static inline Entity_ID make_entity_id(u32 index, u32 generation)
+{
+	return (generation << ENTITY_ID_INDEX_BITS) | index;
+}
+
+static inline u32 entity_id_index(Entity_ID entity_id)
+{
+	return entity_id & ENTITY_ID_INDEX_MASK;
+}
+
+static inline u32 entity_id_generation(Entity_ID entity_id)
+{
+	return (entity_id >> ENTITY_ID_INDEX_BITS) & ENTITY_ID_GENERATION_MASK;
+}
+
+static inline Entity_ID tile_entity_id(Pos p)
+{
+	return ENTITY_ID_TILE | pos_to_u16(p);
+}
+
+static inline bool entity_id_is_tile(Entity_ID entity_id)
+{
+	return entity_id & ENTITY_ID_TILE;
+}
+
+static inline Pos tile_entity_id_to_pos(Entity_ID entity_id)
+{
+	return u16_to_pos((u16)entity_id);
+}
+
 // Forward declarations
 
 struct Render;
@@ -805,7 +805,7 @@ void world_anim_init(Anim_State* anim_state, Game* game)
 
 	for (u32 i = 0; i < num_entities; ++i) {
 		auto e = &game->entities[i];
-		auto app = e->appearance;
+		auto app = game->entity_infos[i].appearance;
 		if (!app) {
 			continue;
 		}
@@ -886,7 +886,7 @@ void world_anim_init(Anim_State* anim_state, Game* game)
 				anim.type = ANIM_TILE_STATIC;
 				anim.sprite_coords = sprite_coords;
 				anim.world_coords = (v2)p;
-				anim.entity_id = MAX_ENTITIES + pos_to_u16(p);
+				anim.entity_id = tile_entity_id(p);
 				anim.depth_offset = constants.z_offsets.floor;
 				world_static_anims.append(anim);
 				break;
@@ -920,7 +920,7 @@ void world_anim_init(Anim_State* anim_state, Game* game)
 				anim.type = ANIM_TILE_STATIC;
 				anim.sprite_coords = appearance_get_wall_sprite_coords(app, connection_mask);
 				anim.world_coords = (v2)p;
-				anim.entity_id = MAX_ENTITIES + pos_to_u16(p);
+				anim.entity_id = tile_entity_id(p);
 				anim.depth_offset = constants.z_offsets.wall;
 				world_static_anims.append(anim);
 
@@ -940,7 +940,7 @@ void world_anim_init(Anim_State* anim_state, Game* game)
 				anim.type = ANIM_TILE_LIQUID;
 				anim.sprite_coords = sprite_coords;
 				anim.world_coords = (v2)p;
-				anim.entity_id = MAX_ENTITIES + pos_to_u16(p);
+				anim.entity_id = tile_entity_id(p);
 				anim.depth_offset = constants.z_offsets.floor;
 
 				f32 d = uniform_f32(0.8f, 1.2f);
@@ -967,7 +967,7 @@ void world_anim_init(Anim_State* anim_state, Game* game)
 					anim.type = ANIM_WATER_EDGE;
 					anim.sprite_coords = { (f32)(mask % 16), (f32)(15 - mask / 16) };
 					anim.world_coords = (v2)p;
-					anim.entity_id = MAX_ENTITIES + pos_to_u16(p);
+					anim.entity_id = tile_entity_id(p);
 					anim.depth_offset = constants.z_offsets.water_edge;
 					anim.water_edge.color = { 0x58, 0x80, 0xC0, 0xFF };
 					world_static_anims.append(anim);
@@ -1008,6 +1008,7 @@ void init(Anim_State* anim_state, Game* game)
 	anim_state->world_dynamic_anims.reset();
 	// anim_state->world_modifier_anims.reset();
 	anim_state->sound_anims.reset();
+	reset(&anim_state->fov_render_cache);
 
 	world_anim_init(anim_state, game);
 	card_anim_init(&anim_state->card_anim_state, &game->card_state);
@@ -1125,7 +1126,7 @@ void build_animations(Anim_State* anim_state, Slice<Event> events, f32 time)
 			anim.type = ANIM_DROP_TILE;
 			anim.start_time = event->time;
 			anim.duration = constants.anims.drop_tile.duration;
-			anim.drop_tile.entity_id = MAX_ENTITIES + pos_to_u16(event->drop_tile.pos);
+			anim.drop_tile.entity_id = tile_entity_id(event->drop_tile.pos);
 			world_dynamic_anims.append(anim);
 			break;
 		}
@@ -1964,7 +1965,7 @@ void draw(Anim_State* anim_state, Render* renderer, Sound_Player* sound_player,
 		}
 		case ANIM_FIELD_OF_VISION_CHANGED: {
 			if (!anim->started) {
-				render(anim->field_of_vision.fov, renderer);
+				render(anim->field_of_vision.fov, &anim_state->fov_render_cache, renderer);
 			}
 			break;
 		}
@@ -2223,7 +2224,7 @@ void draw(Anim_State* anim_state, Render* renderer, Sound_Player* sound_player,
 			break;
 		}
 		case ANIM_FIELD_OF_VISION_CHANGED: {
-			render(anim->field_of_vision.fov, renderer);
+			render(anim->field_of_vision.fov, &anim_state->fov_render_cache, renderer);
 			break;
 		}
 		case ANIM_TURN_VISIBLE:
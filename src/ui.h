@@ -451,6 +451,8 @@ struct Anim_State
 	// TODO -- simplify this/put directly into Anim_State
 	Card_Anim_State card_anim_state;
 
+	Field_Of_Vision_Render_Cache fov_render_cache;
+
 	// XXX -- temporary
 	Draw *draw;
 	Card_Render *card_render;
@@ -0,0 +1,645 @@
+// Headless seed validation.
+//
+// Builds BUILD_LEVEL_FUNCS entries over a range of seeds, a thread per core each
+// taking the next batch of seeds, and checks the player can actually play the
+// level:
+//
+//   - the player stands on a tile it can move on
+//   - every creature can get to the player with its own movement type
+//   - every other entity (webs, barrels, ...) and every trap is somewhere the
+//     player can walk to
+//
+// Reachability is a flood fill from the player over bitmaps of the tiles each
+// movement type can pass -- see flood_fill(). Entities don't block it, since
+// everything that blocks can be killed or opened.
+//
+// Before any seeds, the checks are run over hand built fixtures -- a clean level
+// and one with each problem -- so checks that stop finding anything fail here
+// instead of passing every seed.
+//
+// Seeds that fail are written out one per line as "generator seed problem,...",
+// sorted, to stdout or the --bad-seeds file. The per generator summary goes to
+// stderr, including seeds/s/core -- the throughput figure to watch when the
+// generators or these checks change.
+//
+// usage: validate_seeds [--seeds first count] [--threads n] [--bad-seeds file]
+//                       [generator ...]
+//
+// Exits with 2 if any seed is bad, 1 if a fixture isn't judged right.
+
+#include "stdafx.h"
+
+#include <thread>
+#include <chrono>
+
+#include "level_gen_harness.h"
+#include "random.h"
+
+#include "thread.h"
+
+#define VALIDATE_MAX_THREADS        64
+#define VALIDATE_BATCH_SIZE         64
+#define VALIDATE_MAX_MOVEMENT_TYPES 8
+
+#define SEED_PROBLEMS \
+	SEED_PROBLEM(asserted) \
+	SEED_PROBLEM(player_blocked) \
+	SEED_PROBLEM(creature_unreachable) \
+	SEED_PROBLEM(entity_unreachable) \
+	SEED_PROBLEM(trap_unreachable)
+
+enum Seed_Problem_Index
+{
+#define SEED_PROBLEM(name) SEED_PROBLEM_INDEX_##name,
+	SEED_PROBLEMS
+#undef SEED_PROBLEM
+
+	NUM_SEED_PROBLEMS
+};
+
+enum Seed_Problem
+{
+#define SEED_PROBLEM(name) SEED_PROBLEM_##name = 1 << SEED_PROBLEM_INDEX_##name,
+	SEED_PROBLEMS
+#undef SEED_PROBLEM
+};
+
+static const char *SEED_PROBLEM_NAMES[] = {
+#define SEED_PROBLEM(name) #name,
+	SEED_PROBLEMS
+#undef SEED_PROBLEM
+};
+
+// -----------------------------------------------------------------------------
+// bitset flood fill
+//
+// Maps are Map_Cache_Bool -- 256 bit rows of 4 u64s with x = 0 in the lowest bit
+// -- so every operation below works on 64 tiles at once and the 4 words of a row
+// are independent, which the compiler turns into vector ops.
+
+#define ROW_WORDS (256 / 64)
+
+// each bit takes the value of the bit n below it (towards x = 0), or n above
+static inline void row_shift_up(u64* dest, u64* src, u32 n)
+{
+	u32 words = n / 64, bits = n % 64;
+	for (u32 i = 0; i < ROW_WORDS; ++i) {
+		u64 near = i >= words ? src[i - words] : 0;
+		u64 far = i >= words + 1 ? src[i - words - 1] : 0;
+		dest[i] = bits ? (near << bits) | (far >> (64 - bits)) : near;
+	}
+}
+
+static inline void row_shift_down(u64* dest, u64* src, u32 n)
+{
+	u32 words = n / 64, bits = n % 64;
+	for (u32 i = 0; i < ROW_WORDS; ++i) {
+		u64 near = i + words < ROW_WORDS ? src[i + words] : 0;
+		u64 far = i + words + 1 < ROW_WORDS ? src[i + words + 1] : 0;
+		dest[i] = bits ? (near >> bits) | (far << (64 - bits)) : near;
+	}
+}
+
+// Spreads the set bits of row along the runs of passable they're in, both ways.
+// Kogge-Stone occluded fill -- log2(256) shifts per direction however long the
+// runs are. row must be a subset of passable.
+static void fill_row(u64* row, u64* passable)
+{
+	u64 up[ROW_WORDS], up_mask[ROW_WORDS];
+	u64 down[ROW_WORDS], down_mask[ROW_WORDS];
+	u64 shifted[ROW_WORDS];
+	memcpy(up, row, sizeof(up));
+	memcpy(down, row, sizeof(down));
+	memcpy(up_mask, passable, sizeof(up_mask));
+	memcpy(down_mask, passable, sizeof(down_mask));
+
+	for (u32 n = 1; n < 256; n *= 2) {
+		row_shift_up(shifted, up, n);
+		for (u32 i = 0; i < ROW_WORDS; ++i) { up[i] |= up_mask[i] & shifted[i]; }
+		row_shift_up(shifted, up_mask, n);
+		for (u32 i = 0; i < ROW_WORDS; ++i) { up_mask[i] &= shifted[i]; }
+
+		row_shift_down(shifted, down, n);
+		for (u32 i = 0; i < ROW_WORDS; ++i) { down[i] |= down_mask[i] & shifted[i]; }
+		row_shift_down(shifted, down_mask, n);
+		for (u32 i = 0; i < ROW_WORDS; ++i) { down_mask[i] &= shifted[i]; }
+	}
+
+	for (u32 i = 0; i < ROW_WORDS; ++i) {
+		row[i] = up[i] | down[i];
+	}
+}
+
+// Grows reached to everything 8-connected to it through passable. Fills along
+// the rows reached starts in, then sweeps down the rows and back up, each row
+// taking what the row before it reaches -- itself and its diagonals -- and
+// filling along its own runs, until a pair of sweeps changes nothing. Most
+// levels settle in one or two pairs.
+static void flood_fill(Map_Cache_Bool* reached, Map_Cache_Bool* passable)
+{
+	for (u32 y = 0; y < 256; ++y) {
+		u64 *row = &reached->items[y * ROW_WORDS];
+		if (row[0] | row[1] | row[2] | row[3]) {
+			fill_row(row, &passable->items[y * ROW_WORDS]);
+		}
+	}
+
+	u8 changed = 1;
+	while (changed) {
+		changed = 0;
+		for (u32 sweep = 0; sweep < 2; ++sweep) {
+			for (u32 k = 1; k < 256; ++k) {
+				u32 y = sweep ? 255 - k : k;
+				u32 prev_y = sweep ? y + 1 : y - 1;
+				u64 *row = &reached->items[y * ROW_WORDS];
+				u64 *prev = &reached->items[prev_y * ROW_WORDS];
+				u64 *row_passable = &passable->items[y * ROW_WORDS];
+
+				u64 from[ROW_WORDS];
+				u64 any_new = 0;
+				for (u32 i = 0; i < ROW_WORDS; ++i) {
+					u64 west = (prev[i] << 1) | (i ? prev[i - 1] >> 63 : 0);
+					u64 east = (prev[i] >> 1) | (i + 1 < ROW_WORDS ? prev[i + 1] << 63 : 0);
+					from[i] = (prev[i] | west | east) & row_passable[i];
+					any_new |= from[i] & ~row[i];
+				}
+				if (!any_new) {
+					continue;
+				}
+				for (u32 i = 0; i < ROW_WORDS; ++i) {
+					from[i] |= row[i];
+				}
+				fill_row(from, row_passable);
+				memcpy(row, from, sizeof(from));
+				changed = 1;
+			}
+		}
+	}
+}
+
+// -----------------------------------------------------------------------------
+// level checks
+
+struct Movement_Reach
+{
+	u16            movement_type;
+	Map_Cache_Bool reached;
+};
+
+struct Validate_Scratch
+{
+	Map_Cache_Bool floor;
+	Map_Cache_Bool water;
+	Map_Cache_Bool passable;
+	Pos            start;
+	u32            num_reaches;
+	Movement_Reach reaches[VALIDATE_MAX_MOVEMENT_TYPES];
+};
+
+static void get_tile_maps(Validate_Scratch* scratch, Game* game)
+{
+	for (u32 word = 0; word < ARRAY_SIZE(scratch->floor.items); ++word) {
+		Tile *tiles = &game->tiles.items[word * 64];
+		u64 floor = 0, water = 0;
+		for (u32 b = 0; b < 64; ++b) {
+			floor |= (u64)(tiles[b].type == TILE_FLOOR) << b;
+			water |= (u64)(tiles[b].type == TILE_WATER) << b;
+		}
+		scratch->floor.items[word] = floor;
+		scratch->water.items[word] = water;
+	}
+}
+
+// Tiles reachable from the player moving as movement_type, filled the first
+// time each movement type is asked for. Same rules as tile_is_passable().
+static Map_Cache_Bool* get_reached(Validate_Scratch* scratch, u16 movement_type)
+{
+	for (u32 i = 0; i < scratch->num_reaches; ++i) {
+		if (scratch->reaches[i].movement_type == movement_type) {
+			return &scratch->reaches[i].reached;
+		}
+	}
+	ASSERT(scratch->num_reaches < VALIDATE_MAX_MOVEMENT_TYPES);
+	Movement_Reach *reach = &scratch->reaches[scratch->num_reaches++];
+	reach->movement_type = movement_type;
+
+	u64 floor_mask = movement_type & BLOCK_SWIM ? 0 : ~(u64)0;
+	u64 water_mask = movement_type & BLOCK_WALK ? 0 : ~(u64)0;
+	for (u32 i = 0; i < ARRAY_SIZE(scratch->passable.items); ++i) {
+		scratch->passable.items[i] = (scratch->floor.items[i] & floor_mask)
+		                           | (scratch->water.items[i] & water_mask);
+	}
+
+	// the start always counts -- creatures only need to get next to the player
+	reach->reached.reset();
+	reach->reached.set(scratch->start);
+	scratch->passable.set(scratch->start);
+	flood_fill(&reach->reached, &scratch->passable);
+
+	return &reach->reached;
+}
+
+static u8 any_reached_within(Map_Cache_Bool* reached, Pos center, u32 radius)
+{
+	i32 r = (i32)radius;
+	for (i32 dy = -r; dy <= r; ++dy) {
+		i32 y = center.y + dy;
+		if (y < 0 || y > 255) {
+			continue;
+		}
+		for (i32 dx = -r; dx <= r; ++dx) {
+			i32 x = center.x + dx;
+			if (x < 0 || x > 255 || dx*dx + dy*dy > r*r) {
+				continue;
+			}
+			if (reached->get(Pos(x, y))) {
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+static u32 validate_level(Validate_Scratch* scratch, Game* game)
+{
+	Entity *player = get_entity_by_id(game, game->player_id);
+	scratch->start = player->pos;
+	scratch->num_reaches = 0;
+	get_tile_maps(scratch, game);
+
+	u32 result = 0;
+	if (!tile_is_passable(game->tiles[player->pos], player->movement_type)) {
+		result |= SEED_PROBLEM_player_blocked;
+	}
+
+	Map_Cache_Bool *player_reached = get_reached(scratch, player->movement_type);
+
+	for (u32 i = 0; i < game->entities.len; ++i) {
+		Entity *e = &game->entities[i];
+		if (e == player) {
+			continue;
+		}
+		if (e->movement_type) {
+			if (!get_reached(scratch, e->movement_type)->get(e->pos)) {
+				result |= SEED_PROBLEM_creature_unreachable;
+			}
+		} else if (!player_reached->get(e->pos)) {
+			result |= SEED_PROBLEM_entity_unreachable;
+		}
+	}
+
+	for (u32 i = 0; i < game->handlers.len; ++i) {
+		Message_Handler *h = &game->handlers[i];
+		switch (h->type) {
+		case MESSAGE_HANDLER_TRAP_FIREBALL:
+			if (!player_reached->get(h->trap.pos)) {
+				result |= SEED_PROBLEM_trap_unreachable;
+			}
+			break;
+		case MESSAGE_HANDLER_TRAP_SPIDER_CAVE:
+			// goes off on moving anywhere within the radius -- the centre itself
+			// can be wall
+			if (!any_reached_within(player_reached,
+			                        h->trap_spider_cave.center,
+			                        h->trap_spider_cave.radius)) {
+				result |= SEED_PROBLEM_trap_unreachable;
+			}
+			break;
+		default:
+			break;
+		}
+	}
+
+	return result;
+}
+
+// -----------------------------------------------------------------------------
+// fixtures
+
+// A room the player starts in and a walled off pocket. The fixture for a problem
+// puts the one thing that causes it in the pocket -- or the player on the wall --
+// and everything else in the room. Problem 0 is the clean level.
+static void build_fixture(Game* game, u32 problem)
+{
+	init(game);
+	for (u32 y = 0; y < 16; ++y) {
+		for (u32 x = 0; x < 16; ++x) {
+			game->tiles[Pos(x, y)].type = TILE_WALL;
+		}
+	}
+	for (u32 y = 1; y < 9; ++y) {
+		for (u32 x = 1; x < 9; ++x) {
+			game->tiles[Pos(x, y)].type = TILE_FLOOR;
+		}
+	}
+	for (u32 y = 11; y < 15; ++y) {
+		for (u32 x = 11; x < 15; ++x) {
+			game->tiles[Pos(x, y)].type = TILE_FLOOR;
+		}
+	}
+	Pos pocket = Pos(13, 13);
+
+	get_player(game)->pos = problem == SEED_PROBLEM_player_blocked ? Pos(0, 2) : Pos(2, 2);
+	add_spider_normal(game, problem == SEED_PROBLEM_creature_unreachable ? pocket : Pos(6, 6));
+	add_spiderweb(game, problem == SEED_PROBLEM_entity_unreachable ? pocket : Pos(4, 6));
+	add_trap_spider_cave(game, problem == SEED_PROBLEM_trap_unreachable ? pocket : Pos(6, 3), 1);
+}
+
+// Each fixture has to come back with exactly its own problem. Returns whether
+// they all did.
+static u8 check_fixtures()
+{
+	// far too big for the stack
+	Game *game = (Game*)malloc(sizeof(Game));
+	Validate_Scratch *scratch = (Validate_Scratch*)malloc(sizeof(Validate_Scratch));
+	ASSERT(game && scratch);
+
+	MT19937 rng;
+	rng.seed(0);
+	rng.set_current();
+
+	u8 result = 1;
+	for (u32 p = 0; p <= NUM_SEED_PROBLEMS; ++p) {
+		// the last is the clean level, and nothing here builds a level that asserts
+		u32 problem = p < NUM_SEED_PROBLEMS ? 1 << p : 0;
+		if (problem == SEED_PROBLEM_asserted) {
+			continue;
+		}
+		build_fixture(game, problem);
+		u32 found = validate_level(scratch, game);
+		if (found != problem) {
+			fprintf(stderr, "fixture \"%s\" was judged 0x%x, not 0x%x\n",
+			        problem ? SEED_PROBLEM_NAMES[p] : "clean", found, problem);
+			result = 0;
+		}
+	}
+
+	free(scratch);
+	free(game);
+	return result;
+}
+
+// -----------------------------------------------------------------------------
+// jobs
+
+struct Bad_Seed
+{
+	u32 func_id;
+	u32 seed;
+	u32 problems;
+};
+
+struct Validate_Thread
+{
+	Bad_Seed *bad_seeds;
+	u32       bad_seeds_len;
+	u32       bad_seeds_size;
+	// per generator
+	u32       problem_counts[NUM_LEVEL_GEN_FUNCS][NUM_SEED_PROBLEMS];
+	f64       seconds[NUM_LEVEL_GEN_FUNCS];
+	f64       check_seconds[NUM_LEVEL_GEN_FUNCS];
+};
+
+struct Validate_Jobs
+{
+	u32              first_seed;
+	u32              num_seeds;
+	u32              num_funcs;
+	u32              func_ids[NUM_LEVEL_GEN_FUNCS];
+	u32              batches_per_func;
+	u32 volatile     next_batch;
+	Validate_Thread *threads;
+};
+
+typedef std::chrono::steady_clock Validate_Clock;
+
+static f64 seconds_since(Validate_Clock::time_point start)
+{
+	return std::chrono::duration<f64>(Validate_Clock::now() - start).count();
+}
+
+static void add_bad_seed(Validate_Thread* thread, u32 func_id, u32 seed, u32 problems)
+{
+	if (thread->bad_seeds_len == thread->bad_seeds_size) {
+		thread->bad_seeds_size = max_u32(256, thread->bad_seeds_size * 2);
+		thread->bad_seeds = (Bad_Seed*)realloc(thread->bad_seeds,
+		                                       thread->bad_seeds_size * sizeof(Bad_Seed));
+		ASSERT(thread->bad_seeds);
+	}
+	Bad_Seed *bad = &thread->bad_seeds[thread->bad_seeds_len++];
+	bad->func_id = func_id;
+	bad->seed = seed;
+	bad->problems = problems;
+}
+
+static void validate_worker(Validate_Jobs* jobs, Validate_Thread* thread)
+{
+	// far too big for the stack
+	Game *game = (Game*)malloc(sizeof(Game));
+	Validate_Scratch *scratch = (Validate_Scratch*)malloc(sizeof(Validate_Scratch));
+	ASSERT(game && scratch);
+
+	MT19937 rng;
+	rng.set_current();
+
+	u32 num_batches = jobs->num_funcs * jobs->batches_per_func;
+	for (;;) {
+		u32 batch = interlocked_increment(&jobs->next_batch) - 1;
+		if (batch >= num_batches) {
+			break;
+		}
+		u32 func_id = jobs->func_ids[batch / jobs->batches_per_func];
+		Build_Level_Function build = BUILD_LEVEL_FUNCS[func_id].func;
+		u32 begin = (batch % jobs->batches_per_func) * VALIDATE_BATCH_SIZE;
+		u32 end = min_u32(begin + VALIDATE_BATCH_SIZE, jobs->num_seeds);
+
+		auto batch_start = Validate_Clock::now();
+		f64 check_seconds = 0.0;
+		for (u32 i = begin; i < end; ++i) {
+			u32 seed = jobs->first_seed + i;
+			rng.seed(seed);
+			u32 problems = 0;
+			if (try_build_level(build, game)) {
+				auto check_start = Validate_Clock::now();
+				problems = validate_level(scratch, game);
+				check_seconds += seconds_since(check_start);
+			} else {
+				problems = SEED_PROBLEM_asserted;
+			}
+			if (problems) {
+				add_bad_seed(thread, func_id, seed, problems);
+				for (u32 p = 0; p < NUM_SEED_PROBLEMS; ++p) {
+					thread->problem_counts[func_id][p] += (problems >> p) & 1;
+				}
+			}
+		}
+		thread->seconds[func_id] += seconds_since(batch_start);
+		thread->check_seconds[func_id] += check_seconds;
+	}
+
+	free(scratch);
+	free(game);
+}
+
+// -----------------------------------------------------------------------------
+// reporting
+
+static int compare_bad_seeds(const void* a, const void* b)
+{
+	Bad_Seed *x = (Bad_Seed*)a, *y = (Bad_Seed*)b;
+	if (x->func_id != y->func_id) {
+		return x->func_id < y->func_id ? -1 : 1;
+	}
+	return (x->seed > y->seed) - (x->seed < y->seed);
+}
+
+static void write_bad_seeds(Bad_Seed* bad_seeds, u32 len, FILE* f)
+{
+	for (u32 i = 0; i < len; ++i) {
+		Bad_Seed *bad = &bad_seeds[i];
+		fprintf(f, "%s %u ", BUILD_LEVEL_FUNCS[bad->func_id].name, bad->seed);
+		const char *separator = "";
+		for (u32 p = 0; p < NUM_SEED_PROBLEMS; ++p) {
+			if (bad->problems & (1 << p)) {
+				fprintf(f, "%s%s", separator, SEED_PROBLEM_NAMES[p]);
+				separator = ",";
+			}
+		}
+		fprintf(f, "\n");
+	}
+}
+
+static void print_summary(Validate_Jobs* jobs, u32 num_threads, Bad_Seed* bad_seeds, u32 num_bad)
+{
+	fprintf(stderr, "generator,seeds,bad");
+	for (u32 p = 0; p < NUM_SEED_PROBLEMS; ++p) {
+		fprintf(stderr, ",%s", SEED_PROBLEM_NAMES[p]);
+	}
+	fprintf(stderr, ",seeds_per_sec_per_core,check_us_mean\n");
+
+	for (u32 f = 0; f < jobs->num_funcs; ++f) {
+		u32 func_id = jobs->func_ids[f];
+		u32 problem_counts[NUM_SEED_PROBLEMS] = {};
+		f64 seconds = 0.0, check_seconds = 0.0;
+		for (u32 t = 0; t < num_threads; ++t) {
+			Validate_Thread *thread = &jobs->threads[t];
+			for (u32 p = 0; p < NUM_SEED_PROBLEMS; ++p) {
+				problem_counts[p] += thread->problem_counts[func_id][p];
+			}
+			seconds += thread->seconds[func_id];
+			check_seconds += thread->check_seconds[func_id];
+		}
+		u32 bad = 0;
+		for (u32 i = 0; i < num_bad; ++i) {
+			bad += bad_seeds[i].func_id == func_id;
+		}
+
+		fprintf(stderr, "%s,%u,%u", BUILD_LEVEL_FUNCS[func_id].name, jobs->num_seeds, bad);
+		for (u32 p = 0; p < NUM_SEED_PROBLEMS; ++p) {
+			fprintf(stderr, ",%u", problem_counts[p]);
+		}
+		// asserted seeds aren't checked but still count towards the mean
+		fprintf(stderr, ",%.1f,%.1f\n",
+		        (f64)jobs->num_seeds / seconds,
+		        check_seconds * 1e6 / (f64)jobs->num_seeds);
+	}
+}
+
+// -----------------------------------------------------------------------------
+// main
+
+int main(int argc, char** argv)
+{
+	Validate_Jobs jobs = {};
+	jobs.first_seed = 0;
+	jobs.num_seeds = 100000;
+	u32 num_threads = std::thread::hardware_concurrency();
+	const char *bad_seeds_filename = NULL;
+
+	for (int i = 1; i < argc; ++i) {
+		if (!strcmp(argv[i], "--seeds") && i + 2 < argc) {
+			jobs.first_seed = strtoul(argv[++i], NULL, 10);
+			jobs.num_seeds = strtoul(argv[++i], NULL, 10);
+		} else if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+			num_threads = strtoul(argv[++i], NULL, 10);
+		} else if (!strcmp(argv[i], "--bad-seeds") && i + 1 < argc) {
+			bad_seeds_filename = argv[++i];
+		} else if (jobs.num_funcs < NUM_LEVEL_GEN_FUNCS
+		        && find_level_func(argv[i], &jobs.func_ids[jobs.num_funcs])) {
+			++jobs.num_funcs;
+		} else {
+			fprintf(stderr, "unknown argument \"%s\"\n", argv[i]);
+			fprintf(stderr, "usage: %s [--seeds first count] [--threads n] "
+			                "[--bad-seeds file] [generator ...]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (!jobs.num_funcs) {
+		for (u32 i = 0; i < NUM_LEVEL_GEN_FUNCS; ++i) {
+			jobs.func_ids[jobs.num_funcs++] = i;
+		}
+	}
+	if (!jobs.num_seeds) {
+		fprintf(stderr, "no seeds to run\n");
+		return 1;
+	}
+	num_threads = max_u32(1, min_u32(num_threads, VALIDATE_MAX_THREADS));
+	jobs.batches_per_func = (jobs.num_seeds + VALIDATE_BATCH_SIZE - 1) / VALIDATE_BATCH_SIZE;
+	jobs.threads = (Validate_Thread*)calloc(num_threads, sizeof(Validate_Thread));
+	ASSERT(jobs.threads);
+
+	if (!check_fixtures()) {
+		return 1;
+	}
+
+	catch_asserts();
+
+	auto start = Validate_Clock::now();
+	std::thread threads[VALIDATE_MAX_THREADS];
+	for (u32 i = 1; i < num_threads; ++i) {
+		threads[i] = std::thread(validate_worker, &jobs, &jobs.threads[i]);
+	}
+	validate_worker(&jobs, &jobs.threads[0]);
+	for (u32 i = 1; i < num_threads; ++i) {
+		threads[i].join();
+	}
+	f64 seconds = seconds_since(start);
+
+	u32 num_bad = 0;
+	for (u32 i = 0; i < num_threads; ++i) {
+		num_bad += jobs.threads[i].bad_seeds_len;
+	}
+	Bad_Seed *bad_seeds = (Bad_Seed*)malloc(max_u32(num_bad, 1) * sizeof(Bad_Seed));
+	ASSERT(bad_seeds);
+	num_bad = 0;
+	for (u32 i = 0; i < num_threads; ++i) {
+		Validate_Thread *thread = &jobs.threads[i];
+		memcpy(&bad_seeds[num_bad], thread->bad_seeds, thread->bad_seeds_len * sizeof(Bad_Seed));
+		num_bad += thread->bad_seeds_len;
+		free(thread->bad_seeds);
+	}
+	qsort(bad_seeds, num_bad, sizeof(Bad_Seed), compare_bad_seeds);
+
+	FILE *f = stdout;
+	if (bad_seeds_filename) {
+		f = fopen(bad_seeds_filename, "w");
+		if (!f) {
+			fprintf(stderr, "couldn't open \"%s\" for writing\n", bad_seeds_filename);
+			return 1;
+		}
+	}
+	write_bad_seeds(bad_seeds, num_bad, f);
+	if (f != stdout) {
+		fclose(f);
+	}
+
+	print_summary(&jobs, num_threads, bad_seeds, num_bad);
+	u64 num_levels = (u64)jobs.num_funcs * jobs.num_seeds;
+	fprintf(stderr, "%llu levels in %.2fs on %u threads -- %.1f levels/s, %.1f levels/s/core, %u bad\n",
+	        (unsigned long long)num_levels, seconds, num_threads,
+	        (f64)num_levels / seconds, (f64)num_levels / seconds / (f64)num_threads, num_bad);
+
+	free(bad_seeds);
+	free(jobs.threads);
+	return num_bad ? 2 : 0;
+}
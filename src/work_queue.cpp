@@ -0,0 +1,112 @@
+#include "work_queue.h"
+
+#include "stdafx.h"
+
+#define JFG_HEADER_ONLY
+#include "thread.h"
+#undef JFG_HEADER_ONLY
+
+// Takes the oldest job -- of group if it's not NULL -- returns whether there was one.
+static bool work_queue_take(Work_Queue* queue, Work_Group* group, Work_Queue_Job* job)
+{
+	wait_semaphore(queue->lock);
+	auto &jobs = queue->jobs;
+	u32 idx = 0;
+	while (idx < jobs.len && group && jobs[idx].group != group) {
+		++idx;
+	}
+	bool found = idx < jobs.len;
+	if (found) {
+		*job = jobs[idx];
+		for (u32 i = idx + 1; i < jobs.len; ++i) {
+			jobs[i - 1] = jobs[i];
+		}
+		--jobs.len;
+	}
+	signal_semaphore(queue->lock);
+	return found;
+}
+
+static void work_queue_run(Work_Queue_Job* job)
+{
+	job->function(job->data);
+	if (!interlocked_decrement(&job->group->remaining)) {
+		signal_semaphore(job->group->done);
+	}
+}
+
+static void work_queue_worker(void* uncast_queue)
+{
+	Work_Queue *queue = (Work_Queue*)uncast_queue;
+	for (;;) {
+		// a waiting thread may have run the job already, then there's nothing to do
+		wait_semaphore(queue->jobs_added);
+		Work_Queue_Job job;
+		if (work_queue_take(queue, NULL, &job)) {
+			work_queue_run(&job);
+		}
+	}
+}
+
+void work_queue_init(Work_Queue* queue, u32 num_workers)
+{
+	ASSERT(num_workers <= WORK_QUEUE_MAX_WORKERS);
+	memset(queue, 0, sizeof(*queue));
+	queue->num_workers = num_workers;
+	queue->lock = create_semaphore(1);
+	queue->jobs_added = create_semaphore(0);
+	for (u32 i = 0; i < num_workers; ++i) {
+		start_thread(work_queue_worker, "work_queue", queue);
+	}
+}
+
+void work_queue_add(Work_Queue* queue, Work_Group* group, Thread_Function function, void* data)
+{
+	interlocked_increment(&group->remaining);
+
+	Work_Queue_Job job = {};
+	job.function = function;
+	job.data = data;
+	job.group = group;
+
+	wait_semaphore(queue->lock);
+	queue->jobs.append(job);
+	signal_semaphore(queue->lock);
+	signal_semaphore(queue->jobs_added);
+}
+
+// remaining counts the group's unfinished jobs plus one held by the group itself
+// outside work_group_wait(), so only the wait can bring it to zero while jobs are
+// still being added, and done is signalled at most once per wait.
+
+void work_group_init(Work_Group* group)
+{
+	group->remaining = 1;
+	group->done = create_semaphore(0);
+}
+
+void work_group_free(Work_Group* group)
+{
+	ASSERT(group->remaining == 1);
+	free_semaphore(group->done);
+	group->done = NULL;
+}
+
+void work_group_wait(Work_Queue* queue, Work_Group* group)
+{
+	if (interlocked_decrement(&group->remaining)) {
+		Work_Queue_Job job;
+		while (work_queue_take(queue, group, &job)) {
+			work_queue_run(&job);
+		}
+		// signalled by whichever job finishes last
+		wait_semaphore(group->done);
+	}
+	ASSERT(!group->remaining);
+	group->remaining = 1;
+}
+
+bool work_group_is_done(Work_Group* group)
+{
+	return group->remaining == 1;
+}
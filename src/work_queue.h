@@ -0,0 +1,47 @@
+#pragma once
+
+#include "prelude.h"
+#include "platform_functions.h"
+
+// A fixed set of worker threads, started once, which sleep on a semaphore until
+// jobs are added. Each job belongs to a Work_Group that can be waited on.
+// Waiting runs the group's jobs no worker has picked up yet on the waiting
+// thread and then blocks until the rest finish, so a job can add jobs of its
+// own and wait on them without tying up every worker.
+
+#define WORK_QUEUE_MAX_JOBS    64
+#define WORK_QUEUE_MAX_WORKERS 16
+
+struct Work_Group
+{
+	u32 volatile  remaining;
+	Semaphore    *done;
+};
+
+struct Work_Queue_Job
+{
+	Thread_Function  function;
+	void            *data;
+	Work_Group      *group;
+};
+
+struct Work_Queue
+{
+	u32        num_workers;
+	// lock is a semaphore with a count of 1 -- jobs are in the order added
+	Semaphore *lock;
+	Semaphore *jobs_added;
+	Max_Length_Array<Work_Queue_Job, WORK_QUEUE_MAX_JOBS> jobs;
+};
+
+// num_workers may be 0, in which case jobs only run when their group is waited on
+void work_queue_init(Work_Queue* queue, u32 num_workers);
+void work_queue_add(Work_Queue* queue, Work_Group* group, Thread_Function function, void* data);
+
+void work_group_init(Work_Group* group);
+void work_group_free(Work_Group* group);
+// The group can be reused once this returns. Only one thread may wait on a
+// group at a time.
+void work_group_wait(Work_Queue* queue, Work_Group* group);
+// doesn't block
+bool work_group_is_done(Work_Group* group);